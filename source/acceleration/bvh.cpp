@@ -0,0 +1,321 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "bvh.h"
+
+/* Aabb --------------------------------------------------------------------- */
+
+void Aabb::extend(const Vec3 &point)
+{
+    min = Vec3(std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z));
+    max = Vec3(std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z));
+}
+
+void Aabb::extend(const Aabb &box)
+{
+    min = Vec3(std::min(min.x, box.min.x), std::min(min.y, box.min.y), std::min(min.z, box.min.z));
+    max = Vec3(std::max(max.x, box.max.x), std::max(max.y, box.max.y), std::max(max.z, box.max.z));
+}
+
+Vec3 Aabb::center() const
+{
+    return (min + max) * 0.5f;
+}
+
+float Aabb::surface_area() const
+{
+    Vec3 size = max - min;
+
+    if (size.x < 0.0f || size.y < 0.0f || size.z < 0.0f)
+        return 0.0f;
+
+    return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+}
+
+/* Private Functions -------------------------------------------------------- */
+
+uint32_t Bvh::build_node(const std::vector<Aabb> &bounds, const std::vector<Vec3> &centers, uint32_t first,
+                         uint32_t count, unsigned int depth)
+{
+    uint32_t node_index = (uint32_t) owned_nodes.size();
+    owned_nodes.push_back(BvhNode());
+
+    Aabb node_bounds, center_bounds;
+
+    for (uint32_t i = first; i < first + count; i++) {
+        node_bounds.extend(bounds[owned_indices[i]]);
+        center_bounds.extend(centers[owned_indices[i]]);
+    }
+
+    BvhNode &node = owned_nodes[node_index];
+    node.bounds_min[0] = node_bounds.min.x;
+    node.bounds_min[1] = node_bounds.min.y;
+    node.bounds_min[2] = node_bounds.min.z;
+    node.bounds_max[0] = node_bounds.max.x;
+    node.bounds_max[1] = node_bounds.max.y;
+    node.bounds_max[2] = node_bounds.max.z;
+    node.offset = first;
+    node.count = count;
+
+    if (count <= 2 || depth >= max_depth)
+        return node_index;
+
+    /**
+     * Primitives are binned by their centroid along each axis and the split with the lowest
+     * surface area heuristic cost is chosen.
+     */
+    static const int bin_count = 16;
+
+    Vec3 extent = center_bounds.max - center_bounds.min;
+    float extents[3] = {extent.x, extent.y, extent.z};
+    float origins[3] = {center_bounds.min.x, center_bounds.min.y, center_bounds.min.z};
+
+    float best_cost = INFINITY;
+    int best_axis = -1;
+    int best_split = 0;
+
+    for (int axis = 0; axis < 3; axis++) {
+        if (extents[axis] <= 0.0f)
+            continue;
+
+        Aabb bin_bounds[bin_count];
+        uint32_t bin_counts[bin_count] = {0};
+
+        float scale = bin_count / extents[axis];
+
+        for (uint32_t i = first; i < first + count; i++) {
+            uint32_t primitive = owned_indices[i];
+            const Vec3 &center = centers[primitive];
+            float coordinate = axis == 0 ? center.x : (axis == 1 ? center.y : center.z);
+
+            int bin = std::min((int) ((coordinate - origins[axis]) * scale), bin_count - 1);
+
+            bin_counts[bin]++;
+            bin_bounds[bin].extend(bounds[primitive]);
+        }
+
+        /**
+         * Sweep from the right to get the cost of every right side, then from the left.
+         */
+        float right_areas[bin_count];
+        uint32_t right_counts[bin_count];
+
+        Aabb right;
+        uint32_t right_count = 0;
+
+        for (int bin = bin_count - 1; bin > 0; bin--) {
+            right.extend(bin_bounds[bin]);
+            right_count += bin_counts[bin];
+
+            right_areas[bin] = right.surface_area();
+            right_counts[bin] = right_count;
+        }
+
+        Aabb left;
+        uint32_t left_count = 0;
+
+        for (int split = 1; split < bin_count; split++) {
+            left.extend(bin_bounds[split - 1]);
+            left_count += bin_counts[split - 1];
+
+            if (!left_count || !right_counts[split])
+                continue;
+
+            float cost = left.surface_area() * left_count + right_areas[split] * right_counts[split];
+
+            if (cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = split;
+            }
+        }
+    }
+
+    /**
+     * Splitting has to beat intersecting every primitive of the node. Traversing a node is taken to
+     * cost about as much as intersecting a primitive.
+     */
+    float node_area = node_bounds.surface_area();
+    float leaf_cost = node_area * count;
+
+    best_cost += node_area;
+
+    if (best_axis < 0 || (best_cost >= leaf_cost && count <= max_leaf_size))
+        return node_index;
+
+    float scale = bin_count / extents[best_axis];
+
+    uint32_t *begin = &owned_indices[first];
+    uint32_t *end = begin + count;
+
+    uint32_t *middle = std::partition(begin, end, [&](uint32_t primitive) {
+        const Vec3 &center = centers[primitive];
+        float coordinate = best_axis == 0 ? center.x : (best_axis == 1 ? center.y : center.z);
+
+        return std::min((int) ((coordinate - origins[best_axis]) * scale), bin_count - 1) < best_split;
+    });
+
+    uint32_t left_count = (uint32_t) (middle - begin);
+
+    build_node(bounds, centers, first, left_count, depth + 1);
+    uint32_t second = build_node(bounds, centers, first + left_count, count - left_count, depth + 1);
+
+    /**
+     * The node array may have been reallocated by the children.
+     */
+    owned_nodes[node_index].offset = second;
+    owned_nodes[node_index].count = 0;
+
+    return node_index;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void Bvh::build(const std::vector<uint32_t> &primitives, const std::vector<Aabb> &bounds)
+{
+    clear();
+
+    if (primitives.empty())
+        return;
+
+    /**
+     * Bounds and centers are looked up by primitive index.
+     */
+    uint32_t primitive_range = 0;
+
+    for (uint32_t primitive : primitives) {
+        primitive_range = std::max(primitive_range, primitive + 1);
+    }
+
+    std::vector<Vec3> centers(primitive_range);
+
+    for (uint32_t primitive : primitives) {
+        centers[primitive] = bounds[primitive].center();
+    }
+
+    owned_indices = primitives;
+    owned_nodes.reserve(primitives.size() / 2 + 1);
+
+    build_node(bounds, centers, 0, (uint32_t) primitives.size(), 0);
+
+    owned_nodes.shrink_to_fit();
+
+    nodes = owned_nodes.data();
+    node_count = owned_nodes.size();
+    indices = owned_indices.data();
+    index_count = owned_indices.size();
+}
+
+bool Bvh::refit(const std::vector<Aabb> &bounds)
+{
+    if (nodes != owned_nodes.data())
+        return false;
+
+    /**
+     * Children are stored after their parent, so walking the nodes backwards visits them first.
+     */
+    for (size_t i = owned_nodes.size(); i-- > 0;) {
+        BvhNode &node = owned_nodes[i];
+        Aabb node_bounds;
+
+        if (node.count) {
+            for (uint32_t j = node.offset; j < node.offset + node.count; j++) {
+                node_bounds.extend(bounds[owned_indices[j]]);
+            }
+        }
+        else {
+            const BvhNode *children[] = {&owned_nodes[i + 1], &owned_nodes[node.offset]};
+
+            for (const BvhNode *child : children) {
+                node_bounds.extend(Aabb(Vec3(child->bounds_min[0], child->bounds_min[1], child->bounds_min[2]),
+                                        Vec3(child->bounds_max[0], child->bounds_max[1], child->bounds_max[2])));
+            }
+        }
+
+        node.bounds_min[0] = node_bounds.min.x;
+        node.bounds_min[1] = node_bounds.min.y;
+        node.bounds_min[2] = node_bounds.min.z;
+        node.bounds_max[0] = node_bounds.max.x;
+        node.bounds_max[1] = node_bounds.max.y;
+        node.bounds_max[2] = node_bounds.max.z;
+    }
+
+    return true;
+}
+
+float Bvh::get_sah_cost() const
+{
+    if (!node_count)
+        return 0.0f;
+
+    auto area = [](const BvhNode &node) {
+        return Aabb(Vec3(node.bounds_min[0], node.bounds_min[1], node.bounds_min[2]),
+                    Vec3(node.bounds_max[0], node.bounds_max[1], node.bounds_max[2])).surface_area();
+    };
+
+    double cost = 0.0;
+
+    for (size_t i = 0; i < node_count; i++) {
+        cost += area(nodes[i]) * (nodes[i].count ? nodes[i].count : 1);
+    }
+
+    float root_area = area(nodes[0]);
+
+    return root_area > 0.0f ? (float) (cost / root_area) : 0.0f;
+}
+
+void Bvh::map(const BvhNode *nodes, size_t node_count, const uint32_t *indices, size_t index_count)
+{
+    clear();
+
+    this->nodes = nodes;
+    this->node_count = node_count;
+    this->indices = indices;
+    this->index_count = index_count;
+}
+
+void Bvh::clear()
+{
+    owned_nodes.clear();
+    owned_indices.clear();
+
+    nodes = nullptr;
+    indices = nullptr;
+    node_count = 0;
+    index_count = 0;
+}
+
+const BvhNode *Bvh::get_nodes() const
+{
+    return nodes;
+}
+
+size_t Bvh::get_node_count() const
+{
+    return node_count;
+}
+
+const uint32_t *Bvh::get_indices() const
+{
+    return indices;
+}
+
+size_t Bvh::get_index_count() const
+{
+    return index_count;
+}
@@ -0,0 +1,242 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_BVH_H
+#define HELIOS_BVH_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cmath>
+#include <algorithm>
+#include <ray.h>
+
+/**
+ * Axis aligned bounding box.
+ */
+struct Aabb {
+    Vec3 min = Vec3(INFINITY, INFINITY, INFINITY);
+    Vec3 max = Vec3(-INFINITY, -INFINITY, -INFINITY);
+
+    Aabb() = default;
+
+    Aabb(const Vec3 &min, const Vec3 &max) : min(min), max(max)
+    { }
+
+    void extend(const Vec3 &point);
+
+    void extend(const Aabb &box);
+
+    Vec3 center() const;
+
+    float surface_area() const;
+};
+
+/**
+ * A BVH node. Nodes are stored depth first so the first child of an inner node directly follows
+ * it. Offsets are indices rather than pointers, so a node array can be written to a file and
+ * used again straight from a mapping of it.
+ */
+struct BvhNode {
+    float bounds_min[3];
+
+    /**
+     * Leaves: first entry of the primitive index array. Inner nodes: index of the second child.
+     */
+    uint32_t offset;
+
+    float bounds_max[3];
+
+    /**
+     * Number of primitives of a leaf, 0 for inner nodes.
+     */
+    uint32_t count;
+};
+
+/**
+ * Bounding volume hierarchy over primitive indices, built with the surface area heuristic over
+ * binned centroids. The node and index arrays are either owned or refer to external memory such
+ * as a mapped scene cache.
+ */
+class Bvh {
+private:
+    std::vector<BvhNode> owned_nodes;
+
+    std::vector<uint32_t> owned_indices;
+
+    const BvhNode *nodes = nullptr;
+
+    const uint32_t *indices = nullptr;
+
+    size_t node_count = 0;
+
+    size_t index_count = 0;
+
+    uint32_t build_node(const std::vector<Aabb> &bounds, const std::vector<Vec3> &centers, uint32_t first,
+                        uint32_t count, unsigned int depth);
+
+    /**
+     * Slab test, returns the distance the ray enters the node at, or INFINITY if it misses it
+     * within max_distance.
+     */
+    static inline float intersect_node(const BvhNode &node, const Vec3 &origin, const Vec3 &inverse_direction,
+                                       float max_distance);
+
+public:
+    static const uint32_t max_leaf_size = 8;
+
+    /**
+     * Deeper nodes become leaves regardless of their size, which bounds the traversal stack.
+     */
+    static const unsigned int max_depth = 63;
+
+    /**
+     * Builds the hierarchy over the primitives with the given indices. The bounds are indexed by
+     * primitive index.
+     */
+    void build(const std::vector<uint32_t> &primitives, const std::vector<Aabb> &bounds);
+
+    /**
+     * Recomputes the bounds of every node bottom up from the primitives' new bounds, keeping the
+     * tree as it is. Only owned hierarchies can be refitted.
+     */
+    bool refit(const std::vector<Aabb> &bounds);
+
+    /**
+     * Surface area heuristic cost of the tree relative to the area of its root, weighted like
+     * the build. It grows as moving primitives make refitted nodes larger and overlap.
+     */
+    float get_sah_cost() const;
+
+    /**
+     * Uses node and index arrays owned by someone else.
+     */
+    void map(const BvhNode *nodes, size_t node_count, const uint32_t *indices, size_t index_count);
+
+    void clear();
+
+    const BvhNode *get_nodes() const;
+
+    size_t get_node_count() const;
+
+    const uint32_t *get_indices() const;
+
+    size_t get_index_count() const;
+
+    /**
+     * Calls test(primitive, &max_distance) for the primitives of every leaf the ray reaches
+     * before max_distance. test returns true on a hit and may shorten max_distance. With any_hit
+     * the traversal stops at the first hit. Returns whether there was a hit.
+     */
+    template<typename PrimitiveTest>
+    bool traverse(const Ray &ray, float max_distance, bool any_hit, PrimitiveTest test) const;
+};
+
+/* -------------------------------------------------------------------------- */
+
+inline float Bvh::intersect_node(const BvhNode &node, const Vec3 &origin, const Vec3 &inverse_direction,
+                                 float max_distance)
+{
+    float tx0 = (node.bounds_min[0] - origin.x) * inverse_direction.x;
+    float tx1 = (node.bounds_max[0] - origin.x) * inverse_direction.x;
+    float ty0 = (node.bounds_min[1] - origin.y) * inverse_direction.y;
+    float ty1 = (node.bounds_max[1] - origin.y) * inverse_direction.y;
+    float tz0 = (node.bounds_min[2] - origin.z) * inverse_direction.z;
+    float tz1 = (node.bounds_max[2] - origin.z) * inverse_direction.z;
+
+    float t_near = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), 0.0f));
+    float t_far = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), max_distance));
+
+    return t_near <= t_far ? t_near : INFINITY;
+}
+
+template<typename PrimitiveTest>
+bool Bvh::traverse(const Ray &ray, float max_distance, bool any_hit, PrimitiveTest test) const
+{
+    if (!node_count)
+        return false;
+
+    Vec3 inverse_direction(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+    struct StackEntry {
+        uint32_t node;
+        float distance;
+    };
+
+    StackEntry stack[max_depth + 1];
+    unsigned int stack_size = 0;
+
+    uint32_t node_index = 0;
+    bool hit = false;
+
+    if (intersect_node(nodes[0], ray.origin, inverse_direction, max_distance) == INFINITY)
+        return false;
+
+    while (true) {
+        const BvhNode &node = nodes[node_index];
+
+        if (node.count) {
+            for (uint32_t i = node.offset; i < node.offset + node.count; i++) {
+                if (test(indices[i], &max_distance)) {
+                    hit = true;
+
+                    if (any_hit)
+                        return true;
+                }
+            }
+        }
+        else {
+            /**
+             * Visit the nearer child first so hits found there prune the other one.
+             */
+            uint32_t first = node_index + 1;
+            uint32_t second = node.offset;
+
+            float first_distance = intersect_node(nodes[first], ray.origin, inverse_direction, max_distance);
+            float second_distance = intersect_node(nodes[second], ray.origin, inverse_direction, max_distance);
+
+            if (second_distance < first_distance) {
+                std::swap(first, second);
+                std::swap(first_distance, second_distance);
+            }
+
+            if (first_distance != INFINITY) {
+                if (second_distance != INFINITY)
+                    stack[stack_size++] = {second, second_distance};
+
+                node_index = first;
+                continue;
+            }
+        }
+
+        /**
+         * Skip the deferred nodes that hits found since lie behind.
+         */
+        while (stack_size && stack[stack_size - 1].distance > max_distance)
+            stack_size--;
+
+        if (!stack_size)
+            break;
+
+        node_index = stack[--stack_size].node;
+    }
+
+    return hit;
+}
+
+#endif //HELIOS_BVH_H
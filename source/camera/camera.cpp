@@ -24,6 +24,56 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "camera.h"
 
 
+void Camera::set_type(CameraType type)
+{
+    this->type = type;
+}
+
+Camera::CameraType Camera::get_type() const
+{
+    return type;
+}
+
+void Camera::set_up(const Vec3 &up)
+{
+    this->up = up;
+}
+
+const Vec3 &Camera::get_up() const
+{
+    return up;
+}
+
+void Camera::set_aperture(float radius)
+{
+    aperture = radius > 0.0f ? radius : 0.0f;
+}
+
+float Camera::get_aperture() const
+{
+    return aperture;
+}
+
+void Camera::set_focus_distance(float distance)
+{
+    focus_distance = distance;
+}
+
+float Camera::get_focus_distance() const
+{
+    return focus_distance;
+}
+
+void Camera::set_orthographic_height(float height)
+{
+    orthographic_height = height;
+}
+
+float Camera::get_orthographic_height() const
+{
+    return orthographic_height;
+}
+
 void Camera::set_target(const Vec3 &target)
 {
     this->target = target;
@@ -57,25 +107,28 @@ void Camera::calculate_transformation()
 
     camera_dir.normalize();
 
+    Vec3 right = cross(this->up, camera_dir);
+
     /**
-     * Assume the up camera vector points towards the positive y axis.
+     * Looking along the up vector, any perpendicular direction will do.
      */
-    Vec3 up(0.0f, 1.0f, 0.0f);
-    Vec3 right = cross(up, camera_dir);
+    if (!right.length_squared())
+        right = cross(fabs(camera_dir.y) < 0.9f ? Vec3(0.0f, 1.0f, 0.0f) : Vec3(1.0f, 0.0f, 0.0f), camera_dir);
+
     right.normalize();
 
     /**
      * Compute the actual up vector.
      */
-    up = cross(camera_dir, right);
-    up.normalize();
+    Vec3 camera_up = cross(camera_dir, right);
+    camera_up.normalize();
 
     /**
      * Create the correct camera matrix.
      */
-    transformation = Mat4(right.x, up.x, camera_dir.x, 0,
-                          right.y, up.y, camera_dir.y, 0,
-                          right.z, up.z, camera_dir.z, 0,
+    transformation = Mat4(right.x, camera_up.x, camera_dir.x, 0,
+                          right.y, camera_up.y, camera_dir.y, 0,
+                          right.z, camera_up.z, camera_dir.z, 0,
                           0.0f   , 0.0f,    0.0f     , 1);
 
     Mat4 translation;
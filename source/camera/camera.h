@@ -24,16 +24,48 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <object.h>
 
 class Camera : public Object {
+public:
+    enum CameraType {
+        CAM_PINHOLE,
+
+        /**
+         * Perspective camera with a circular lens of the aperture radius, focused at the focus
+         * distance along the view direction.
+         */
+        CAM_THIN_LENS,
+
+        /**
+         * Parallel rays over a view of the orthographic height.
+         */
+        CAM_ORTHOGRAPHIC,
+
+        /**
+         * 360 by 180 degree latitude-longitude panorama around the view direction. The field of
+         * view is not used.
+         */
+        CAM_EQUIRECTANGULAR
+    };
+
 private:
     Vec3 target = Vec3(0.0f, 0.0f, 1.0f);
 
+    Vec3 up = Vec3(0.0f, 1.0f, 0.0f);
+
     Mat4 transformation;
 
+    CameraType type = CAM_PINHOLE;
+
     /**
      * The Field of View in radians.
      */
     float fov = 0;
 
+    float aperture = 0.0f;
+
+    float focus_distance = 1.0f;
+
+    float orthographic_height = 2.0f;
+
 public:
     Camera() = default;
 
@@ -45,6 +77,30 @@ public:
         CAM_FOV_DEGREES
     };
 
+    void set_type(CameraType type);
+
+    CameraType get_type() const;
+
+    /**
+     * The direction the top of the image points to, it does not have to be orthogonal to the
+     * view direction.
+     */
+    void set_up(const Vec3 &up);
+
+    const Vec3 &get_up() const;
+
+    void set_aperture(float radius);
+
+    float get_aperture() const;
+
+    void set_focus_distance(float distance);
+
+    float get_focus_distance() const;
+
+    void set_orthographic_height(float height);
+
+    float get_orthographic_height() const;
+
     void set_target(const Vec3 &target);
 
     const Vec3 &get_target() const;
@@ -0,0 +1,420 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef _WIN32
+#define _USE_MATH_DEFINES
+#endif
+
+#include <math.h>
+#include <algorithm>
+#include "camera_ray_generator.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Maps two uniform numbers in [0, 1) to the unit disk with Shirley and Chiu's concentric mapping,
+ * which keeps the strata of the numbers compact on the lens.
+ */
+static void sample_concentric_disk(float u, float v, float *x, float *y)
+{
+    float a = 2.0f * u - 1.0f;
+    float b = 2.0f * v - 1.0f;
+
+    if (a == 0.0f && b == 0.0f) {
+        *x = *y = 0.0f;
+        return;
+    }
+
+    float radius, angle;
+
+    if (fabs(a) > fabs(b)) {
+        radius = a;
+        angle = (float) M_PI_4 * (b / a);
+    }
+    else {
+        radius = b;
+        angle = (float) M_PI_2 - (float) M_PI_4 * (a / b);
+    }
+
+    *x = radius * cosf(angle);
+    *y = radius * sinf(angle);
+}
+
+void CameraRayBatch::resize(size_t count, bool shared_origin)
+{
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+
+    if (!shared_origin) {
+        origin_x.resize(count);
+        origin_y.resize(count);
+        origin_z.resize(count);
+    }
+
+    this->count = count;
+    this->shared_origin = shared_origin;
+}
+
+void CameraRayGenerator::set_camera(const Camera &camera, unsigned int frame_width, unsigned int frame_height)
+{
+    Camera transformed = camera;
+    transformed.calculate_transformation();
+
+    const Mat4 &matrix = transformed.get_transformation_matrix();
+
+    /**
+     * The columns of the camera matrix are the basis vectors and the position.
+     */
+    right = Vec3(matrix[0][0], matrix[1][0], matrix[2][0]);
+    up = Vec3(matrix[0][1], matrix[1][1], matrix[2][1]);
+    forward = Vec3(matrix[0][2], matrix[1][2], matrix[2][2]);
+    origin = Vec3(matrix[0][3], matrix[1][3], matrix[2][3]);
+
+    this->frame_width = (float) frame_width;
+    this->frame_height = (float) frame_height;
+
+    aspect = this->frame_width / this->frame_height;
+    focal_length = 1.0f / (float) tan(camera.get_fov() / 2.0f);
+
+    type = camera.get_type();
+    aperture = camera.get_aperture();
+    focus_distance = camera.get_focus_distance();
+    orthographic_height = camera.get_orthographic_height();
+}
+
+float CameraRayGenerator::get_circle_of_confusion(const Vec3 &point) const
+{
+    if (!has_lens() || focus_distance <= 0.0f)
+        return 0.0f;
+
+    float depth = dot(point - origin, forward);
+
+    if (depth <= 0.0f)
+        return 0.0f;
+
+    /**
+     * The lens blurs the point into a circle of 2 * aperture * |depth - focus| / depth on the focus
+     * plane, where a pixel covers 2 * focus / (focal length * frame height).
+     */
+    return aperture * (float) fabs(depth - focus_distance) * focal_length * frame_height / (depth * focus_distance);
+}
+
+float CameraRayGenerator::get_background_circle_of_confusion() const
+{
+    if (!has_lens() || focus_distance <= 0.0f)
+        return 0.0f;
+
+    return aperture * focal_length * frame_height / focus_distance;
+}
+
+bool CameraRayGenerator::project_bounds(const Vec3 &min, const Vec3 &max, float *x0, float *y0, float *x1,
+                                        float *y1) const
+{
+    if (type == Camera::CAM_EQUIRECTANGULAR)
+        return false;
+
+    *x0 = *y0 = INFINITY;
+    *x1 = *y1 = -INFINITY;
+
+    float blur = 0.0f;
+
+    /**
+     * The projection of a box in front of the camera is within that of its corners, and so is
+     * the lens blur, which only grows with the distance from the focus plane.
+     */
+    for (int corner = 0; corner < 8; corner++) {
+        Vec3 point(corner & 1 ? max.x : min.x, corner & 2 ? max.y : min.y, corner & 4 ? max.z : min.z);
+        Vec3 offset = point - origin;
+
+        float screen_x = dot(offset, right);
+        float screen_y = dot(offset, up);
+
+        if (type == Camera::CAM_ORTHOGRAPHIC) {
+            float half_height = orthographic_height * 0.5f;
+
+            screen_x /= aspect * half_height;
+            screen_y /= half_height;
+        }
+        else {
+            float depth = dot(offset, forward);
+
+            if (depth <= 0.0f)
+                return false;
+
+            screen_x *= focal_length / (depth * aspect);
+            screen_y *= focal_length / depth;
+        }
+
+        float pixel_x = (screen_x + 1.0f) * 0.5f * frame_width;
+        float pixel_y = (1.0f - screen_y) * 0.5f * frame_height;
+
+        *x0 = std::min(*x0, pixel_x);
+        *y0 = std::min(*y0, pixel_y);
+        *x1 = std::max(*x1, pixel_x);
+        *y1 = std::max(*y1, pixel_y);
+
+        blur = std::max(blur, get_circle_of_confusion(point));
+    }
+
+    *x0 -= blur * 0.5f;
+    *y0 -= blur * 0.5f;
+    *x1 += blur * 0.5f;
+    *y1 += blur * 0.5f;
+
+    return true;
+}
+
+Ray CameraRayGenerator::generate_projected(float pixel_x, float pixel_y, float lens_u, float lens_v) const
+{
+    Vec3 direction;
+    Vec3 ray_origin = origin;
+
+    switch (type) {
+        case Camera::CAM_ORTHOGRAPHIC: {
+            float half_height = orthographic_height * 0.5f;
+
+            float screen_x = (2.0f * pixel_x / frame_width - 1.0f) * aspect * half_height;
+            float screen_y = (1.0f - 2.0f * pixel_y / frame_height) * half_height;
+
+            ray_origin = Vec3(origin.x + (right.x * screen_x + up.x * screen_y),
+                              origin.y + (right.y * screen_x + up.y * screen_y),
+                              origin.z + (right.z * screen_x + up.z * screen_y));
+
+            return Ray(ray_origin, forward);
+        }
+        case Camera::CAM_EQUIRECTANGULAR: {
+            /**
+             * Longitude 0 is the view direction, the top row looks along the up vector.
+             */
+            float longitude = (2.0f * pixel_x / frame_width - 1.0f) * (float) M_PI;
+            float polar = pixel_y / frame_height * (float) M_PI;
+
+            direction = Vec3(sinf(polar) * sinf(longitude), cosf(polar), sinf(polar) * cosf(longitude));
+            break;
+        }
+        case Camera::CAM_THIN_LENS: {
+            direction = Vec3((2.0f * pixel_x / frame_width - 1.0f) * aspect, 1.0f - 2.0f * pixel_y / frame_height,
+                             focal_length);
+
+            /**
+             * Every lens point sends the ray to the same point on the focus plane.
+             */
+            Vec3 focus = direction * (focus_distance / focal_length);
+
+            float lens_x, lens_y;
+            sample_concentric_disk(lens_u, lens_v, &lens_x, &lens_y);
+
+            lens_x *= aperture;
+            lens_y *= aperture;
+
+            direction = Vec3(focus.x - lens_x, focus.y - lens_y, focus.z);
+            direction.normalize();
+
+            ray_origin = origin + right * lens_x + up * lens_y;
+            break;
+        }
+        default:
+            return generate(pixel_x, pixel_y);
+    }
+
+    return Ray(ray_origin, right * direction.x + up * direction.y + forward * direction.z);
+}
+
+void CameraRayGenerator::generate_directions(const float *pixel_x, const float *pixel_y, size_t count, float *x,
+                                             float *y, float *z) const
+{
+    size_t i = 0;
+
+    /**
+     * Same operations in the same order as generate(), so both give identical rays.
+     */
+#ifdef __SSE2__
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 width = _mm_set1_ps(frame_width);
+    const __m128 height = _mm_set1_ps(frame_height);
+    const __m128 aspect_ratio = _mm_set1_ps(aspect);
+    const __m128 dz = _mm_set1_ps(focal_length);
+    const __m128 dz_squared = _mm_mul_ps(dz, dz);
+
+    const __m128 basis[9] = {
+            _mm_set1_ps(right.x), _mm_set1_ps(up.x), _mm_set1_ps(forward.x),
+            _mm_set1_ps(right.y), _mm_set1_ps(up.y), _mm_set1_ps(forward.y),
+            _mm_set1_ps(right.z), _mm_set1_ps(up.z), _mm_set1_ps(forward.z)
+    };
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 dx = _mm_mul_ps(_mm_sub_ps(_mm_div_ps(_mm_mul_ps(two, _mm_loadu_ps(pixel_x + i)), width), one),
+                               aspect_ratio);
+        __m128 dy = _mm_sub_ps(one, _mm_div_ps(_mm_mul_ps(two, _mm_loadu_ps(pixel_y + i)), height));
+
+        __m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), dz_squared));
+
+        dx = _mm_div_ps(dx, length);
+        dy = _mm_div_ps(dy, length);
+        __m128 normalized_dz = _mm_div_ps(dz, length);
+
+        float *outputs[3] = {x, y, z};
+
+        for (int axis = 0; axis < 3; axis++) {
+            const __m128 *row = basis + axis * 3;
+
+            __m128 value = _mm_add_ps(_mm_add_ps(_mm_mul_ps(row[0], dx), _mm_mul_ps(row[1], dy)),
+                                      _mm_mul_ps(row[2], normalized_dz));
+
+            _mm_storeu_ps(outputs[axis] + i, value);
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        Ray ray = generate(pixel_x[i], pixel_y[i]);
+
+        x[i] = ray.direction.x;
+        y[i] = ray.direction.y;
+        z[i] = ray.direction.z;
+    }
+}
+
+void CameraRayGenerator::generate_orthographic(const float *pixel_x, const float *pixel_y, size_t count,
+                                               CameraRayBatch *batch) const
+{
+    std::fill(batch->x.begin(), batch->x.end(), forward.x);
+    std::fill(batch->y.begin(), batch->y.end(), forward.y);
+    std::fill(batch->z.begin(), batch->z.end(), forward.z);
+
+    size_t i = 0;
+
+#ifdef __SSE2__
+    float half_height = orthographic_height * 0.5f;
+
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 two = _mm_set1_ps(2.0f);
+    const __m128 width = _mm_set1_ps(frame_width);
+    const __m128 height = _mm_set1_ps(frame_height);
+    const __m128 aspect_ratio = _mm_set1_ps(aspect);
+    const __m128 half = _mm_set1_ps(half_height);
+
+    const __m128 basis[9] = {
+            _mm_set1_ps(origin.x), _mm_set1_ps(right.x), _mm_set1_ps(up.x),
+            _mm_set1_ps(origin.y), _mm_set1_ps(right.y), _mm_set1_ps(up.y),
+            _mm_set1_ps(origin.z), _mm_set1_ps(right.z), _mm_set1_ps(up.z)
+    };
+
+    float *outputs[3] = {batch->origin_x.data(), batch->origin_y.data(), batch->origin_z.data()};
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 screen_x = _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(_mm_div_ps(_mm_mul_ps(two, _mm_loadu_ps(pixel_x + i)),
+                                                                      width), one), aspect_ratio), half);
+        __m128 screen_y = _mm_mul_ps(_mm_sub_ps(one, _mm_div_ps(_mm_mul_ps(two, _mm_loadu_ps(pixel_y + i)), height)),
+                                     half);
+
+        for (int axis = 0; axis < 3; axis++) {
+            const __m128 *row = basis + axis * 3;
+
+            __m128 value = _mm_add_ps(row[0], _mm_add_ps(_mm_mul_ps(row[1], screen_x), _mm_mul_ps(row[2], screen_y)));
+
+            _mm_storeu_ps(outputs[axis] + i, value);
+        }
+    }
+#endif
+
+    for (; i < count; i++) {
+        Ray ray = generate_projected(pixel_x[i], pixel_y[i], 0.5f, 0.5f);
+
+        batch->origin_x[i] = ray.origin.x;
+        batch->origin_y[i] = ray.origin.y;
+        batch->origin_z[i] = ray.origin.z;
+    }
+}
+
+void CameraRayGenerator::generate(const float *pixel_x, const float *pixel_y, const float *lens_u,
+                                  const float *lens_v, size_t count, CameraRayBatch *batch) const
+{
+    bool shared_origin = type == Camera::CAM_PINHOLE || type == Camera::CAM_EQUIRECTANGULAR;
+
+    batch->resize(count, shared_origin);
+    batch->origin = origin;
+
+    if (type == Camera::CAM_PINHOLE) {
+        generate_directions(pixel_x, pixel_y, count, batch->x.data(), batch->y.data(), batch->z.data());
+        return;
+    }
+
+    if (type == Camera::CAM_ORTHOGRAPHIC) {
+        generate_orthographic(pixel_x, pixel_y, count, batch);
+        return;
+    }
+
+    /**
+     * Panoramic and lens rays need trigonometry per ray and are generated one by one.
+     */
+    for (size_t i = 0; i < count; i++) {
+        Ray ray = generate_projected(pixel_x[i], pixel_y[i], lens_u ? lens_u[i] : 0.5f, lens_v ? lens_v[i] : 0.5f);
+
+        batch->x[i] = ray.direction.x;
+        batch->y[i] = ray.direction.y;
+        batch->z[i] = ray.direction.z;
+
+        if (!shared_origin) {
+            batch->origin_x[i] = ray.origin.x;
+            batch->origin_y[i] = ray.origin.y;
+            batch->origin_z[i] = ray.origin.z;
+        }
+    }
+}
+
+void CameraRayGenerator::generate_tile(unsigned int x, unsigned int y, unsigned int width, unsigned int height,
+                                       CameraRayBatch *batch) const
+{
+    size_t count = (size_t) width * height;
+
+    std::vector<float> coordinates;
+
+    /**
+     * Pinhole directions are converted in place from the frame coordinates written to the
+     * direction arrays.
+     */
+    float *pixel_x, *pixel_y;
+
+    if (type == Camera::CAM_PINHOLE) {
+        batch->resize(count, true);
+        pixel_x = batch->x.data();
+        pixel_y = batch->y.data();
+    }
+    else {
+        coordinates.resize(count * 2);
+        pixel_x = coordinates.data();
+        pixel_y = coordinates.data() + count;
+    }
+
+    float *x_output = pixel_x;
+    float *y_output = pixel_y;
+
+    for (unsigned int row = 0; row < height; row++) {
+        for (unsigned int column = 0; column < width; column++) {
+            *x_output++ = (float) (x + column);
+            *y_output++ = (float) (y + row);
+        }
+    }
+
+    generate(pixel_x, pixel_y, nullptr, nullptr, count, batch);
+}
@@ -0,0 +1,177 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_CAMERA_RAY_GENERATOR_H
+#define HELIOS_CAMERA_RAY_GENERATOR_H
+
+#include <stddef.h>
+#include <vector>
+#include <ray.h>
+#include "camera.h"
+
+/**
+ * Camera rays in structure of arrays form with normalized directions. Pinhole and panoramic
+ * rays all start at the camera position, orthographic and thin lens rays have their own origins.
+ */
+struct CameraRayBatch {
+    bool shared_origin = true;
+
+    Vec3 origin;
+
+    std::vector<float> origin_x;
+    std::vector<float> origin_y;
+    std::vector<float> origin_z;
+
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<float> z;
+
+    size_t count = 0;
+
+    void resize(size_t count, bool shared_origin);
+
+    Ray get_ray(size_t index) const
+    {
+        Vec3 direction(x[index], y[index], z[index]);
+
+        if (shared_origin)
+            return Ray(origin, direction);
+
+        return Ray(Vec3(origin_x[index], origin_y[index], origin_z[index]), direction);
+    }
+};
+
+/**
+ * Generates the primary rays of a camera. The camera basis, aspect ratio and focal length are
+ * computed once per frame by set_camera() instead of for every ray. Pinhole rays are identical
+ * to transforming the camera space ray by the camera's transformation matrix.
+ */
+class CameraRayGenerator {
+private:
+    Camera::CameraType type = Camera::CAM_PINHOLE;
+
+    Vec3 origin;
+
+    Vec3 right;
+    Vec3 up;
+    Vec3 forward;
+
+    float frame_width = 1.0f;
+    float frame_height = 1.0f;
+
+    float aspect = 1.0f;
+
+    /**
+     * Distance of the image plane for a [-1, 1] vertical extent, 1 / tan(fov / 2).
+     */
+    float focal_length = 1.0f;
+
+    float aperture = 0.0f;
+
+    float focus_distance = 1.0f;
+
+    float orthographic_height = 2.0f;
+
+    /**
+     * Writes the pinhole directions through the given frame coordinates. The outputs may be the
+     * inputs.
+     */
+    void generate_directions(const float *pixel_x, const float *pixel_y, size_t count, float *x, float *y,
+                             float *z) const;
+
+    /**
+     * Writes the orthographic ray origins, the directions are all the view direction.
+     */
+    void generate_orthographic(const float *pixel_x, const float *pixel_y, size_t count, CameraRayBatch *batch) const;
+
+    /**
+     * Rays of the cameras other than the pinhole.
+     */
+    Ray generate_projected(float pixel_x, float pixel_y, float lens_u, float lens_v) const;
+
+public:
+    void set_camera(const Camera &camera, unsigned int frame_width, unsigned int frame_height);
+
+    Camera::CameraType get_type() const
+    {
+        return type;
+    }
+
+    /**
+     * Whether the rays depend on the lens sample, which is the case for thin lens cameras with
+     * an aperture.
+     */
+    bool has_lens() const
+    {
+        return type == Camera::CAM_THIN_LENS && aperture > 0.0f;
+    }
+
+    /**
+     * Diameter in pixels of the circle a point is blurred into by the lens, 0 without one.
+     */
+    float get_circle_of_confusion(const Vec3 &point) const;
+
+    /**
+     * Diameter in pixels of the circle the lens blurs points at infinity into.
+     */
+    float get_background_circle_of_confusion() const;
+
+    /**
+     * Frame coordinates of the rectangle the rays that hit the box pass through, widened by the
+     * lens blur of thin lens cameras. Returns false if part of the box is behind the camera
+     * plane, and for panoramic cameras.
+     */
+    bool project_bounds(const Vec3 &min, const Vec3 &max, float *x0, float *y0, float *x1, float *y1) const;
+
+    /**
+     * The ray through the given frame coordinates and the point of the lens given by two
+     * uniform numbers in [0, 1). Integer coordinates correspond to the top left corner of a
+     * pixel, the lens point (0.5, 0.5) is the lens centre.
+     */
+    Ray generate(float pixel_x, float pixel_y, float lens_u = 0.5f, float lens_v = 0.5f) const
+    {
+        if (type != Camera::CAM_PINHOLE)
+            return generate_projected(pixel_x, pixel_y, lens_u, lens_v);
+
+        Vec3 direction((2.0f * pixel_x / frame_width - 1.0f) * aspect, 1.0f - 2.0f * pixel_y / frame_height,
+                       focal_length);
+
+        direction.normalize();
+
+        return Ray(origin, Vec3(right.x * direction.x + up.x * direction.y + forward.x * direction.z,
+                                right.y * direction.x + up.y * direction.y + forward.y * direction.z,
+                                right.z * direction.x + up.z * direction.y + forward.z * direction.z));
+    }
+
+    /**
+     * Generates the rays through count frame coordinates. Pinhole and orthographic rays are
+     * generated four at a time with SSE2. The lens samples may be nullptr for rays through the
+     * lens centre.
+     */
+    void generate(const float *pixel_x, const float *pixel_y, const float *lens_u, const float *lens_v,
+                  size_t count, CameraRayBatch *batch) const;
+
+    /**
+     * Generates the rays through the top left corners of a tile's pixels and the lens centre in
+     * row major order.
+     */
+    void generate_tile(unsigned int x, unsigned int y, unsigned int width, unsigned int height,
+                       CameraRayBatch *batch) const;
+};
+
+#endif //HELIOS_CAMERA_RAY_GENERATOR_H
@@ -0,0 +1,293 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <thread_pool.h>
+#include "denoiser.h"
+
+using namespace std::chrono;
+
+/**
+ * Per pixel inputs of a denoise() call, all as width * height * 3 floats.
+ * Feature buffers that were not given are left empty.
+ */
+struct Denoiser::Buffers {
+    unsigned int width;
+    unsigned int height;
+
+    std::vector<float> normal;
+    std::vector<float> albedo;
+    std::vector<float> depth;
+};
+
+/* Static functions */
+
+static bool read_image(const Image *image, unsigned int width, unsigned int height, std::vector<float> &values)
+{
+    if (!image)
+        return true;
+
+    if (image->get_width() != width || image->get_height() != height) {
+        std::cerr << "Denoiser ERROR: Feature buffer size differs from the color image." << std::endl;
+        return false;
+    }
+
+    values.resize((size_t) width * height * 3);
+    image->read_rows(0, height, values.data());
+
+    return true;
+}
+
+static inline float squared_distance(const float *a, const float *b)
+{
+    float x = a[0] - b[0];
+    float y = a[1] - b[1];
+    float z = a[2] - b[2];
+
+    return x * x + y * y + z * z;
+}
+
+/**
+ * Small offset that keeps the albedo division finite on black materials.
+ */
+static const float albedo_epsilon = 0.01f;
+
+/* ------------------------------------------------------------------*/
+
+/* Private Functions */
+
+void Denoiser::filter_rows(const Buffers &buffers, const float *in, float *out, unsigned int step,
+                           float pass_color_sigma, unsigned int first_row, unsigned int last_row) const
+{
+    static const float kernel[5] = {1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+
+    unsigned int width = buffers.width;
+    unsigned int height = buffers.height;
+
+    const float *normal = buffers.normal.empty() ? nullptr : buffers.normal.data();
+    const float *albedo = buffers.albedo.empty() ? nullptr : buffers.albedo.data();
+    const float *depth = buffers.depth.empty() ? nullptr : buffers.depth.data();
+
+    float inv_color = 1.0f / (pass_color_sigma * pass_color_sigma);
+    float inv_normal = 1.0f / (normal_sigma * normal_sigma);
+    float inv_albedo = 1.0f / (albedo_sigma * albedo_sigma);
+
+    for (unsigned int y = first_row; y < last_row; y++) {
+        for (unsigned int x = 0; x < width; x++) {
+            size_t p = ((size_t) y * width + x) * 3;
+
+            /**
+             * Colors are compared after tone mapping so bright pixels don't dominate.
+             */
+            float center[3] = {in[p] / (1.0f + in[p]), in[p + 1] / (1.0f + in[p + 1]),
+                               in[p + 2] / (1.0f + in[p + 2])};
+
+            float inv_depth = 0.0f;
+
+            if (depth) {
+                float scale = depth_sigma * std::max(depth[p], 1e-3f);
+                inv_depth = 1.0f / (scale * scale);
+            }
+
+            float sum[3] = {0.0f, 0.0f, 0.0f};
+            float weight_sum = 0.0f;
+
+            for (int j = -2; j <= 2; j++) {
+                long qy = (long) y + j * (long) step;
+
+                if (qy < 0 || qy >= (long) height)
+                    continue;
+
+                for (int i = -2; i <= 2; i++) {
+                    long qx = (long) x + i * (long) step;
+
+                    if (qx < 0 || qx >= (long) width)
+                        continue;
+
+                    size_t q = ((size_t) qy * width + (size_t) qx) * 3;
+
+                    float tap[3] = {in[q] / (1.0f + in[q]), in[q + 1] / (1.0f + in[q + 1]),
+                                    in[q + 2] / (1.0f + in[q + 2])};
+
+                    float exponent = squared_distance(center, tap) * inv_color;
+
+                    if (normal)
+                        exponent += squared_distance(normal + p, normal + q) * inv_normal;
+
+                    if (albedo)
+                        exponent += squared_distance(albedo + p, albedo + q) * inv_albedo;
+
+                    if (depth) {
+                        float difference = depth[q] - depth[p];
+                        exponent += difference * difference * inv_depth;
+                    }
+
+                    float weight = kernel[i + 2] * kernel[j + 2] * expf(-exponent);
+
+                    sum[0] += in[q] * weight;
+                    sum[1] += in[q + 1] * weight;
+                    sum[2] += in[q + 2] * weight;
+                    weight_sum += weight;
+                }
+            }
+
+            /**
+             * The center tap always has weight, so weight_sum is never zero.
+             */
+            out[p] = sum[0] / weight_sum;
+            out[p + 1] = sum[1] / weight_sum;
+            out[p + 2] = sum[2] / weight_sum;
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------- */
+
+void Denoiser::set_iterations(unsigned int iterations)
+{
+    this->iterations = iterations;
+}
+
+void Denoiser::set_sigmas(float color_sigma, float normal_sigma, float albedo_sigma, float depth_sigma)
+{
+    this->color_sigma = color_sigma;
+    this->normal_sigma = normal_sigma;
+    this->albedo_sigma = albedo_sigma;
+    this->depth_sigma = depth_sigma;
+}
+
+bool Denoiser::denoise(const Image &color, const Image *normal, const Image *albedo, const Image *depth,
+                       Image *output)
+{
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    Buffers buffers;
+    buffers.width = color.get_width();
+    buffers.height = color.get_height();
+
+    if (!buffers.width || !buffers.height) {
+        std::cerr << "Denoiser ERROR: Empty color image." << std::endl;
+        return false;
+    }
+
+    if (!read_image(normal, buffers.width, buffers.height, buffers.normal) ||
+        !read_image(albedo, buffers.width, buffers.height, buffers.albedo) ||
+        !read_image(depth, buffers.width, buffers.height, buffers.depth))
+        return false;
+
+    ThreadPool &thread_pool = ThreadPool::get_shared();
+
+    if (!thread_pool.initialize())
+        return false;
+
+    size_t value_count = (size_t) buffers.width * buffers.height * 3;
+
+    std::vector<float> current(value_count);
+    std::vector<float> next(value_count);
+
+    color.read_rows(0, buffers.height, current.data());
+
+    if (!buffers.albedo.empty()) {
+        for (size_t i = 0; i < value_count; i++) {
+            current[i] /= buffers.albedo[i] + albedo_epsilon;
+        }
+    }
+
+    /**
+     * Bands of rows are filtered in parallel, every iteration waits for the previous one.
+     */
+    static const unsigned int band_size = 16;
+
+    for (unsigned int iteration = 0; iteration < iterations; iteration++) {
+        unsigned int step = 1u << iteration;
+        float pass_color_sigma = color_sigma / step;
+
+        const float *in = current.data();
+        float *out = next.data();
+
+        std::vector< std::function<void()> > jobs;
+
+        for (unsigned int row = 0; row < buffers.height; row += band_size) {
+            unsigned int last_row = std::min(row + band_size, buffers.height);
+
+            jobs.push_back([this, &buffers, in, out, step, pass_color_sigma, row, last_row] {
+                filter_rows(buffers, in, out, step, pass_color_sigma, row, last_row);
+            });
+        }
+
+        thread_pool.add_jobs(jobs);
+        thread_pool.wait();
+
+        current.swap(next);
+    }
+
+    if (!buffers.albedo.empty()) {
+        for (size_t i = 0; i < value_count; i++) {
+            current[i] *= buffers.albedo[i] + albedo_epsilon;
+        }
+    }
+
+    if (!output->create(buffers.width, buffers.height))
+        return false;
+
+    output->write_rows(0, buffers.height, current.data());
+
+    denoise_time = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+
+    std::cout << "Denoised (" << buffers.width << " x " << buffers.height << ") with " << iterations
+              << " iterations in " << denoise_time << "ms" << std::endl;
+
+    return true;
+}
+
+double Denoiser::get_denoise_time() const
+{
+    return denoise_time;
+}
+
+double Denoiser::rmse(const Image &image, const Image &reference)
+{
+    unsigned int width = image.get_width();
+    unsigned int height = image.get_height();
+
+    if (width != reference.get_width() || height != reference.get_height()) {
+        std::cerr << "Denoiser ERROR: Cannot compare images of different sizes." << std::endl;
+        return -1.0;
+    }
+
+    std::vector<float> a((size_t) width * 3);
+    std::vector<float> b((size_t) width * 3);
+
+    double sum = 0.0;
+
+    for (unsigned int y = 0; y < height; y++) {
+        image.read_rows(y, 1, a.data());
+        reference.read_rows(y, 1, b.data());
+
+        for (size_t i = 0; i < a.size(); i++) {
+            double difference = a[i] - b[i];
+            sum += difference * difference;
+        }
+    }
+
+    return sqrt(sum / ((double) width * height * 3));
+}
@@ -0,0 +1,75 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_DENOISER_H
+#define HELIOS_DENOISER_H
+
+#include <image.h>
+
+/**
+ * Edge-avoiding À-trous wavelet filter (Dammertz et al., 2010).
+ *
+ * Every iteration convolves the image with a 5x5 B3 spline kernel whose taps are spread
+ * 2^i pixels apart. Each tap is weighted down by how much its color, normal, albedo and
+ * depth differ from the center pixel, so the blur stops at geometric and material edges.
+ * When an albedo buffer is given, the filter works on the color divided by the albedo so
+ * that texture detail is not blurred away.
+ */
+class Denoiser {
+private:
+    unsigned int iterations = 5;
+
+    /**
+     * Edge-stopping widths. The color one applies to tone mapped values and is halved every
+     * iteration, the depth one is relative to the center pixel's depth.
+     */
+    float color_sigma = 0.6f;
+    float normal_sigma = 0.3f;
+    float albedo_sigma = 0.1f;
+    float depth_sigma = 0.05f;
+
+    double denoise_time = 0.0;
+
+    struct Buffers;
+
+    void filter_rows(const Buffers &buffers, const float *in, float *out, unsigned int step, float pass_color_sigma,
+                     unsigned int first_row, unsigned int last_row) const;
+
+public:
+    void set_iterations(unsigned int iterations);
+
+    void set_sigmas(float color_sigma, float normal_sigma, float albedo_sigma, float depth_sigma);
+
+    /**
+     * Denoises color into output, which is (re)created with IMG_PIXEL_FLOAT pixels. Any of
+     * the feature buffers may be null; given ones must match the color image's size.
+     */
+    bool denoise(const Image &color, const Image *normal, const Image *albedo, const Image *depth, Image *output);
+
+    /**
+     * Wall clock time of the last denoise() call in milliseconds.
+     */
+    double get_denoise_time() const;
+
+    /**
+     * Root mean square error of the linear values of two images of the same size.
+     */
+    static double rmse(const Image &image, const Image &reference);
+};
+
+#endif //HELIOS_DENOISER_H
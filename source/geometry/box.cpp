@@ -17,8 +17,94 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include "box.h"
+#include <math.h>
+#include <algorithm>
+
+Vec3 Box::get_size() const
+{
+    return Vec3((float) length, (float) width, (float) height);
+}
 
 bool Box::intersect(const Ray &ray, HitPoint *hit_point)
 {
-    return false;
+    if (!intersect(position, get_size(), ray, hit_point))
+        return false;
+
+    hit_point->object = this;
+
+    return true;
+}
+
+bool Box::get_bounds(Vec3 *min, Vec3 *max) const
+{
+    Vec3 half_size = Vec3((float) length, (float) height, (float) width) * 0.5f;
+
+    *min = position - half_size;
+    *max = position + half_size;
+
+    return true;
+}
+
+bool Box::intersect(const Vec3 &position, const Vec3 &size, const Ray &ray, HitPoint *hit_point)
+{
+    /**
+     * Slab test against the axis aligned box centered at the position.
+     */
+    float origin[3] = {ray.origin.x - position.x, ray.origin.y - position.y, ray.origin.z - position.z};
+    float direction[3] = {ray.direction.x, ray.direction.y, ray.direction.z};
+    float half_size[3] = {size.x * 0.5f, size.z * 0.5f, size.y * 0.5f};
+
+    float t_near = -INFINITY;
+    float t_far = INFINITY;
+    int near_axis = 0;
+    int far_axis = 0;
+
+    for (int axis = 0; axis < 3; axis++) {
+        if (direction[axis] == 0.0f) {
+            if (fabs(origin[axis]) > half_size[axis])
+                return false;
+
+            continue;
+        }
+
+        float t0 = (-half_size[axis] - origin[axis]) / direction[axis];
+        float t1 = (half_size[axis] - origin[axis]) / direction[axis];
+
+        if (t0 > t1)
+            std::swap(t0, t1);
+
+        if (t0 > t_near) {
+            t_near = t0;
+            near_axis = axis;
+        }
+
+        if (t1 < t_far) {
+            t_far = t1;
+            far_axis = axis;
+        }
+    }
+
+    if (t_near > t_far || t_far < 1e-4)
+        return false;
+
+    /**
+     * Rays starting inside the box hit its far side.
+     */
+    float t = t_near;
+    int axis = near_axis;
+
+    if (t < 1e-4) {
+        t = t_far;
+        axis = far_axis;
+    }
+
+    hit_point->position = ray.origin + ray.direction * t;
+    hit_point->distance = t;
+
+    float normal[3] = {0.0f, 0.0f, 0.0f};
+    normal[axis] = origin[axis] + direction[axis] * t > 0.0f ? 1.0f : -1.0f;
+
+    hit_point->normal = Vec3(normal[0], normal[1], normal[2]);
+
+    return true;
 }
@@ -21,6 +21,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "drawable.h"
 
+/**
+ * An axis aligned box centered at its position, with its length along x, height along y and
+ * width along z.
+ */
 class Box : public Drawable {
 protected:
     double length;
@@ -34,7 +38,19 @@ public:
             : Drawable(position), length(length), width(width), height(height)
     { }
 
+    /**
+     * Length, width and height.
+     */
+    Vec3 get_size() const;
+
     bool intersect(const Ray &ray, HitPoint *hit_point);
+
+    bool get_bounds(Vec3 *min, Vec3 *max) const;
+
+    /**
+     * Intersection with a box that isn't a drawable, leaving the hit point's object unset.
+     */
+    static bool intersect(const Vec3 &position, const Vec3 &size, const Ray &ray, HitPoint *hit_point);
 };
 
 #endif //HELIOS_BOX_H
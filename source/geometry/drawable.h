@@ -19,17 +19,33 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef HELIOS_DRAWABLE_H
 #define HELIOS_DRAWABLE_H
 
-#include <material.h>
+#include <material_library.h>
 #include "object.h"
 
 class Drawable : public Object {
 public:
-    Material material;
+    MaterialHandle material = MaterialLibrary::default_material;
 
     Drawable(const Vec3 &position) : Object(position)
     { }
 
     virtual bool intersect(const Ray &ray, HitPoint *hit_point) = 0;
+
+    /**
+     * Meshes also replace the materials of their triangles.
+     */
+    virtual void set_material(MaterialHandle material)
+    {
+        this->material = material;
+    }
+
+    /**
+     * Unbounded drawables such as planes return false and are kept out of the BVH.
+     */
+    virtual bool get_bounds(Vec3 *min, Vec3 *max) const
+    {
+        return false;
+    }
 };
 
 #endif //HELIOS_DRAWABLE_H
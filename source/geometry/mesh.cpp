@@ -0,0 +1,186 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include "mesh.h"
+
+/* Private Functions -------------------------------------------------------- */
+
+bool Mesh::intersect_triangle(uint32_t index, const Ray &ray, float max_distance, HitPoint *hit_point) const
+{
+    /**
+     * Möller-Trumbore.
+     */
+    const MeshTriangle &triangle = triangles[index];
+
+    const Vec3 &p0 = positions[triangle.positions[0]];
+    Vec3 edge1 = positions[triangle.positions[1]] - p0;
+    Vec3 edge2 = positions[triangle.positions[2]] - p0;
+
+    Vec3 p = cross(ray.direction, edge2);
+    float determinant = dot(edge1, p);
+
+    if (determinant == 0.0f)
+        return false;
+
+    float inverse_determinant = 1.0f / determinant;
+
+    Vec3 s = ray.origin - p0;
+    float u = dot(s, p) * inverse_determinant;
+
+    if (u < 0.0f || u > 1.0f)
+        return false;
+
+    Vec3 q = cross(s, edge1);
+    float v = dot(ray.direction, q) * inverse_determinant;
+
+    if (v < 0.0f || u + v > 1.0f)
+        return false;
+
+    float t = dot(edge2, q) * inverse_determinant;
+
+    if (t < 1e-4 || t >= max_distance)
+        return false;
+
+    hit_point->position = ray.origin + ray.direction * t;
+    hit_point->distance = t;
+
+    Vec3 face_normal = cross(edge1, edge2).normalized();
+
+    if (triangle.normals[0] != MeshTriangle::no_normal) {
+        hit_point->normal = (normals[triangle.normals[0]] * (1.0f - u - v) + normals[triangle.normals[1]] * u +
+                             normals[triangle.normals[2]] * v).normalized();
+    } else {
+        hit_point->normal = face_normal;
+    }
+
+    /**
+     * Triangles are two sided, the normal is flipped to face the ray.
+     */
+    if (dot(face_normal, ray.direction) > 0.0f) {
+        hit_point->normal = -hit_point->normal;
+    }
+
+    hit_point->material = triangle.material;
+
+    return true;
+}
+
+std::vector<Aabb> Mesh::get_triangle_bounds() const
+{
+    std::vector<Aabb> triangle_bounds(triangles.size());
+
+    for (size_t i = 0; i < triangles.size(); i++) {
+        for (uint32_t position : triangles[i].positions) {
+            triangle_bounds[i].extend(positions[position]);
+        }
+    }
+
+    return triangle_bounds;
+}
+
+/* -------------------------------------------------------------------------- */
+
+void Mesh::set_geometry(std::vector<Vec3> &positions, std::vector<Vec3> &normals,
+                        std::vector<MeshTriangle> &triangles)
+{
+    this->positions.swap(positions);
+    this->normals.swap(normals);
+    this->triangles.swap(triangles);
+
+    std::vector<uint32_t> indices(this->triangles.size());
+    std::vector<Aabb> triangle_bounds = get_triangle_bounds();
+
+    bounds = Aabb();
+
+    for (uint32_t i = 0; i < this->triangles.size(); i++) {
+        bounds.extend(triangle_bounds[i]);
+        indices[i] = i;
+    }
+
+    bvh.build(indices, triangle_bounds);
+}
+
+const std::vector<Vec3> &Mesh::get_positions() const
+{
+    return positions;
+}
+
+const std::vector<Vec3> &Mesh::get_normals() const
+{
+    return normals;
+}
+
+const std::vector<MeshTriangle> &Mesh::get_triangles() const
+{
+    return triangles;
+}
+
+void Mesh::set_material(MaterialHandle material)
+{
+    this->material = material;
+
+    for (MeshTriangle &triangle : triangles) {
+        triangle.material = material;
+    }
+}
+
+void Mesh::set_position(const Vec3 &position)
+{
+    Vec3 offset = position - this->position;
+
+    this->position = position;
+
+    for (Vec3 &vertex : positions) {
+        vertex += offset;
+    }
+
+    /**
+     * Moving every vertex by the same offset keeps the tree as good as it was.
+     */
+    bounds = Aabb(bounds.min + offset, bounds.max + offset);
+    bvh.refit(get_triangle_bounds());
+}
+
+bool Mesh::intersect(const Ray &ray, HitPoint *hit_point)
+{
+    bool hit = bvh.traverse(ray, INFINITY, false, [&](uint32_t index, float *max_distance) {
+        if (!intersect_triangle(index, ray, *max_distance, hit_point))
+            return false;
+
+        *max_distance = (float) hit_point->distance;
+
+        return true;
+    });
+
+    if (hit)
+        hit_point->object = this;
+
+    return hit;
+}
+
+bool Mesh::get_bounds(Vec3 *min, Vec3 *max) const
+{
+    if (triangles.empty())
+        return false;
+
+    *min = bounds.min;
+    *max = bounds.max;
+
+    return true;
+}
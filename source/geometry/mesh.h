@@ -0,0 +1,94 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_MESH_H
+#define HELIOS_MESH_H
+
+#include <vector>
+#include <cstdint>
+#include <bvh.h>
+#include "drawable.h"
+
+struct MeshTriangle {
+    static const uint32_t no_normal = 0xffffffff;
+
+    uint32_t positions[3];
+
+    /**
+     * Vertex normal indices, no_normal for triangles that use their face normal.
+     */
+    uint32_t normals[3];
+
+    MaterialHandle material;
+};
+
+/**
+ * A triangle mesh in world space with its own BVH over the triangles. Every triangle has its own
+ * material, which hits report in place of the drawable's material.
+ */
+class Mesh : public Drawable {
+private:
+    std::vector<Vec3> positions;
+
+    std::vector<Vec3> normals;
+
+    std::vector<MeshTriangle> triangles;
+
+    Bvh bvh;
+
+    Aabb bounds;
+
+    bool intersect_triangle(uint32_t index, const Ray &ray, float max_distance, HitPoint *hit_point) const;
+
+    /**
+     * Bounds of every triangle, by triangle index.
+     */
+    std::vector<Aabb> get_triangle_bounds() const;
+
+public:
+    Mesh() : Drawable(Vec3())
+    { }
+
+    /**
+     * Takes over the buffers and builds the BVH.
+     */
+    void set_geometry(std::vector<Vec3> &positions, std::vector<Vec3> &normals, std::vector<MeshTriangle> &triangles);
+
+    const std::vector<Vec3> &get_positions() const;
+
+    const std::vector<Vec3> &get_normals() const;
+
+    const std::vector<MeshTriangle> &get_triangles() const;
+
+    /**
+     * Gives every triangle the same material.
+     */
+    void set_material(MaterialHandle material);
+
+    /**
+     * Moves the vertices along with the position, which starts out at the origin of the file's
+     * coordinates, and refits the BVH.
+     */
+    void set_position(const Vec3 &position);
+
+    bool intersect(const Ray &ray, HitPoint *hit_point);
+
+    bool get_bounds(Vec3 *min, Vec3 *max) const;
+};
+
+#endif //HELIOS_MESH_H
@@ -30,6 +30,16 @@ const Vec3 &Plane::get_normal() const
 }
 
 bool Plane::intersect(const Ray &ray, HitPoint *hit_point)
+{
+    if (!intersect(position, normal, ray, hit_point))
+        return false;
+
+    hit_point->object = this;
+
+    return true;
+}
+
+bool Plane::intersect(const Vec3 &position, const Vec3 &normal, const Ray &ray, HitPoint *hit_point)
 {
     //ray -> x = orig - dir * t
     //plane -> x = (dot(ray.orig, normal) + d) / dot(ray.dir, normal)
@@ -66,7 +76,6 @@ bool Plane::intersect(const Ray &ray, HitPoint *hit_point)
     hit_point->position = ray.origin + ray.direction * t;
     hit_point->normal = normal;
     hit_point->distance = t;
-    hit_point->object = this;
 
     return true;
 }
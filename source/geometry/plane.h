@@ -37,6 +37,11 @@ public:
     const Vec3 &get_normal() const;
 
     bool intersect(const Ray &ray, HitPoint *hit_point);
+
+    /**
+     * Intersection with a plane that isn't a drawable, leaving the hit point's object unset.
+     */
+    static bool intersect(const Vec3 &position, const Vec3 &normal, const Ray &ray, HitPoint *hit_point);
 };
 
 #endif //HELIOS_PLANE_H
@@ -19,7 +19,30 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "sphere.h"
 #include <math.h>
 
+float Sphere::get_radius() const
+{
+    return radius;
+}
+
 bool Sphere::intersect(const Ray &ray, HitPoint *hit_point)
+{
+    if (!intersect(position, radius, ray, hit_point))
+        return false;
+
+    hit_point->object = this;
+
+    return true;
+}
+
+bool Sphere::get_bounds(Vec3 *min, Vec3 *max) const
+{
+    *min = position - Vec3(radius, radius, radius);
+    *max = position + Vec3(radius, radius, radius);
+
+    return true;
+}
+
+bool Sphere::intersect(const Vec3 &position, float radius, const Ray &ray, HitPoint *hit_point)
 {
     /**
      * sphere vector equation is |x - position| = radius
@@ -80,7 +103,6 @@ bool Sphere::intersect(const Ray &ray, HitPoint *hit_point)
      * We have a hit!
      * Fill the hit point structure
      */
-    hit_point->object = this;
     hit_point->position = ray.origin + ray.direction * t;
     hit_point->distance = t;
 
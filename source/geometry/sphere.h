@@ -31,7 +31,16 @@ public:
     Sphere(const Vec3 &position, double radius) : Drawable(position), radius(radius)
     { };
 
+    float get_radius() const;
+
     bool intersect(const Ray &ray, HitPoint *hit_point);
+
+    bool get_bounds(Vec3 *min, Vec3 *max) const;
+
+    /**
+     * Intersection with a sphere that isn't a drawable, leaving the hit point's object unset.
+     */
+    static bool intersect(const Vec3 &position, float radius, const Ray &ray, HitPoint *hit_point);
 };
 
 #endif //HELIOS_SPHERE_H
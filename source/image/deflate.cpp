@@ -0,0 +1,332 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include "deflate.h"
+
+/* Static functions */
+
+static const int window_size = 32768;
+static const int hash_bits = 15;
+static const int min_match = 3;
+static const int max_match = 258;
+
+/**
+ * Limits how many earlier positions are compared per byte. Higher is slower but compresses better.
+ */
+static const int max_chain_length = 32;
+
+static const unsigned short length_base[29] = {
+        3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195,
+        227, 258
+};
+
+static const unsigned char length_extra[29] = {
+        0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+
+static const unsigned short distance_base[30] = {
+        1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+        4097, 6145, 8193, 12289, 16385, 24577
+};
+
+static const unsigned char distance_extra[30] = {
+        0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+/**
+ * Writes bits least significant first, as deflate requires.
+ */
+class BitWriter {
+private:
+    std::vector<unsigned char> &out;
+
+    uint64_t buffer = 0;
+
+    int count = 0;
+
+public:
+    BitWriter(std::vector<unsigned char> &out) : out(out)
+    { }
+
+    void write_bits(uint32_t bits, int length)
+    {
+        buffer |= (uint64_t) bits << count;
+        count += length;
+
+        while (count >= 8) {
+            out.push_back((unsigned char) buffer);
+            buffer >>= 8;
+            count -= 8;
+        }
+    }
+
+    /**
+     * Huffman codes are defined most significant bit first.
+     */
+    void write_code(uint32_t code, int length)
+    {
+        uint32_t reversed = 0;
+
+        for (int i = 0; i < length; i++) {
+            reversed = (reversed << 1) | ((code >> i) & 1u);
+        }
+
+        write_bits(reversed, length);
+    }
+
+    void align()
+    {
+        if (count > 0) {
+            write_bits(0, 8 - count);
+        }
+    }
+};
+
+static void write_literal(BitWriter &writer, unsigned int value)
+{
+    if (value < 144) {
+        writer.write_code(0x30 + value, 8);
+    }
+    else if (value < 256) {
+        writer.write_code(0x190 + value - 144, 9);
+    }
+    else if (value < 280) {
+        writer.write_code(value - 256, 7);
+    }
+    else {
+        writer.write_code(0xc0 + value - 280, 8);
+    }
+}
+
+static void write_match(BitWriter &writer, int length, int distance)
+{
+    int code = 28;
+
+    while (length_base[code] > length) {
+        code--;
+    }
+
+    write_literal(writer, 257 + (unsigned int) code);
+    writer.write_bits((uint32_t) (length - length_base[code]), length_extra[code]);
+
+    code = 29;
+
+    while (distance_base[code] > distance) {
+        code--;
+    }
+
+    writer.write_code((uint32_t) code, 5);
+    writer.write_bits((uint32_t) (distance - distance_base[code]), distance_extra[code]);
+}
+
+struct CrcTable {
+    uint32_t entries[256];
+
+    CrcTable()
+    {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+
+            for (int k = 0; k < 8; k++) {
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+
+            entries[n] = c;
+        }
+    }
+};
+
+static inline uint32_t hash3(const unsigned char *p)
+{
+    return ((p[0] << 16 | p[1] << 8 | p[2]) * 2654435761u) >> (32 - hash_bits);
+}
+
+/* ------------------------------------------------------------------*/
+
+void deflate_compress(const unsigned char *data, size_t size, bool final, std::vector<unsigned char> &out)
+{
+    BitWriter writer(out);
+
+    /**
+     * A single block using the fixed Huffman codes.
+     */
+    writer.write_bits(final ? 1u : 0u, 1);
+    writer.write_bits(1, 2);
+
+    std::vector<int> head(1 << hash_bits, -1);
+    std::vector<int> prev(window_size, -1);
+
+    size_t pos = 0;
+
+    while (pos < size) {
+        int best_length = 0;
+        int best_distance = 0;
+
+        if (pos + min_match <= size) {
+            uint32_t hash = hash3(data + pos);
+            int candidate = head[hash];
+            int max_length = (int) std::min<size_t>(max_match, size - pos);
+
+            for (int chain = 0; candidate >= 0 && chain < max_chain_length; chain++) {
+                int distance = (int) pos - candidate;
+
+                if (distance > window_size - 1)
+                    break;
+
+                if (data[candidate + best_length] == data[pos + best_length]) {
+                    int length = 0;
+
+                    while (length < max_length && data[candidate + length] == data[pos + length]) {
+                        length++;
+                    }
+
+                    if (length > best_length) {
+                        best_length = length;
+                        best_distance = distance;
+
+                        if (length == max_length)
+                            break;
+                    }
+                }
+
+                candidate = prev[candidate & (window_size - 1)];
+            }
+        }
+
+        size_t advance = 1;
+
+        if (best_length >= min_match) {
+            write_match(writer, best_length, best_distance);
+            advance = (size_t) best_length;
+        }
+        else {
+            write_literal(writer, data[pos]);
+        }
+
+        /**
+         * Insert every consumed position into the hash chains.
+         */
+        for (size_t i = 0; i < advance; i++, pos++) {
+            if (pos + min_match <= size) {
+                uint32_t hash = hash3(data + pos);
+                prev[pos & (window_size - 1)] = head[hash];
+                head[hash] = (int) pos;
+            }
+        }
+    }
+
+    /**
+     * End of block.
+     */
+    write_literal(writer, 256);
+
+    if (!final) {
+        /**
+         * Empty stored block to reach a byte boundary.
+         */
+        writer.write_bits(0, 3);
+        writer.align();
+
+        out.push_back(0x00);
+        out.push_back(0x00);
+        out.push_back(0xff);
+        out.push_back(0xff);
+    }
+    else {
+        writer.align();
+    }
+}
+
+void zlib_compress(const unsigned char *data, size_t size, std::vector<unsigned char> &out)
+{
+    /**
+     * Deflate with a 32K window, no preset dictionary.
+     */
+    out.push_back(0x78);
+    out.push_back(0x01);
+
+    deflate_compress(data, size, true, out);
+
+    uint32_t adler = adler32(data, size);
+
+    out.push_back((unsigned char) (adler >> 24));
+    out.push_back((unsigned char) (adler >> 16));
+    out.push_back((unsigned char) (adler >> 8));
+    out.push_back((unsigned char) adler);
+}
+
+uint32_t adler32(const unsigned char *data, size_t size, uint32_t adler)
+{
+    static const uint32_t base = 65521;
+
+    /**
+     * Largest block for which the sums can't overflow before the modulo.
+     */
+    static const size_t block_size = 5552;
+
+    uint32_t a = adler & 0xffff;
+    uint32_t b = adler >> 16;
+
+    while (size > 0) {
+        size_t block = size < block_size ? size : block_size;
+        size -= block;
+
+        for (size_t i = 0; i < block; i++) {
+            a += *data++;
+            b += a;
+        }
+
+        a %= base;
+        b %= base;
+    }
+
+    return (b << 16) | a;
+}
+
+uint32_t adler32_combine(uint32_t adler1, uint32_t adler2, size_t size2)
+{
+    static const uint32_t base = 65521;
+
+    uint32_t remainder = (uint32_t) (size2 % base);
+    uint32_t sum1 = adler1 & 0xffff;
+    uint32_t sum2 = (uint32_t) (((uint64_t) remainder * sum1) % base);
+
+    sum1 += (adler2 & 0xffff) + base - 1;
+    sum2 += (adler1 >> 16) + (adler2 >> 16) + base - remainder;
+
+    if (sum1 >= base) sum1 -= base;
+    if (sum1 >= base) sum1 -= base;
+    if (sum2 >= (base << 1)) sum2 -= (base << 1);
+    if (sum2 >= base) sum2 -= base;
+
+    return (sum2 << 16) | sum1;
+}
+
+uint32_t crc32(const unsigned char *data, size_t size, uint32_t crc)
+{
+    static const CrcTable table;
+
+    crc = ~crc;
+
+    for (size_t i = 0; i < size; i++) {
+        crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+
+    return ~crc;
+}
@@ -0,0 +1,50 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_DEFLATE_H
+#define HELIOS_DEFLATE_H
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Compresses data into raw deflate (RFC 1951) blocks using LZ77 with hash chains and the
+ * fixed Huffman codes.
+ *
+ * If final is false the output ends with an empty stored block, which leaves it byte aligned
+ * so independently compressed chunks can be concatenated into one stream. Only the last chunk
+ * should be compressed with final set.
+ */
+void deflate_compress(const unsigned char *data, size_t size, bool final, std::vector<unsigned char> &out);
+
+/**
+ * Compresses data into a complete zlib (RFC 1950) stream.
+ */
+void zlib_compress(const unsigned char *data, size_t size, std::vector<unsigned char> &out);
+
+uint32_t adler32(const unsigned char *data, size_t size, uint32_t adler = 1);
+
+/**
+ * The adler32 of the concatenation of two blocks, given the checksum of each and the size of the second.
+ */
+uint32_t adler32_combine(uint32_t adler1, uint32_t adler2, size_t size2);
+
+uint32_t crc32(const unsigned char *data, size_t size, uint32_t crc = 0);
+
+#endif //HELIOS_DEFLATE_H
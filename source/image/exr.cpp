@@ -0,0 +1,320 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+#include <iostream>
+#include <vector>
+#include <cstring>
+#include <algorithm>
+#include <parallel_for.h>
+#include "exr.h"
+#include "image.h"
+#include "deflate.h"
+
+/* Static functions */
+
+static void put_bytes(std::vector<unsigned char> &out, const void *data, size_t size)
+{
+    const unsigned char *bytes = (const unsigned char *) data;
+    out.insert(out.end(), bytes, bytes + size);
+}
+
+static void put_string(std::vector<unsigned char> &out, const char *string)
+{
+    put_bytes(out, string, strlen(string) + 1);
+}
+
+/**
+ * OpenEXR files are little endian.
+ */
+static void put_uint32(std::vector<unsigned char> &out, uint32_t value)
+{
+    unsigned char bytes[4] = {(unsigned char) value, (unsigned char) (value >> 8),
+                              (unsigned char) (value >> 16), (unsigned char) (value >> 24)};
+    put_bytes(out, bytes, 4);
+}
+
+static void put_uint64(std::vector<unsigned char> &out, uint64_t value)
+{
+    put_uint32(out, (uint32_t) value);
+    put_uint32(out, (uint32_t) (value >> 32));
+}
+
+static void put_float(std::vector<unsigned char> &out, float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    put_uint32(out, bits);
+}
+
+static void put_attribute(std::vector<unsigned char> &out, const char *name, const char *type, uint32_t size)
+{
+    put_string(out, name);
+    put_string(out, type);
+    put_uint32(out, size);
+}
+
+static void put_box(std::vector<unsigned char> &out, const char *name, unsigned int width, unsigned int height)
+{
+    put_attribute(out, name, "box2i", 16);
+    put_uint32(out, 0);
+    put_uint32(out, 0);
+    put_uint32(out, width - 1);
+    put_uint32(out, height - 1);
+}
+
+static unsigned int lines_per_chunk(ExrCompression compression)
+{
+    return compression == EXR_COMPRESSION_ZIP ? 16 : 1;
+}
+
+/**
+ * Splits the bytes into an even and an odd half and replaces every byte by its difference to
+ * the previous one. Neighbouring half and float values mostly differ in their low bytes, so
+ * this leaves long runs of similar values for the compressor.
+ */
+static void interleave_and_predict(const unsigned char *in, size_t size, unsigned char *out)
+{
+    unsigned char *even = out;
+    unsigned char *odd = out + (size + 1) / 2;
+
+    for (size_t i = 0; i < size; i++) {
+        if (i & 1)
+            *odd++ = in[i];
+        else
+            *even++ = in[i];
+    }
+
+    int previous = out[0];
+
+    for (size_t i = 1; i < size; i++) {
+        int value = out[i];
+        out[i] = (unsigned char) (value - previous + 128 + 256);
+        previous = value;
+    }
+}
+
+/**
+ * OpenEXR run length encoding: a count n >= 0 followed by one byte repeated n + 1 times,
+ * or a count -n followed by n literal bytes.
+ */
+static void run_length_encode(const unsigned char *in, size_t size, std::vector<unsigned char> &out)
+{
+    static const long min_run_length = 3;
+    static const long max_run_length = 127;
+
+    const unsigned char *end = in + size;
+    const unsigned char *run_start = in;
+    const unsigned char *run_end = in + 1;
+
+    while (run_start < end) {
+        while (run_end < end && *run_start == *run_end && run_end - run_start - 1 < max_run_length)
+            ++run_end;
+
+        if (run_end - run_start >= min_run_length) {
+            out.push_back((unsigned char) (run_end - run_start - 1));
+            out.push_back(*run_start);
+            run_start = run_end;
+        }
+        else {
+            while (run_end < end &&
+                   ((run_end + 1 >= end || *run_end != *(run_end + 1)) ||
+                    (run_end + 2 >= end || *(run_end + 1) != *(run_end + 2))) &&
+                   run_end - run_start < max_run_length)
+                ++run_end;
+
+            out.push_back((unsigned char) (run_start - run_end));
+            out.insert(out.end(), run_start, run_end);
+            run_start = run_end;
+        }
+
+        ++run_end;
+    }
+}
+
+/**
+ * Converts rows of RGB floats to the EXR scan line layout: per line, all B values, then all G
+ * values, then all R values, as channels are stored in alphabetical order.
+ */
+static void pack_lines(const float *rgb, unsigned int width, unsigned int line_count, ExrPixelType pixel_type,
+                       unsigned char *out)
+{
+    for (unsigned int y = 0; y < line_count; y++) {
+        const float *row = rgb + (size_t) y * width * 3;
+
+        for (int channel = 2; channel >= 0; channel--) {
+            for (unsigned int x = 0; x < width; x++) {
+                float value = row[x * 3 + channel];
+
+                if (pixel_type == EXR_PIXEL_HALF) {
+                    uint16_t half = float_to_half(value);
+                    *out++ = (unsigned char) half;
+                    *out++ = (unsigned char) (half >> 8);
+                }
+                else {
+                    uint32_t bits;
+                    memcpy(&bits, &value, 4);
+                    *out++ = (unsigned char) bits;
+                    *out++ = (unsigned char) (bits >> 8);
+                    *out++ = (unsigned char) (bits >> 16);
+                    *out++ = (unsigned char) (bits >> 24);
+                }
+            }
+        }
+    }
+}
+
+/* ------------------------------------------------------------------*/
+
+bool write_exr(const std::string &file_name, const Image &image, ExrPixelType pixel_type,
+               ExrCompression compression)
+{
+    unsigned int width = image.get_width();
+    unsigned int height = image.get_height();
+
+    std::ofstream file(file_name, std::ios::binary | std::ios::out);
+
+    if (!file.is_open()) {
+        std::cerr << "Could not open file " << file_name << " for writing!" << std::endl;
+        return false;
+    }
+
+    /**
+     * Magic number and version 2 with no flags: single part, scan lines, short names.
+     */
+    std::vector<unsigned char> header;
+    put_uint32(header, 20000630);
+    put_uint32(header, 2);
+
+    put_attribute(header, "channels", "chlist", 3 * 18 + 1);
+
+    for (const char *channel : {"B", "G", "R"}) {
+        put_string(header, channel);
+        put_uint32(header, pixel_type == EXR_PIXEL_HALF ? 1 : 2);
+
+        /**
+         * pLinear and reserved bytes, then the x and y sampling rates.
+         */
+        put_uint32(header, 0);
+        put_uint32(header, 1);
+        put_uint32(header, 1);
+    }
+    header.push_back(0);
+
+    static const unsigned char compression_ids[] = {0, 1, 3};
+
+    put_attribute(header, "compression", "compression", 1);
+    header.push_back(compression_ids[compression]);
+
+    put_box(header, "dataWindow", width, height);
+    put_box(header, "displayWindow", width, height);
+
+    put_attribute(header, "lineOrder", "lineOrder", 1);
+    header.push_back(0);
+
+    put_attribute(header, "pixelAspectRatio", "float", 4);
+    put_float(header, 1.0f);
+
+    put_attribute(header, "screenWindowCenter", "v2f", 8);
+    put_float(header, 0.0f);
+    put_float(header, 0.0f);
+
+    put_attribute(header, "screenWindowWidth", "float", 4);
+    put_float(header, 1.0f);
+
+    header.push_back(0);
+
+    unsigned int chunk_lines = lines_per_chunk(compression);
+    unsigned int chunk_count = (height + chunk_lines - 1) / chunk_lines;
+    size_t line_size = (size_t) width * 3 * (pixel_type == EXR_PIXEL_HALF ? 2 : 4);
+
+    /**
+     * Every chunk is converted and compressed independently.
+     */
+    std::vector< std::vector<unsigned char> > chunks(chunk_count);
+
+    parallel_for(chunk_count, [&](unsigned int begin, unsigned int end) {
+        std::vector<float> rgb;
+        std::vector<unsigned char> raw, predicted;
+
+        for (unsigned int i = begin; i < end; i++) {
+            unsigned int first_line = i * chunk_lines;
+            unsigned int line_count = std::min(chunk_lines, height - first_line);
+            size_t size = line_size * line_count;
+
+            rgb.resize((size_t) width * 3 * line_count);
+            raw.resize(size);
+
+            image.read_rows(first_line, line_count, rgb.data());
+            pack_lines(rgb.data(), width, line_count, pixel_type, raw.data());
+
+            std::vector<unsigned char> &chunk = chunks[i];
+            put_uint32(chunk, first_line);
+            put_uint32(chunk, 0);
+
+            if (compression != EXR_COMPRESSION_NONE) {
+                predicted.resize(size);
+                interleave_and_predict(raw.data(), size, predicted.data());
+
+                if (compression == EXR_COMPRESSION_RLE)
+                    run_length_encode(predicted.data(), size, chunk);
+                else
+                    zlib_compress(predicted.data(), size, chunk);
+            }
+
+            /**
+             * Readers treat chunks of the uncompressed size as stored, so fall back to that
+             * whenever compression does not pay off.
+             */
+            if (compression == EXR_COMPRESSION_NONE || chunk.size() - 8 >= size) {
+                chunk.resize(8);
+                chunk.insert(chunk.end(), raw.begin(), raw.end());
+            }
+
+            uint32_t data_size = (uint32_t) (chunk.size() - 8);
+            chunk[4] = (unsigned char) data_size;
+            chunk[5] = (unsigned char) (data_size >> 8);
+            chunk[6] = (unsigned char) (data_size >> 16);
+            chunk[7] = (unsigned char) (data_size >> 24);
+        }
+    });
+
+    std::vector<unsigned char> offsets;
+    uint64_t offset = header.size() + (uint64_t) chunk_count * 8;
+
+    for (auto &chunk : chunks) {
+        put_uint64(offsets, offset);
+        offset += chunk.size();
+    }
+
+    file.write((const char *) header.data(), header.size());
+    file.write((const char *) offsets.data(), offsets.size());
+
+    for (auto &chunk : chunks) {
+        file.write((const char *) chunk.data(), chunk.size());
+    }
+
+    file.close();
+
+    if (!file) {
+        std::cerr << "Failed writing to file " << file_name << "!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,55 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_EXR_H
+#define HELIOS_EXR_H
+
+#include <string>
+
+class Image;
+
+enum ExrPixelType {
+    EXR_PIXEL_HALF,
+    EXR_PIXEL_FLOAT
+};
+
+/**
+ * Scan line compression methods, a subset of the OpenEXR ones.
+ */
+enum ExrCompression {
+    EXR_COMPRESSION_NONE,
+
+    /**
+     * Run length encoding of the byte-interleaved, delta-predicted scan line.
+     */
+    EXR_COMPRESSION_RLE,
+
+    /**
+     * Deflate over blocks of 16 byte-interleaved, delta-predicted scan lines.
+     */
+    EXR_COMPRESSION_ZIP
+};
+
+/**
+ * Writes the image's linear RGB values to a single part, scan line OpenEXR file.
+ * The chunks are compressed in parallel and written in increasing y order.
+ */
+bool write_exr(const std::string &file_name, const Image &image, ExrPixelType pixel_type,
+               ExrCompression compression);
+
+#endif //HELIOS_EXR_H
@@ -19,6 +19,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include "image.h"
 #include <fstream>
 #include <iostream>
+#include <chrono>
+#include <stdlib.h>
+#include <parallel_for.h>
+#include "deflate.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std::chrono;
 
 
 /* Static functions */
@@ -39,10 +49,175 @@ static std::string extract_file_extension(const std::string &file_name)
     return file_name.substr((unsigned long) dot_idx);
 }
 
+void Image::quantize_span(const float *in, unsigned char *out, size_t count)
+{
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+
+    /**
+     * 16 values per iteration: clamp, scale, truncate and pack down to bytes.
+     */
+    for (; i + 16 <= count; i += 16) {
+        __m128i a = _mm_cvttps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i), zero), one), scale));
+        __m128i b = _mm_cvttps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 4), zero), one), scale));
+        __m128i c = _mm_cvttps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 8), zero), one), scale));
+        __m128i d = _mm_cvttps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(in + i + 12), zero), one), scale));
+
+        __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+
+        _mm_storeu_si128((__m128i *) (out + i), bytes);
+    }
+#endif
+
+    for (; i < count; i++) {
+        float value = in[i];
+
+        /**
+         * Also maps NaN to 0.
+         */
+        if (!(value > 0.0f))
+            value = 0.0f;
+
+        if (value > 1.0f)
+            value = 1.0f;
+
+        out[i] = (unsigned char) (value * 255.0f);
+    }
+}
+
+static inline unsigned char paeth_predictor(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a);
+    int pb = abs(p - b);
+    int pc = abs(p - c);
+
+    if (pa <= pb && pa <= pc)
+        return (unsigned char) a;
+
+    return (unsigned char) (pb <= pc ? b : c);
+}
+
+/**
+ * Filters one PNG scan line with every filter type and keeps the one with the smallest sum of
+ * absolute differences. The output starts with the filter type byte.
+ */
+static void filter_png_row(const unsigned char *row, const unsigned char *previous, size_t row_size,
+                           unsigned char *out, std::vector<unsigned char> &scratch)
+{
+    static const int bpp = 3;
+
+    scratch.resize(row_size);
+
+    unsigned long best_sum = ~0ul;
+
+    for (int filter = 0; filter < 5; filter++) {
+        unsigned long sum = 0;
+
+        for (size_t i = 0; i < row_size; i++) {
+            int a = i >= bpp ? row[i - bpp] : 0;
+            int b = previous ? previous[i] : 0;
+            int c = (i >= bpp && previous) ? previous[i - bpp] : 0;
+
+            unsigned char value = row[i];
+
+            switch (filter) {
+                case 1:
+                    value -= a;
+                    break;
+                case 2:
+                    value -= b;
+                    break;
+                case 3:
+                    value -= (a + b) / 2;
+                    break;
+                case 4:
+                    value -= paeth_predictor(a, b, c);
+                    break;
+                default:
+                    break;
+            }
+
+            scratch[i] = value;
+            sum += value < 128 ? value : 256 - value;
+        }
+
+        if (sum < best_sum) {
+            best_sum = sum;
+            out[0] = (unsigned char) filter;
+            std::copy(scratch.begin(), scratch.end(), out + 1);
+        }
+    }
+}
+
+static void write_png_chunk(std::ofstream &file, const char *type, const unsigned char *data, size_t size)
+{
+    unsigned char length[4] = {(unsigned char) (size >> 24), (unsigned char) (size >> 16),
+                               (unsigned char) (size >> 8), (unsigned char) size};
+
+    uint32_t crc = crc32(data, size, crc32((const unsigned char *) type, 4));
+
+    unsigned char crc_bytes[4] = {(unsigned char) (crc >> 24), (unsigned char) (crc >> 16),
+                                  (unsigned char) (crc >> 8), (unsigned char) crc};
+
+    file.write((const char *) length, 4);
+    file.write(type, 4);
+    file.write((const char *) data, size);
+    file.write((const char *) crc_bytes, 4);
+}
+
+static void report_encode_speed(const char *format, size_t bytes, high_resolution_clock::time_point start)
+{
+    double duration = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+    double megabytes = bytes / (1024.0 * 1024.0);
+
+    std::cout << "Encoded " << format << ": " << megabytes << "MB in " << duration << "ms ("
+              << megabytes / (duration / 1000.0) << " MB/s)" << std::endl;
+}
+
 /* ------------------------------------------------------------------*/
 
 /* Private Functions */
 
+void Image::quantize(unsigned char *buffer) const
+{
+    size_t row_size = (size_t) width * 3;
+
+    /**
+     * 8 bit storage already holds display values.
+     */
+    if (pixel_format == IMG_PIXEL_SRGB8) {
+        std::copy(pixels, pixels + row_size * height, buffer);
+        return;
+    }
+
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    parallel_for(height, [this, buffer, row_size](unsigned int begin, unsigned int end) {
+        std::vector<float> row(row_size);
+
+        for (unsigned int y = begin; y < end; y++) {
+            if (pixel_format == IMG_PIXEL_FLOAT) {
+                post_process.apply((const float *) pixels + y * row_size, row.data(), row_size);
+            }
+            else {
+                read_rows(y, 1, row.data());
+                post_process.apply(row.data(), row.data(), row_size);
+            }
+
+            quantize_span(row.data(), buffer + y * row_size, row_size);
+        }
+    });
+
+    double duration = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+
+    std::cout << "Post-processed " << (size_t) width * height << " pixels in " << duration << "ms" << std::endl;
+}
+
 bool Image::save_as_ppm(const std::string &file_name)
 {
     std::ofstream file(file_name, std::ios::binary | std::ios::out);
@@ -52,32 +227,194 @@ bool Image::save_as_ppm(const std::string &file_name)
         return false;
     }
 
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
     static const int max_color_value = 255;
 
     /**
-     * Write the .ppm file header.
+     * The .ppm file header.
      */
-    file << "P6\n"
-    << width << " " << height << "\n"
-    << max_color_value << std::endl;
+    std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n" +
+                         std::to_string(max_color_value) + "\n";
+
+    size_t data_size = (size_t) width * height * 3;
 
     /**
-     * Write the values to the file.
+     * Header and pixel values go into one buffer which is written at once.
      */
-    for (int i = 0; i < (int)(width * height * 3); i += 3) {
+    std::vector<unsigned char> buffer(header.size() + data_size);
+
+    std::copy(header.begin(), header.end(), buffer.begin());
+    quantize(&buffer[header.size()]);
+
+    file.write((const char *) buffer.data(), buffer.size());
+    file.close();
+
+    if (!file) {
+        std::cerr << "Failed writing to file " << file_name << "!" << std::endl;
+        return false;
+    }
+
+    report_encode_speed("PPM", data_size, start);
+
+    return true;
+}
+
+bool Image::save_as_png(const std::string &file_name)
+{
+    std::ofstream file(file_name, std::ios::binary | std::ios::out);
+
+    if (!file.is_open()) {
+        std::cerr << "Could not open file " << file_name << " for writing!" << std::endl;
+        return false;
+    }
+
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    size_t row_size = (size_t) width * 3;
+
+    std::vector<unsigned char> rgb(row_size * height);
+    quantize(rgb.data());
+
+    /**
+     * Filter the scan lines in parallel, every filtered line is prefixed with its filter type.
+     */
+    std::vector<unsigned char> filtered((row_size + 1) * height);
+    const unsigned char *rgb_data = rgb.data();
+    unsigned char *filtered_data = filtered.data();
+
+    parallel_for(height, [rgb_data, filtered_data, row_size](unsigned int begin, unsigned int end) {
+        std::vector<unsigned char> scratch;
+
+        for (unsigned int y = begin; y < end; y++) {
+            filter_png_row(rgb_data + y * row_size, y ? rgb_data + (y - 1) * row_size : nullptr, row_size,
+                           filtered_data + y * (row_size + 1), scratch);
+        }
+    });
+
+    /**
+     * Compress bands of scan lines in parallel. Each band is an independent, byte aligned run of
+     * deflate blocks so the bands concatenate into a single zlib stream, one IDAT chunk per band.
+     */
+    unsigned int band_count = std::min(parallel_for_thread_count(), height);
+
+    std::vector< std::vector<unsigned char> > bands(band_count);
+    std::vector<uint32_t> band_adlers(band_count);
+
+    unsigned int row_count = height;
+
+    parallel_for(band_count, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int i = begin; i < end; i++) {
+            size_t first_row = (size_t) row_count * i / band_count;
+            size_t last_row = (size_t) row_count * (i + 1) / band_count;
+
+            const unsigned char *data = filtered_data + first_row * (row_size + 1);
+            size_t size = (last_row - first_row) * (row_size + 1);
+
+            if (i == 0) {
+                bands[i].push_back(0x78);
+                bands[i].push_back(0x01);
+            }
+
+            deflate_compress(data, size, i == band_count - 1, bands[i]);
+            band_adlers[i] = adler32(data, size);
+        }
+    });
+
+    uint32_t adler = band_adlers[0];
+
+    for (unsigned int i = 1; i < band_count; i++) {
+        size_t rows = (size_t) height * (i + 1) / band_count - (size_t) height * i / band_count;
+        adler = adler32_combine(adler, band_adlers[i], rows * (row_size + 1));
+    }
+
+    std::vector<unsigned char> &last_band = bands[band_count - 1];
+    last_band.push_back((unsigned char) (adler >> 24));
+    last_band.push_back((unsigned char) (adler >> 16));
+    last_band.push_back((unsigned char) (adler >> 8));
+    last_band.push_back((unsigned char) adler);
+
+    static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+
+    /**
+     * 8 bit RGB, default compression and filtering, no interlacing.
+     */
+    unsigned char ihdr[13] = {(unsigned char) (width >> 24), (unsigned char) (width >> 16),
+                              (unsigned char) (width >> 8), (unsigned char) width,
+                              (unsigned char) (height >> 24), (unsigned char) (height >> 16),
+                              (unsigned char) (height >> 8), (unsigned char) height,
+                              8, 2, 0, 0, 0};
+
+    file.write((const char *) signature, 8);
+    write_png_chunk(file, "IHDR", ihdr, sizeof(ihdr));
+
+    for (auto &band : bands) {
+        write_png_chunk(file, "IDAT", band.data(), band.size());
+    }
+
+    write_png_chunk(file, "IEND", nullptr, 0);
+
+    file.close();
+
+    if (!file) {
+        std::cerr << "Failed writing to file " << file_name << "!" << std::endl;
+        return false;
+    }
+
+    report_encode_speed("PNG", row_size * height, start);
 
-        float r = pixels[i];
-        float g = pixels[i + 1];
-        float b = pixels[i + 2];
+    return true;
+}
 
-        unsigned char int_rgb[3] = {(unsigned char) (r * 255.0), (unsigned char) (g * 255.0),
-                                    (unsigned char) (b * 255.0)};
+bool Image::save_as_pfm(const std::string &file_name)
+{
+    std::ofstream file(file_name, std::ios::binary | std::ios::out);
 
-        file.write((const char *) &int_rgb[0], 3 * sizeof(unsigned char));
+    if (!file.is_open()) {
+        std::cerr << "Could not open file " << file_name << " for writing!" << std::endl;
+        return false;
     }
 
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    /**
+     * A negative scale marks the data as little endian.
+     */
+    std::string header = "PF\n" + std::to_string(width) + " " + std::to_string(height) + "\n-1.0\n";
+
+    size_t row_size = (size_t) width * 3;
+    std::vector<float> data(row_size * height);
+    float *data_pointer = data.data();
+
+    parallel_for(height, [this, data_pointer, row_size](unsigned int begin, unsigned int end) {
+        for (unsigned int y = begin; y < end; y++) {
+            read_rows(y, 1, data_pointer + (size_t) (height - 1 - y) * row_size);
+        }
+    });
+
+    file.write(header.data(), header.size());
+    file.write((const char *) data.data(), data.size() * sizeof(float));
     file.close();
 
+    if (!file) {
+        std::cerr << "Failed writing to file " << file_name << "!" << std::endl;
+        return false;
+    }
+
+    report_encode_speed("PFM", data.size() * sizeof(float), start);
+
+    return true;
+}
+
+bool Image::save_as_exr(const std::string &file_name)
+{
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    if (!write_exr(file_name, *this, exr_pixel_type, exr_compression))
+        return false;
+
+    report_encode_speed("EXR", (size_t) width * height * 3 * (exr_pixel_type == EXR_PIXEL_HALF ? 2 : 4), start);
+
     return true;
 }
 
@@ -89,6 +426,18 @@ bool Image::save_auto_detect(const std::string &file_name)
         return save_as_ppm(file_name);
     }
 
+    if (extension.compare(".png") == 0) {
+        return save_as_png(file_name);
+    }
+
+    if (extension.compare(".pfm") == 0) {
+        return save_as_pfm(file_name);
+    }
+
+    if (extension.compare(".exr") == 0) {
+        return save_as_exr(file_name);
+    }
+
     std::cerr << "ERROR: Unrecognized file format! Please provide a supported file format extension." << std::endl;
     return false;
 }
@@ -96,16 +445,19 @@ bool Image::save_auto_detect(const std::string &file_name)
 
 /* ---------------------------------------------------------------------- */
 
-bool Image::create(unsigned int width, unsigned int height)
+bool Image::create(unsigned int width, unsigned int height, PixelFormat pixel_format)
 {
     delete[] pixels;
+    pixels = nullptr;
+
+    size_t size = (size_t) width * height * pixel_format_size(pixel_format);
 
     try {
         std::cout << "Creating Image: (" << width << " x " << height << ")" << std::endl;
         std::cout << "Trying to allocate image memory!\n" << "Bytes needed: "
-        <<  width * height * 3 * sizeof(float) << std::endl;
+        <<  size << std::endl;
 
-        pixels = new float[width * height * 3];
+        pixels = new unsigned char[size];
     }
     catch (...) {
         std::cerr << "Image allocation failed. Not enough memory!" << std::endl;
@@ -116,6 +468,45 @@ bool Image::create(unsigned int width, unsigned int height)
 
     this->width = width;
     this->height = height;
+    this->pixel_format = pixel_format;
+
+    return true;
+}
+
+void Image::set_dimensions(unsigned int width, unsigned int height)
+{
+    this->width = width;
+    this->height = height;
+}
+
+void Image::destroy()
+{
+    delete[] pixels;
+    pixels = nullptr;
+
+    width = height = 0;
+}
+
+bool Image::blit(const Image &source, unsigned int x, unsigned int y)
+{
+    unsigned int source_width = source.get_width();
+    unsigned int source_height = source.get_height();
+
+    if (x + source_width > width || y + source_height > height) {
+        std::cerr << "ERROR: Image (" << source_width << " x " << source_height << ") at " << x << ", " << y
+                  << " does not fit into (" << width << " x " << height << ")!" << std::endl;
+        return false;
+    }
+
+    size_t pixel_size = pixel_format_size(pixel_format);
+    std::vector<float> row((size_t) source_width * 3);
+
+    for (unsigned int i = 0; i < source_height; i++) {
+        source.read_rows(i, 1, row.data());
+
+        unsigned char *destination = pixels + ((size_t) (y + i) * width + x) * pixel_size;
+        encode_pixels(pixel_format, row.data(), destination, source_width);
+    }
 
     return true;
 }
@@ -130,11 +521,20 @@ unsigned int Image::get_height() const
     return height;
 }
 
-void Image::tone_map_pixel(float *r, float *g, float *b)
+void Image::set_post_process(const PostProcess &post_process)
+{
+    this->post_process = post_process;
+}
+
+const PostProcess &Image::get_post_process() const
+{
+    return post_process;
+}
+
+void Image::set_exr_options(ExrPixelType pixel_type, ExrCompression compression)
 {
-    *r = *r / (*r + 1.0f);
-    *g = *g / (*g + 1.0f);
-    *b = *b / (*b + 1.0f);
+    exr_pixel_type = pixel_type;
+    exr_compression = compression;
 }
 
 bool Image::save(const std::string &file_name, ImageFormat image_format)
@@ -147,6 +547,12 @@ bool Image::save(const std::string &file_name, ImageFormat image_format)
     switch (image_format) {
         case IMG_FMT_PPM:
             return save_as_ppm(file_name);
+        case IMG_FMT_PNG:
+            return save_as_png(file_name);
+        case IMG_FMT_PFM:
+            return save_as_pfm(file_name);
+        case IMG_FMT_EXR:
+            return save_as_exr(file_name);
         case IMG_FMT_AUTO_DETECT:
             return save_auto_detect(file_name);
     }
@@ -155,8 +561,100 @@ bool Image::save(const std::string &file_name, ImageFormat image_format)
     return false;
 }
 
+bool Image::load(const std::string &file_name)
+{
+    if (extract_file_extension(file_name).compare(".pfm") != 0) {
+        std::cerr << "ERROR: Only .pfm images can be loaded!" << std::endl;
+        return false;
+    }
+
+    std::ifstream file(file_name, std::ios::binary | std::ios::in);
+
+    if (!file.is_open()) {
+        std::cerr << "Could not open file " << file_name << " for reading!" << std::endl;
+        return false;
+    }
+
+    std::string magic;
+    unsigned int file_width = 0, file_height = 0;
+    float scale = 0.0f;
+
+    file >> magic >> file_width >> file_height >> scale;
+    file.get();
+
+    if (!file || (magic != "PF" && magic != "Pf") || !file_width || !file_height || scale == 0.0f) {
+        std::cerr << "ERROR: " << file_name << " is not a valid PFM file!" << std::endl;
+        return false;
+    }
+
+    unsigned int channels = magic == "PF" ? 3 : 1;
+    size_t row_size = (size_t) file_width * channels;
+
+    std::vector<float> data(row_size * file_height);
+    file.read((char *) data.data(), data.size() * sizeof(float));
+
+    if (!file) {
+        std::cerr << "ERROR: " << file_name << " is truncated!" << std::endl;
+        return false;
+    }
+
+    /**
+     * A positive scale marks big endian data.
+     */
+    if (scale > 0.0f) {
+        for (float &value : data) {
+            unsigned char *bytes = (unsigned char *) &value;
+            std::swap(bytes[0], bytes[3]);
+            std::swap(bytes[1], bytes[2]);
+        }
+    }
+
+    if (!create(file_width, file_height))
+        return false;
+
+    float *out = (float *) pixels;
+
+    for (unsigned int y = 0; y < file_height; y++) {
+        const float *row = data.data() + (size_t) (file_height - 1 - y) * row_size;
+
+        for (unsigned int x = 0; x < file_width; x++) {
+            for (int c = 0; c < 3; c++) {
+                *out++ = row[x * channels + (channels == 3 ? c : 0)];
+            }
+        }
+    }
+
+    return true;
+}
 
 float *Image::get_pixels() const
 {
-    return pixels;
+    return pixel_format == IMG_PIXEL_FLOAT ? (float *) pixels : nullptr;
+}
+
+PixelFormat Image::get_pixel_format() const
+{
+    return pixel_format;
+}
+
+void Image::write_rows(unsigned int first_row, unsigned int row_count, const float *pixels)
+{
+    size_t row_bytes = (size_t) width * pixel_format_size(pixel_format);
+
+    if (pixel_format == IMG_PIXEL_SRGB8) {
+        std::vector<float> display((size_t) row_count * width * 3);
+        post_process.apply(pixels, display.data(), display.size());
+
+        encode_pixels(pixel_format, display.data(), this->pixels + first_row * row_bytes, (size_t) row_count * width);
+        return;
+    }
+
+    encode_pixels(pixel_format, pixels, this->pixels + first_row * row_bytes, (size_t) row_count * width);
+}
+
+void Image::read_rows(unsigned int first_row, unsigned int row_count, float *pixels) const
+{
+    size_t row_bytes = (size_t) width * pixel_format_size(pixel_format);
+
+    decode_pixels(pixel_format, this->pixels + first_row * row_bytes, pixels, (size_t) row_count * width);
 }
@@ -21,16 +21,47 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <string>
 #include <vector>
+#include "pixel_format.h"
+#include "exr.h"
+#include "post_process.h"
 
 class Image {
 private:
     unsigned int width = 0;
     unsigned int height = 0;
 
-    float *pixels = nullptr;
+    PixelFormat pixel_format = IMG_PIXEL_FLOAT;
+
+    /**
+     * Pixel storage in the image's pixel format.
+     */
+    unsigned char *pixels = nullptr;
+
+    /**
+     * Display transform for the 8 bit outputs. HDR outputs are always linear.
+     */
+    PostProcess post_process;
+
+    ExrPixelType exr_pixel_type = EXR_PIXEL_HALF;
+    ExrCompression exr_compression = EXR_COMPRESSION_ZIP;
+
+    /**
+     * Converts the pixels to 8 bit display values, in parallel over rows,
+     * into a buffer of width * height * 3 bytes.
+     */
+    void quantize(unsigned char *buffer) const;
 
     bool save_as_ppm(const std::string &file_name);
 
+    bool save_as_png(const std::string &file_name);
+
+    /**
+     * Portable float map: raw little endian float RGB, bottom row first.
+     */
+    bool save_as_pfm(const std::string &file_name);
+
+    bool save_as_exr(const std::string &file_name);
+
     bool save_auto_detect(const std::string &file_name);
 
 public:
@@ -38,20 +69,79 @@ public:
 
     enum ImageFormat {
         IMG_FMT_PPM,
+        IMG_FMT_PNG,
+        IMG_FMT_PFM,
+        IMG_FMT_EXR,
         IMG_FMT_AUTO_DETECT
     };
 
-    bool create(unsigned int width, unsigned int height);
-
+    /**
+     * Allocates the pixel memory. Compact pixel formats trade precision or dynamic range
+     * for memory and bandwidth, the conversion happens when rows are written.
+     */
+    bool create(unsigned int width, unsigned int height, PixelFormat pixel_format = IMG_PIXEL_FLOAT);
+
+    /**
+     * Sets the image size without allocating any pixel memory, for renders that stream
+     * their output to disk.
+     */
+    void set_dimensions(unsigned int width, unsigned int height);
+
+    /**
+     * Frees the pixel memory. Images are copied shallowly so this must only be called
+     * once no other copy uses the pixels anymore.
+     */
+    void destroy();
+
+    /**
+     * Direct access to the pixels of IMG_PIXEL_FLOAT images. Returns nullptr for other pixel formats.
+     */
     float *get_pixels() const;
 
+    PixelFormat get_pixel_format() const;
+
+    /**
+     * Converts row_count rows of width * 3 floats to the pixel format and stores them starting at first_row.
+     */
+    void write_rows(unsigned int first_row, unsigned int row_count, const float *pixels);
+
+    /**
+     * Converts row_count rows starting at first_row back to width * 3 floats per row.
+     */
+    void read_rows(unsigned int first_row, unsigned int row_count, float *pixels) const;
+
+    /**
+     * Copies the source image into this one with its top left pixel at (x, y), converting
+     * between pixel formats. The source must fit.
+     */
+    bool blit(const Image &source, unsigned int x, unsigned int y);
+
     unsigned int get_width() const;
 
     unsigned int get_height() const;
 
-    void tone_map_pixel(float *r, float *g, float *b);
+    /**
+     * Sets the display transform of the 8 bit formats, used both when saving and when writing
+     * rows to IMG_PIXEL_SRGB8 storage.
+     */
+    void set_post_process(const PostProcess &post_process);
+
+    const PostProcess &get_post_process() const;
+
+    void set_exr_options(ExrPixelType pixel_type, ExrCompression compression);
 
     bool save(const std::string &file_name, ImageFormat image_format = IMG_FMT_AUTO_DETECT);
+
+    /**
+     * Loads a .pfm file into a newly created IMG_PIXEL_FLOAT image. Grayscale maps are
+     * expanded to RGB.
+     */
+    bool load(const std::string &file_name);
+
+    /**
+     * Clamps floats to [0, 1] and scales them to 8 bits.
+     */
+    static void quantize_span(const float *in, unsigned char *out, size_t count);
 };
 
 #endif //HELIOS_IMAGE_H
@@ -0,0 +1,130 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "image.h"
+#include "image_stream.h"
+
+ImageStream::~ImageStream()
+{
+    close();
+}
+
+bool ImageStream::open(const std::string &file_name, unsigned int width, unsigned int height)
+{
+    close();
+
+    file_descriptor = ::open(file_name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+    if (file_descriptor < 0) {
+        std::cerr << "Could not open file " << file_name << " for writing!" << std::endl;
+        return false;
+    }
+
+    this->file_name = file_name;
+    this->width = width;
+    this->height = height;
+
+    rows_written = 0;
+
+    std::string header = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    header_size = header.size();
+
+    /**
+     * Size the file up front so rows can be written at their offsets in any order.
+     */
+    if (pwrite(file_descriptor, header.data(), header_size, 0) != (ssize_t) header_size ||
+        ftruncate(file_descriptor, (off_t) (header_size + (size_t) width * height * 3)) != 0) {
+        std::cerr << "Could not prepare file " << file_name << " for streaming!" << std::endl;
+        close();
+        return false;
+    }
+
+    std::cout << "Streaming image (" << width << " x " << height << ") to " << file_name << std::endl;
+
+    return true;
+}
+
+void ImageStream::set_post_process(const PostProcess &post_process)
+{
+    this->post_process = post_process;
+}
+
+bool ImageStream::write_rows(unsigned int first_row, unsigned int row_count, const float *pixels)
+{
+    if (file_descriptor < 0 || first_row + row_count > height) {
+        std::cerr << "ImageStream ERROR: Invalid rows " << first_row << " - " << first_row + row_count
+                  << " for " << file_name << std::endl;
+        return false;
+    }
+
+    size_t size = (size_t) row_count * width * 3;
+
+    std::vector<float> display(size);
+    post_process.apply(pixels, display.data(), size);
+
+    std::vector<unsigned char> buffer(size);
+    Image::quantize_span(display.data(), buffer.data(), size);
+
+    off_t offset = (off_t) (header_size + (size_t) first_row * width * 3);
+
+    if (pwrite(file_descriptor, buffer.data(), size, offset) != (ssize_t) size) {
+        std::cerr << "Failed writing rows to file " << file_name << "!" << std::endl;
+        return false;
+    }
+
+    rows_written += row_count;
+
+    return true;
+}
+
+bool ImageStream::close()
+{
+    if (file_descriptor < 0)
+        return true;
+
+    bool complete = rows_written == height;
+
+    if (!complete) {
+        std::cerr << "ImageStream WARNING: " << file_name << " closed with " << rows_written << " of "
+                  << height << " rows written." << std::endl;
+    }
+
+    bool closed = ::close(file_descriptor) == 0;
+    file_descriptor = -1;
+
+    return closed && complete;
+}
+
+bool ImageStream::is_open() const
+{
+    return file_descriptor >= 0;
+}
+
+unsigned int ImageStream::get_width() const
+{
+    return width;
+}
+
+unsigned int ImageStream::get_height() const
+{
+    return height;
+}
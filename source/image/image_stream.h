@@ -0,0 +1,75 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_IMAGE_STREAM_H
+#define HELIOS_IMAGE_STREAM_H
+
+#include <string>
+#include <atomic>
+#include "post_process.h"
+
+/**
+ * Progressively written PPM file.
+ *
+ * Finished rows are quantized and written straight to their final position in the file,
+ * so only the rows currently being rendered have to be kept in memory. Rows can be written
+ * in any order and from multiple threads at once.
+ */
+class ImageStream {
+private:
+    int file_descriptor = -1;
+
+    std::string file_name;
+
+    unsigned int width = 0;
+    unsigned int height = 0;
+
+    size_t header_size = 0;
+
+    PostProcess post_process;
+
+    std::atomic<unsigned long> rows_written;
+
+public:
+    ImageStream() : rows_written(0)
+    { }
+
+    ~ImageStream();
+
+    bool open(const std::string &file_name, unsigned int width, unsigned int height);
+
+    /**
+     * Display transform applied to the linear rows before quantization.
+     */
+    void set_post_process(const PostProcess &post_process);
+
+    /**
+     * Quantizes and writes row_count rows of width * 3 floats starting at first_row.
+     */
+    bool write_rows(unsigned int first_row, unsigned int row_count, const float *pixels);
+
+    bool close();
+
+    bool is_open() const;
+
+    unsigned int get_width() const;
+
+    unsigned int get_height() const;
+};
+
+#endif //HELIOS_IMAGE_STREAM_H
@@ -0,0 +1,234 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <math.h>
+#include <string.h>
+#include "image.h"
+#include "pixel_format.h"
+
+#ifdef __F16C__
+#include <immintrin.h>
+#endif
+
+/* Static functions */
+
+static inline uint32_t float_bits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    return bits;
+}
+
+static inline float bits_float(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+
+static void encode_rgbe(const float *in, unsigned char *out)
+{
+    float r = in[0] > 0.0f ? in[0] : 0.0f;
+    float g = in[1] > 0.0f ? in[1] : 0.0f;
+    float b = in[2] > 0.0f ? in[2] : 0.0f;
+
+    float max = r > g ? (r > b ? r : b) : (g > b ? g : b);
+
+    if (max < 1e-32f) {
+        out[0] = out[1] = out[2] = out[3] = 0;
+        return;
+    }
+
+    int exponent;
+    float scale = (float) frexp(max, &exponent) * 256.0f / max;
+
+    out[0] = (unsigned char) (r * scale);
+    out[1] = (unsigned char) (g * scale);
+    out[2] = (unsigned char) (b * scale);
+    out[3] = (unsigned char) (exponent + 128);
+}
+
+static void decode_rgbe(const unsigned char *in, float *out)
+{
+    if (!in[3]) {
+        out[0] = out[1] = out[2] = 0.0f;
+        return;
+    }
+
+    float scale = (float) ldexp(1.0, in[3] - (128 + 8));
+
+    out[0] = (in[0] + 0.5f) * scale;
+    out[1] = (in[1] + 0.5f) * scale;
+    out[2] = (in[2] + 0.5f) * scale;
+}
+
+/* ------------------------------------------------------------------*/
+
+size_t pixel_format_size(PixelFormat format)
+{
+    switch (format) {
+        case IMG_PIXEL_FLOAT:
+            return 3 * sizeof(float);
+        case IMG_PIXEL_HALF:
+            return 3 * sizeof(uint16_t);
+        case IMG_PIXEL_RGBE:
+            return 4;
+        case IMG_PIXEL_SRGB8:
+            return 3;
+    }
+
+    return 0;
+}
+
+uint16_t float_to_half(float value)
+{
+    /**
+     * Round to nearest even (F. Giesen, "float->half variants").
+     */
+    static const uint32_t f32_infinity = 255u << 23;
+    static const uint32_t f16_max = (127u + 16u) << 23;
+    static const uint32_t denorm_magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+    uint32_t bits = float_bits(value);
+    uint32_t sign = bits & 0x80000000u;
+    bits ^= sign;
+
+    uint16_t half;
+
+    if (bits >= f16_max) {
+        /**
+         * Overflow to infinity, keep NaNs.
+         */
+        half = bits > f32_infinity ? 0x7e00 : 0x7c00;
+    }
+    else if (bits < (113u << 23)) {
+        /**
+         * Denormals and zero, the addition does the rounding.
+         */
+        half = (uint16_t) (float_bits(bits_float(bits) + bits_float(denorm_magic)) - denorm_magic);
+    }
+    else {
+        uint32_t mantissa_odd = (bits >> 13) & 1u;
+
+        bits += ((uint32_t) (15 - 127) << 23) + 0xfffu;
+        bits += mantissa_odd;
+
+        half = (uint16_t) (bits >> 13);
+    }
+
+    return (uint16_t) (half | (sign >> 16));
+}
+
+float half_to_float(uint16_t value)
+{
+    static const uint32_t shifted_exponent = 0x7c00u << 13;
+
+    uint32_t bits = (value & 0x7fffu) << 13;
+    uint32_t exponent = shifted_exponent & bits;
+
+    bits += (127u - 15u) << 23;
+
+    if (exponent == shifted_exponent) {
+        /**
+         * Infinity or NaN.
+         */
+        bits += (128u - 16u) << 23;
+    }
+    else if (exponent == 0) {
+        /**
+         * Zero or denormal, renormalize.
+         */
+        bits += 1u << 23;
+        bits = float_bits(bits_float(bits) - bits_float(113u << 23));
+    }
+
+    return bits_float(bits | ((uint32_t) (value & 0x8000u) << 16));
+}
+
+void encode_pixels(PixelFormat format, const float *in, unsigned char *out, size_t pixel_count)
+{
+    size_t value_count = pixel_count * 3;
+
+    switch (format) {
+        case IMG_PIXEL_FLOAT:
+            memcpy(out, in, value_count * sizeof(float));
+            break;
+        case IMG_PIXEL_HALF: {
+            uint16_t *half = (uint16_t *) out;
+            size_t i = 0;
+
+#ifdef __F16C__
+            for (; i + 8 <= value_count; i += 8) {
+                __m256 values = _mm256_loadu_ps(in + i);
+                _mm_storeu_si128((__m128i *) (half + i), _mm256_cvtps_ph(values, _MM_FROUND_TO_NEAREST_INT));
+            }
+#endif
+
+            for (; i < value_count; i++) {
+                half[i] = float_to_half(in[i]);
+            }
+            break;
+        }
+        case IMG_PIXEL_RGBE:
+            for (size_t i = 0; i < pixel_count; i++) {
+                encode_rgbe(in + i * 3, out + i * 4);
+            }
+            break;
+        case IMG_PIXEL_SRGB8:
+            Image::quantize_span(in, out, value_count);
+            break;
+    }
+}
+
+void decode_pixels(PixelFormat format, const unsigned char *in, float *out, size_t pixel_count)
+{
+    size_t value_count = pixel_count * 3;
+
+    switch (format) {
+        case IMG_PIXEL_FLOAT:
+            memcpy(out, in, value_count * sizeof(float));
+            break;
+        case IMG_PIXEL_HALF: {
+            const uint16_t *half = (const uint16_t *) in;
+            size_t i = 0;
+
+#ifdef __F16C__
+            for (; i + 8 <= value_count; i += 8) {
+                _mm256_storeu_ps(out + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *) (half + i))));
+            }
+#endif
+
+            for (; i < value_count; i++) {
+                out[i] = half_to_float(half[i]);
+            }
+            break;
+        }
+        case IMG_PIXEL_RGBE:
+            for (size_t i = 0; i < pixel_count; i++) {
+                decode_rgbe(in + i * 4, out + i * 3);
+            }
+            break;
+        case IMG_PIXEL_SRGB8:
+            for (size_t i = 0; i < value_count; i++) {
+                out[i] = in[i] * (1.0f / 255.0f);
+            }
+            break;
+    }
+}
@@ -0,0 +1,66 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_PIXEL_FORMAT_H
+#define HELIOS_PIXEL_FORMAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Storage formats for RGB pixels.
+ */
+enum PixelFormat {
+    /**
+     * 3 x 32 bit floats, 12 bytes per pixel.
+     */
+    IMG_PIXEL_FLOAT,
+
+    /**
+     * 3 x 16 bit half floats, 6 bytes per pixel.
+     */
+    IMG_PIXEL_HALF,
+
+    /**
+     * 8 bit mantissas with a shared 8 bit exponent (Ward's RGBE), 4 bytes per pixel.
+     */
+    IMG_PIXEL_RGBE,
+
+    /**
+     * 8 bits per channel of display encoded values in [0, 1], 3 bytes per pixel.
+     */
+    IMG_PIXEL_SRGB8
+};
+
+size_t pixel_format_size(PixelFormat format);
+
+uint16_t float_to_half(float value);
+
+float half_to_float(uint16_t value);
+
+/**
+ * Converts pixel_count RGB float pixels to the given storage format.
+ */
+void encode_pixels(PixelFormat format, const float *in, unsigned char *out, size_t pixel_count);
+
+/**
+ * Converts pixel_count pixels in the given storage format back to RGB floats.
+ */
+void decode_pixels(PixelFormat format, const unsigned char *in, float *out, size_t pixel_count);
+
+#endif //HELIOS_PIXEL_FORMAT_H
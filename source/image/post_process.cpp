@@ -0,0 +1,304 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "post_process.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+using namespace std::chrono;
+
+/**
+ * The curve table covers [2^-16, 1] with 64 linear segments per octave, found directly from
+ * the float bits: the exponent selects the octave and the top 6 mantissa bits the segment.
+ * Below 2^-16 the curve continues as a line through zero.
+ */
+static const int segment_shift = 17;
+static const uint32_t segment_mask = (1u << segment_shift) - 1;
+static const uint32_t table_start_bits = (127u - 16u) << 23;
+static const float table_start = 1.0f / 65536.0f;
+static const unsigned int table_segments = 16u << (23 - segment_shift);
+
+/* Static functions */
+
+static inline uint32_t float_bits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, 4);
+    return bits;
+}
+
+static inline float bits_float(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, 4);
+    return value;
+}
+
+static double evaluate_curve(TransferCurve curve, double value)
+{
+    switch (curve) {
+        case CURVE_GAMMA:
+            return pow(value, 1.0 / 2.2);
+        case CURVE_SRGB:
+            return value <= 0.0031308 ? value * 12.92 : 1.055 * pow(value, 1.0 / 2.4) - 0.055;
+        default:
+            return value;
+    }
+}
+
+static inline float tone_map(ToneMapOperator tone_map_operator, float value)
+{
+    switch (tone_map_operator) {
+        case TONE_MAP_REINHARD:
+            return value / (value + 1.0f);
+        case TONE_MAP_ACES:
+            return (value * (2.51f * value + 0.03f)) / (value * (2.43f * value + 0.59f) + 0.14f);
+        default:
+            return value;
+    }
+}
+
+static inline float saturate(float value)
+{
+    /**
+     * Also maps NaN to 0.
+     */
+    if (!(value > 0.0f))
+        return 0.0f;
+
+    return value < 1.0f ? value : 1.0f;
+}
+
+/* ------------------------------------------------------------------*/
+
+/* Private Functions */
+
+void PostProcess::build_curve_table()
+{
+    curve_table.clear();
+
+    if (transfer_curve == CURVE_LINEAR)
+        return;
+
+    /**
+     * One extra entry past 1.0 so the last segment can be interpolated.
+     */
+    curve_table.resize(table_segments + 2);
+
+    for (unsigned int i = 0; i < curve_table.size(); i++) {
+        float start = bits_float(table_start_bits + (i << segment_shift));
+        curve_table[i] = (float) evaluate_curve(transfer_curve, start);
+    }
+}
+
+float PostProcess::apply_curve(float value) const
+{
+    if (curve_table.empty())
+        return value;
+
+    if (value < table_start)
+        return value * (curve_table[0] / table_start);
+
+    uint32_t offset = float_bits(value) - table_start_bits;
+    uint32_t index = offset >> segment_shift;
+    float fraction = (offset & segment_mask) * (1.0f / (segment_mask + 1));
+
+    return curve_table[index] + fraction * (curve_table[index + 1] - curve_table[index]);
+}
+
+/* ---------------------------------------------------------------------- */
+
+PostProcess::PostProcess()
+{
+    build_curve_table();
+}
+
+PostProcess::PostProcess(ToneMapOperator tone_map_operator, TransferCurve transfer_curve, float exposure)
+        : tone_map_operator(tone_map_operator), transfer_curve(transfer_curve)
+{
+    set_exposure(exposure);
+    build_curve_table();
+}
+
+PostProcess PostProcess::identity()
+{
+    return PostProcess(TONE_MAP_NONE, CURVE_LINEAR);
+}
+
+void PostProcess::set_tone_map_operator(ToneMapOperator tone_map_operator)
+{
+    this->tone_map_operator = tone_map_operator;
+}
+
+void PostProcess::set_transfer_curve(TransferCurve transfer_curve)
+{
+    this->transfer_curve = transfer_curve;
+    build_curve_table();
+}
+
+void PostProcess::set_exposure(float exposure)
+{
+    this->exposure = exposure;
+    exposure_scale = (float) pow(2.0, exposure);
+}
+
+ToneMapOperator PostProcess::get_tone_map_operator() const
+{
+    return tone_map_operator;
+}
+
+TransferCurve PostProcess::get_transfer_curve() const
+{
+    return transfer_curve;
+}
+
+float PostProcess::get_exposure() const
+{
+    return exposure;
+}
+
+void PostProcess::apply(const float *in, float *out, size_t count) const
+{
+    size_t i = 0;
+
+#ifdef __SSE2__
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(exposure_scale);
+
+    const __m128 aces_a = _mm_set1_ps(2.51f);
+    const __m128 aces_b = _mm_set1_ps(0.03f);
+    const __m128 aces_c = _mm_set1_ps(2.43f);
+    const __m128 aces_d = _mm_set1_ps(0.59f);
+    const __m128 aces_e = _mm_set1_ps(0.14f);
+
+    const bool has_curve = !curve_table.empty();
+    const float *table = curve_table.data();
+
+    const __m128 start = _mm_set1_ps(table_start);
+    const __m128 toe_slope = _mm_set1_ps(has_curve ? table[0] / table_start : 1.0f);
+    const __m128i start_bits = _mm_set1_epi32((int) table_start_bits);
+    const __m128i mask = _mm_set1_epi32((int) segment_mask);
+    const __m128 fraction_scale = _mm_set1_ps(1.0f / (segment_mask + 1));
+
+    for (; i + 4 <= count; i += 4) {
+        __m128 value = _mm_mul_ps(_mm_loadu_ps(in + i), scale);
+
+        if (tone_map_operator == TONE_MAP_REINHARD) {
+            value = _mm_div_ps(value, _mm_add_ps(value, one));
+        }
+        else if (tone_map_operator == TONE_MAP_ACES) {
+            __m128 numerator = _mm_mul_ps(value, _mm_add_ps(_mm_mul_ps(aces_a, value), aces_b));
+            __m128 denominator = _mm_add_ps(_mm_mul_ps(value, _mm_add_ps(_mm_mul_ps(aces_c, value), aces_d)), aces_e);
+            value = _mm_div_ps(numerator, denominator);
+        }
+
+        /**
+         * max() returns its second operand for NaNs, so they become 0.
+         */
+        value = _mm_min_ps(_mm_max_ps(value, zero), one);
+
+        if (has_curve) {
+            __m128 below_table = _mm_cmplt_ps(value, start);
+
+            __m128i offset = _mm_andnot_si128(_mm_castps_si128(below_table),
+                                              _mm_sub_epi32(_mm_castps_si128(value), start_bits));
+            __m128 fraction = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(offset, mask)), fraction_scale);
+
+            alignas(16) uint32_t index[4];
+            _mm_store_si128((__m128i *) index, _mm_srli_epi32(offset, segment_shift));
+
+            /**
+             * SSE2 has no gather, the table lookups are scalar.
+             */
+            __m128 low = _mm_setr_ps(table[index[0]], table[index[1]], table[index[2]], table[index[3]]);
+            __m128 high = _mm_setr_ps(table[index[0] + 1], table[index[1] + 1], table[index[2] + 1],
+                                      table[index[3] + 1]);
+
+            __m128 curve = _mm_add_ps(low, _mm_mul_ps(fraction, _mm_sub_ps(high, low)));
+            __m128 toe = _mm_mul_ps(value, toe_slope);
+
+            value = _mm_or_ps(_mm_and_ps(below_table, toe), _mm_andnot_ps(below_table, curve));
+        }
+
+        _mm_storeu_ps(out + i, value);
+    }
+#endif
+
+    for (; i < count; i++) {
+        out[i] = apply_curve(saturate(tone_map(tone_map_operator, in[i] * exposure_scale)));
+    }
+}
+
+void PostProcess::benchmark(unsigned int pixel_count) const
+{
+    size_t count = (size_t) pixel_count * 3;
+
+    std::vector<float> input(count);
+    std::vector<float> reference(count);
+    std::vector<float> output(count);
+
+    /**
+     * Radiance values spread over several orders of magnitude.
+     */
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> distribution(-12.0f, 4.0f);
+
+    for (float &value : input) {
+        value = exp2f(distribution(generator));
+    }
+
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    for (size_t i = 0; i < count; i++) {
+        float value = saturate(tone_map(tone_map_operator, input[i] * exposure_scale));
+        reference[i] = (float) evaluate_curve(transfer_curve, value);
+    }
+
+    double scalar_time = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+
+    start = high_resolution_clock::now();
+
+    apply(input.data(), output.data(), count);
+
+    double vector_time = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+
+    float max_error = 0.0f;
+
+    for (size_t i = 0; i < count; i++) {
+        max_error = std::max(max_error, fabsf(output[i] - reference[i]));
+    }
+
+    double megapixels = pixel_count / 1000000.0;
+
+    std::cout << "Post-process benchmark (" << pixel_count << " pixels, single thread):" << std::endl;
+    std::cout << "    scalar pow: " << scalar_time << "ms (" << megapixels / (scalar_time / 1000.0)
+              << " Mpixels/s)" << std::endl;
+    std::cout << "    vectorized: " << vector_time << "ms (" << megapixels / (vector_time / 1000.0)
+              << " Mpixels/s)" << std::endl;
+    std::cout << "    max difference: " << max_error << std::endl;
+}
@@ -0,0 +1,115 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_POST_PROCESS_H
+#define HELIOS_POST_PROCESS_H
+
+#include <stddef.h>
+#include <vector>
+
+enum ToneMapOperator {
+    TONE_MAP_NONE,
+
+    /**
+     * x / (1 + x) per channel.
+     */
+    TONE_MAP_REINHARD,
+
+    /**
+     * Narkowicz's rational fit of the ACES filmic curve.
+     */
+    TONE_MAP_ACES
+};
+
+enum TransferCurve {
+    CURVE_LINEAR,
+
+    /**
+     * Pure 1 / 2.2 power.
+     */
+    CURVE_GAMMA,
+
+    /**
+     * The piecewise sRGB curve with its linear toe.
+     */
+    CURVE_SRGB
+};
+
+/**
+ * Display transform from linear radiance to [0, 1] display values: exposure, tone mapping and
+ * the transfer curve. Applied to copies of the framebuffer when writing 8 bit outputs, so the
+ * rendered HDR data stays untouched.
+ *
+ * The transfer curve is evaluated through a lookup table indexed by the float's exponent and
+ * top mantissa bits, which keeps the relative error below 1e-5 over the whole [0, 1] range.
+ */
+class PostProcess {
+private:
+    ToneMapOperator tone_map_operator = TONE_MAP_REINHARD;
+    TransferCurve transfer_curve = CURVE_GAMMA;
+
+    float exposure = 0.0f;
+    float exposure_scale = 1.0f;
+
+    /**
+     * Curve samples at the segment boundaries, see build_curve_table().
+     */
+    std::vector<float> curve_table;
+
+    void build_curve_table();
+
+    float apply_curve(float value) const;
+
+public:
+    PostProcess();
+
+    PostProcess(ToneMapOperator tone_map_operator, TransferCurve transfer_curve, float exposure = 0.0f);
+
+    /**
+     * Tone mapping off and a linear curve, values are only clamped.
+     */
+    static PostProcess identity();
+
+    void set_tone_map_operator(ToneMapOperator tone_map_operator);
+
+    void set_transfer_curve(TransferCurve transfer_curve);
+
+    /**
+     * Exposure adjustment in stops.
+     */
+    void set_exposure(float exposure);
+
+    ToneMapOperator get_tone_map_operator() const;
+
+    TransferCurve get_transfer_curve() const;
+
+    float get_exposure() const;
+
+    /**
+     * Transforms count linear values from in to out, which may alias. The output is clamped to [0, 1].
+     */
+    void apply(const float *in, float *out, size_t count) const;
+
+    /**
+     * Times apply() against the straightforward scalar transform on pixel_count random pixels
+     * and prints the throughput of both and the largest difference.
+     */
+    void benchmark(unsigned int pixel_count) const;
+};
+
+#endif //HELIOS_POST_PROCESS_H
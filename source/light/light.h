@@ -21,16 +21,71 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <object.h>
 
+/**
+ * A point light. Area lights derive from this class and override the sampling functions.
+ */
 class Light : public Object {
 private:
     Vec3 color;
 
+protected:
+    /**
+     * Number of shadow/B.R.D.F. samples taken per shading point. Only used by area lights.
+     */
+    unsigned int samples = 1;
+
 public:
     Light() = default;
 
     Light(const Vec3 &position, const Vec3 &color) : Object(position), color(color)
     { }
 
+    virtual bool is_area_light() const
+    {
+        return false;
+    }
+
+    /**
+     * Samples a point on the light as seen from the given surface point, using the
+     * two uniform numbers u and v in [0, 1).
+     * Returns the radiance emitted towards the surface point. The pdf is in solid angle
+     * measure and is 0 if the light can't be seen from the point.
+     */
+    virtual Vec3 sample(const Vec3 &point, float u, float v, Vec3 *light_point, float *pdf) const
+    {
+        *light_point = position;
+        *pdf = 1.0f;
+
+        return color;
+    }
+
+    /**
+     * Intersects a ray with a normalized direction with the light's emitting surface.
+     */
+    virtual bool intersect(const Ray &ray, float *distance) const
+    {
+        return false;
+    }
+
+    /**
+     * The solid angle pdf of sample() choosing the given normalized direction from the point,
+     * the light surface being at the given distance along it.
+     */
+    virtual float pdf(const Vec3 &point, const Vec3 &direction, float distance) const
+    {
+        return 0.0f;
+    }
+
+    void set_samples(unsigned int samples)
+    {
+        this->samples = samples ? samples : 1;
+    }
+
+    unsigned int get_samples() const
+    {
+        return samples;
+    }
+
     void set_color(const Vec3 &color)
     {
         this->color = color;
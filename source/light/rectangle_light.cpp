@@ -0,0 +1,119 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "rectangle_light.h"
+
+/* Private Functions -------------------------------------------------------- */
+
+void RectangleLight::update_normal_and_area()
+{
+    normal = cross(edge_u, edge_v);
+    area = normal.length();
+
+    normal.normalize();
+}
+
+/* -------------------------------------------------------------------------- */
+
+void RectangleLight::set_edges(const Vec3 &edge_u, const Vec3 &edge_v)
+{
+    this->edge_u = edge_u;
+    this->edge_v = edge_v;
+
+    update_normal_and_area();
+}
+
+const Vec3 &RectangleLight::get_edge_u() const
+{
+    return edge_u;
+}
+
+const Vec3 &RectangleLight::get_edge_v() const
+{
+    return edge_v;
+}
+
+const Vec3 &RectangleLight::get_normal() const
+{
+    return normal;
+}
+
+bool RectangleLight::is_area_light() const
+{
+    return true;
+}
+
+Vec3 RectangleLight::sample(const Vec3 &point, float u, float v, Vec3 *light_point, float *pdf) const
+{
+    *light_point = position + edge_u * (u - 0.5f) + edge_v * (v - 0.5f);
+
+    Vec3 to_light = *light_point - point;
+    float distance_squared = to_light.length_squared();
+
+    /**
+     * Convert the uniform area density to solid angle. Points behind the light get nothing.
+     */
+    float cos_light = -dot(normal, to_light.normalized());
+
+    if (cos_light <= 0.0f || distance_squared == 0.0f) {
+        *pdf = 0.0f;
+        return Vec3();
+    }
+
+    *pdf = distance_squared / (cos_light * area);
+
+    return get_color();
+}
+
+bool RectangleLight::intersect(const Ray &ray, float *distance) const
+{
+    float n_dot_rdir = dot(normal, ray.direction);
+
+    /**
+     * The light only emits from its front side.
+     */
+    if (n_dot_rdir >= 0.0f)
+        return false;
+
+    float t = dot(position - ray.origin, normal) / n_dot_rdir;
+
+    if (t < 1e-4f)
+        return false;
+
+    Vec3 local = ray.origin + ray.direction * t - position;
+
+    float a = dot(local, edge_u) / dot(edge_u, edge_u);
+    float b = dot(local, edge_v) / dot(edge_v, edge_v);
+
+    if (a < -0.5f || a > 0.5f || b < -0.5f || b > 0.5f)
+        return false;
+
+    *distance = t;
+
+    return true;
+}
+
+float RectangleLight::pdf(const Vec3 &point, const Vec3 &direction, float distance) const
+{
+    float cos_light = -dot(normal, direction);
+
+    if (cos_light <= 0.0f)
+        return 0.0f;
+
+    return distance * distance / (cos_light * area);
+}
@@ -0,0 +1,66 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_RECTANGLE_LIGHT_H
+#define HELIOS_RECTANGLE_LIGHT_H
+
+#include "light.h"
+
+/**
+ * A one sided rectangular area light centered at its position and spanned by two
+ * perpendicular edge vectors. It emits towards cross(edge_u, edge_v) and its color
+ * is the emitted radiance.
+ */
+class RectangleLight : public Light {
+private:
+    Vec3 edge_u = Vec3(1.0f, 0.0f, 0.0f);
+    Vec3 edge_v = Vec3(0.0f, 0.0f, 1.0f);
+
+    Vec3 normal = Vec3(0.0f, -1.0f, 0.0f);
+
+    float area = 1.0f;
+
+    void update_normal_and_area();
+
+public:
+    RectangleLight() = default;
+
+    RectangleLight(const Vec3 &position, const Vec3 &edge_u, const Vec3 &edge_v, const Vec3 &color)
+            : Light(position, color), edge_u(edge_u), edge_v(edge_v)
+    {
+        update_normal_and_area();
+    }
+
+    void set_edges(const Vec3 &edge_u, const Vec3 &edge_v);
+
+    const Vec3 &get_edge_u() const;
+
+    const Vec3 &get_edge_v() const;
+
+    const Vec3 &get_normal() const;
+
+    bool is_area_light() const;
+
+    Vec3 sample(const Vec3 &point, float u, float v, Vec3 *light_point, float *pdf) const;
+
+    bool intersect(const Ray &ray, float *distance) const;
+
+    float pdf(const Vec3 &point, const Vec3 &direction, float distance) const;
+};
+
+#endif //HELIOS_RECTANGLE_LIGHT_H
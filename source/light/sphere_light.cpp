@@ -0,0 +1,121 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifdef _WIN32
+#define _USE_MATH_DEFINES
+#endif
+
+#include <math.h>
+#include <algorithm>
+#include "sphere_light.h"
+
+void SphereLight::set_radius(float radius)
+{
+    this->radius = radius;
+}
+
+float SphereLight::get_radius() const
+{
+    return radius;
+}
+
+bool SphereLight::is_area_light() const
+{
+    return true;
+}
+
+Vec3 SphereLight::sample(const Vec3 &point, float u, float v, Vec3 *light_point, float *pdf) const
+{
+    Vec3 to_center = position - point;
+    float distance_squared = to_center.length_squared();
+
+    /**
+     * Points inside the light can't be lit by it.
+     */
+    if (distance_squared <= radius * radius) {
+        *pdf = 0.0f;
+        return Vec3();
+    }
+
+    float distance = (float) sqrt(distance_squared);
+    Vec3 w = to_center / distance;
+    Vec3 t, b;
+    orthonormal_basis(w, &t, &b);
+
+    /**
+     * Pick a direction uniformly inside the cone subtended by the sphere.
+     */
+    float sin_theta_max_squared = radius * radius / distance_squared;
+    float cos_theta_max = (float) sqrt(std::max(0.0f, 1.0f - sin_theta_max_squared));
+
+    float cos_theta = 1.0f - u * (1.0f - cos_theta_max);
+    float sin_theta = (float) sqrt(std::max(0.0f, 1.0f - cos_theta * cos_theta));
+    float phi = 2.0f * (float) M_PI * v;
+
+    Vec3 direction = t * (sin_theta * (float) cos(phi)) + b * (sin_theta * (float) sin(phi)) + w * cos_theta;
+
+    /**
+     * Distance to the near side of the sphere along the chosen direction.
+     */
+    float projected = distance * cos_theta;
+    float t_hit = projected - (float) sqrt(std::max(0.0f, radius * radius - distance_squared + projected * projected));
+
+    *light_point = point + direction * t_hit;
+    *pdf = 1.0f / (2.0f * (float) M_PI * (1.0f - cos_theta_max));
+
+    return get_color();
+}
+
+bool SphereLight::intersect(const Ray &ray, float *distance) const
+{
+    Vec3 oc = ray.origin - position;
+
+    float b = dot(oc, ray.direction);
+    float c = dot(oc, oc) - radius * radius;
+
+    float disc = b * b - c;
+
+    if (disc < 0.0f)
+        return false;
+
+    float disc_sqrt = (float) sqrt(disc);
+
+    float t = -b - disc_sqrt;
+
+    if (t < 1e-4f)
+        t = -b + disc_sqrt;
+
+    if (t < 1e-4f)
+        return false;
+
+    *distance = t;
+
+    return true;
+}
+
+float SphereLight::pdf(const Vec3 &point, const Vec3 &direction, float distance) const
+{
+    float distance_squared = (position - point).length_squared();
+
+    if (distance_squared <= radius * radius)
+        return 0.0f;
+
+    float cos_theta_max = (float) sqrt(std::max(0.0f, 1.0f - radius * radius / distance_squared));
+
+    return 1.0f / (2.0f * (float) M_PI * (1.0f - cos_theta_max));
+}
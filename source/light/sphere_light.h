@@ -0,0 +1,51 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_SPHERE_LIGHT_H
+#define HELIOS_SPHERE_LIGHT_H
+
+#include "light.h"
+
+/**
+ * A spherical area light. The light color is the radiance emitted from its surface.
+ * Samples are distributed uniformly inside the cone the sphere subtends from the shading point.
+ */
+class SphereLight : public Light {
+private:
+    float radius = 0.0f;
+
+public:
+    SphereLight() = default;
+
+    SphereLight(const Vec3 &position, float radius, const Vec3 &color) : Light(position, color), radius(radius)
+    { }
+
+    void set_radius(float radius);
+
+    float get_radius() const;
+
+    bool is_area_light() const;
+
+    Vec3 sample(const Vec3 &point, float u, float v, Vec3 *light_point, float *pdf) const;
+
+    bool intersect(const Ray &ray, float *distance) const;
+
+    float pdf(const Vec3 &point, const Vec3 &direction, float distance) const;
+};
+
+#endif //HELIOS_SPHERE_LIGHT_H
@@ -17,65 +17,190 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include <camera.h>
+#include <camera_ray_generator.h>
 #include <drawable.h>
 #include <sphere.h>
 #include <scene.h>
 #include <renderer.h>
 #include <ray_tracer.h>
+#include <path_tracer.h>
 #include <plane.h>
 #include <utils.h>
+#include <post_process.h>
+#include <denoiser.h>
+#include <obj_importer.h>
+#include <limits>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
 
+using namespace std::chrono;
 
-int main(int argc, char **argv)
+/**
+ * Denoises a saved color image with its AOV buffers, given one by one or by the prefix --aov
+ * wrote them with:
+ * <color.pfm> <normal.pfm> <albedo.pfm> <depth.pfm> <output> [reference.pfm]
+ * <color.pfm> <aov prefix> <output> [reference.pfm]
+ */
+static int denoise_files(int argc, char **argv)
 {
+    if (argc < 3) {
+        std::cerr << "Usage: helios --denoise <color.pfm> <normal.pfm> <albedo.pfm> <depth.pfm> <output> "
+                "[reference.pfm]" << std::endl;
+        std::cerr << "       helios --denoise <color.pfm> <aov prefix> <output> [reference.pfm]" << std::endl;
+        return 1;
+    }
+
+    bool prefixed = argc < 5;
+    std::string prefix = argv[1];
+
+    std::string normal_file = prefixed ? prefix + "_normal.pfm" : argv[1];
+    std::string albedo_file = prefixed ? prefix + "_albedo.pfm" : argv[2];
+    std::string depth_file = prefixed ? prefix + "_depth.pfm" : argv[3];
+
+    int output_index = prefixed ? 2 : 4;
+
+    Image color, normal, albedo, depth, output;
+
+    if (!color.load(argv[0]) || !normal.load(normal_file) || !albedo.load(albedo_file) || !depth.load(depth_file))
+        return 1;
+
+    Denoiser denoiser;
+
+    if (!denoiser.denoise(color, &normal, &albedo, &depth, &output) || !output.save(argv[output_index]))
+        return 1;
+
+    if (argc > output_index + 1) {
+        Image reference;
+
+        if (!reference.load(argv[output_index + 1]))
+            return 1;
+
+        std::cout << "RMSE before: " << Denoiser::rmse(color, reference) << ", after: "
+                  << Denoiser::rmse(output, reference) << " (" << denoiser.get_denoise_time() << "ms)" << std::endl;
+    }
+
+    return 0;
+}
+
+
+static const unsigned int frame_width = 1024;
+static const unsigned int frame_height = 768;
+
+/**
+ * Scene description given with --scene, the built in scene is rendered if empty.
+ */
+static std::string scene_file;
+
+/**
+ * Storage format of the rendered frame given with --pixel-format.
+ */
+static PixelFormat pixel_format = IMG_PIXEL_FLOAT;
+
+static bool parse_pixel_format(const std::string &name, PixelFormat *format)
+{
+    if (name == "float")
+        *format = IMG_PIXEL_FLOAT;
+    else if (name == "half")
+        *format = IMG_PIXEL_HALF;
+    else if (name == "rgbe")
+        *format = IMG_PIXEL_RGBE;
+    else if (name == "srgb8")
+        *format = IMG_PIXEL_SRGB8;
+    else {
+        std::cerr << "ERROR: Unknown pixel format " << name << ", expected float, half, rgbe or srgb8!"
+                  << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * File name prefix given with --aov. When set, render commands also write every AOV buffer
+ * to <prefix>_<name>.pfm.
+ */
+static std::string aov_prefix;
+
+static const char *aov_names[AOV_COUNT] = {"depth", "normal", "albedo", "object_id"};
+
+static void enable_aovs(RayTracer *renderer)
+{
+    if (aov_prefix.empty())
+        return;
+
+    for (int i = 0; i < AOV_COUNT; i++) {
+        renderer->enable_aov((AovType) i);
+    }
+}
+
+static bool save_aovs(const RayTracer *renderer)
+{
+    if (aov_prefix.empty())
+        return true;
+
+    for (int i = 0; i < AOV_COUNT; i++) {
+        if (!renderer->save_aov((AovType) i, aov_prefix + "_" + aov_names[i] + ".pfm"))
+            return false;
+    }
+
+    return true;
+}
+
+static Scene *create_scene()
+{
+    if (!scene_file.empty()) {
+        Scene *scene = new Scene;
+
+        if (!scene->load(scene_file)) {
+            delete scene;
+            return nullptr;
+        }
+
+        return scene;
+    }
+
+    Scene *scene = new Scene;
+    MaterialLibrary &materials = scene->get_material_library();
+
+    ShadingModel oren_nayar(OREN_NYAR, GGX, COOK_TORRANCE, SCHLICK_APPROXIMATION);
+
     Drawable *sphere = new Sphere(Vec3(0.0, 0.0f, 0.0f), 0.3);
-    sphere->material.albedo = Vec3(1.000, 0.0f, 0.0);
-    sphere->material.roughness = 1.0f;
-    sphere->material.metallic = false;
-    sphere->material.shading_model.diffuse_function = OREN_NYAR;
+    sphere->material = materials.add(Material(Vec3(1.000, 0.0f, 0.0), 1.0f, 0.0f, false, oren_nayar));
 
     Drawable *sphere2 = new Sphere(Vec3(1.5f, -0.0f, 0.0f), 0.3);
-    sphere2->material.albedo = Vec3(1.000, 0.0f, 0.0);
-    sphere2->material.roughness = 0.999f;
-    sphere2->material.metallic = false;
+    sphere2->material = materials.add(Material(Vec3(1.000, 0.0f, 0.0), 0.999f, 0.0f, false, ShadingModel()));
 
     Drawable *plane_d = new Plane(Vec3(0, -0.3f, 0), Vec3(0, 1, 0));
-    plane_d->material.albedo = Vec3(1.0, 1.0f, 1.0);
-    plane_d->material.roughness = 0.8f;
-    plane_d->material.metallic = false;
+    plane_d->material = materials.add(Material(Vec3(1.0, 1.0f, 1.0), 0.8f, 0.0f, false, ShadingModel()));
 
     Drawable *plane_b = new Plane(Vec3(0, 0, 6), Vec3(0, 0, -1));
-    plane_b->material.albedo = Vec3(1.0, 1.0f, 1.0);
-    plane_b->material.roughness = 1.0;
-    plane_b->material.metallic = false;
+    plane_b->material = materials.add(Material(Vec3(1.0, 1.0f, 1.0), 1.0f, 0.0f, false, ShadingModel()));
 
     Drawable *plane_u = new Plane(Vec3(0, 7.0f, 0), Vec3(0, -1, 0));
-    plane_u->material.albedo = Vec3(1.0, 1.0f, 1.0);
-    plane_u->material.roughness = 1.0;
-    plane_u->material.metallic = false;
+    plane_u->material = plane_b->material;
 
     Drawable *plane_l = new Plane(Vec3(-3.5f, 0, 0), Vec3(1, 0, 0));
-    plane_l->material.albedo = Vec3(1.0, 1.0f, 1.0);
-    plane_l->material.roughness = 1.0;
-    plane_l->material.metallic = false;
+    plane_l->material = plane_b->material;
 
     Drawable *plane_r = new Plane(Vec3(3.5f, 0, 0), Vec3(-1, 0, 0));
-    plane_r->material.albedo = Vec3(1.0, 0.1f, 0.1);
-    plane_r->material.roughness = 0.4;
-    plane_r->material.metallic = false;
+    plane_r->material = materials.add(Material(Vec3(1.0, 0.1f, 0.1), 0.4f, 0.0f, false, ShadingModel()));
 
     Drawable *plane_f = new Plane(Vec3(0, 0.0f, -3), Vec3(0, 0, 1));
-    plane_f->material.albedo = Vec3(1.0, 1.0f, 1.0);
-    plane_f->material.roughness = 1.0;
-    plane_f->material.metallic = false;
+    plane_f->material = plane_b->material;
 
     Camera camera;
     camera.set_position(Vec3(0.0f, 0.0f, -1.0f));
     camera.set_target(Vec3(0.0, 0.0f, 0));
     camera.set_fov(50.0f, Camera::CAM_FOV_DEGREES);
 
-    Scene *scene = new Scene;
-
     //Utils::generate_sphere_flake(scene, sphere->material, Vec3(0, 0.4, 0), 0.3, 0.4, 4);
     scene->add_drawable(sphere);
 //    scene->add_drawable(sphere2);
@@ -102,15 +227,1347 @@ int main(int argc, char **argv)
 
     //scene->add_light(lt2);
 
+    scene->build_bvh();
+
+    return scene;
+}
+
+/**
+ * Renders the frame region with its top left pixel at (x, y) and saves it to file_name.
+ */
+static int render_region(unsigned int x, unsigned int y, unsigned int width, unsigned int height,
+                         const std::string &file_name)
+{
     Image image;
-    image.create(1024, 768);
 
-    Renderer *renderer = new RayTracer(scene, image);
+    if (!image.create(width, height, pixel_format))
+        return 1;
+
+    Scene *scene = create_scene();
+
+    if (!scene)
+        return 1;
+
+    RayTracer *renderer = new RayTracer(scene, image);
+    renderer->set_render_region(frame_width, frame_height, x, y);
+
+    enable_aovs(renderer);
+
+    if (!renderer->initialize())
+        return 1;
+
+    renderer->render();
+
+    bool saved = image.save(file_name) && save_aovs(renderer);
+
+    delete renderer;
+    image.destroy();
+
+    return saved ? 0 : 1;
+}
+
+/**
+ * Renders the frame straight into a PPM file through an ImageStream, so no frame sized pixel
+ * buffer is allocated: <output.ppm> [samples per pixel]
+ */
+static int render_streamed(int argc, char **argv)
+{
+    if (argc < 1 || (argc > 1 && atoi(argv[1]) <= 0)) {
+        std::cerr << "Usage: helios --stream <output.ppm> [samples per pixel]" << std::endl;
+        return 1;
+    }
+
+    ImageStream stream;
+
+    if (!stream.open(argv[0], frame_width, frame_height))
+        return 1;
+
+    Image image;
+    image.set_dimensions(frame_width, frame_height);
+
+    Scene *scene = create_scene();
+
+    if (!scene)
+        return 1;
+
+    RayTracer *renderer = new RayTracer(scene, image);
+    renderer->set_output_stream(&stream);
+
+    if (argc > 1) {
+        unsigned int samples = (unsigned int) atoi(argv[1]);
+        renderer->set_adaptive_sampling(samples, samples, 0.0f);
+    }
+
+    if (!renderer->initialize())
+        return 1;
+
+    renderer->render();
+
+    delete renderer;
+
+    return stream.close() ? 0 : 1;
+}
+
+/**
+ * Stitches region renders into one frame:
+ * <output> <frame width> <frame height> <region.pfm@x,y>...
+ */
+static int merge_files(int argc, char **argv)
+{
+    if (argc < 4) {
+        std::cerr << "Usage: helios --merge <output> <frame width> <frame height> <region.pfm@x,y>..." << std::endl;
+        return 1;
+    }
+
+    Image frame;
+
+    if (!frame.create((unsigned int) atoi(argv[1]), (unsigned int) atoi(argv[2])))
+        return 1;
+
+    for (int i = 3; i < argc; i++) {
+        std::string argument = argv[i];
+
+        size_t at = argument.find_last_of('@');
+        size_t comma = argument.find_last_of(',');
+
+        if (at == std::string::npos || comma == std::string::npos || comma < at) {
+            std::cerr << "ERROR: Expected <region.pfm@x,y>, got " << argument << std::endl;
+            return 1;
+        }
+
+        Image region;
+
+        if (!region.load(argument.substr(0, at)))
+            return 1;
+
+        bool placed = frame.blit(region, (unsigned int) atoi(argument.substr(at + 1, comma - at - 1).c_str()),
+                                 (unsigned int) atoi(argument.substr(comma + 1).c_str()));
+        region.destroy();
+
+        if (!placed)
+            return 1;
+    }
+
+    bool saved = frame.save(argv[0]);
+    frame.destroy();
+
+    return saved ? 0 : 1;
+}
+
+/**
+ * Stand-in for a render farm: splits the frame into bands of rows, renders every band in its
+ * own process and merges the results. <process count> <output>
+ */
+static int distribute(int argc, char **argv)
+{
+    if (argc < 2 || atoi(argv[0]) <= 0) {
+        std::cerr << "Usage: helios --distribute <process count> <output>" << std::endl;
+        return 1;
+    }
+
+    unsigned int process_count = std::min((unsigned int) atoi(argv[0]), frame_height);
+    std::string output = argv[1];
+
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    std::vector<pid_t> processes;
+    std::vector<std::string> merge_arguments = {output, std::to_string(frame_width), std::to_string(frame_height)};
+    std::vector<std::string> region_files;
+
+    for (unsigned int i = 0; i < process_count; i++) {
+        unsigned int first_row = frame_height * i / process_count;
+        unsigned int last_row = frame_height * (i + 1) / process_count;
+
+        std::string file_name = output + ".region" + std::to_string(i) + ".pfm";
+
+        region_files.push_back(file_name);
+        merge_arguments.push_back(file_name + "@0," + std::to_string(first_row));
+
+        std::vector<std::string> arguments = {"helios", "--region", "0", std::to_string(first_row),
+                                              std::to_string(frame_width), std::to_string(last_row - first_row),
+                                              file_name};
+
+        if (!scene_file.empty())
+            arguments.insert(arguments.begin() + 1, {"--scene", scene_file});
+
+        pid_t pid = fork();
+
+        if (pid < 0) {
+            std::cerr << "ERROR: Could not start a render process!" << std::endl;
+            return 1;
+        }
+
+        if (pid == 0) {
+            std::vector<char *> exec_arguments;
+
+            for (auto &argument : arguments) {
+                exec_arguments.push_back(&argument[0]);
+            }
+            exec_arguments.push_back(nullptr);
+
+            execv("/proc/self/exe", exec_arguments.data());
+            _exit(127);
+        }
+
+        processes.push_back(pid);
+    }
+
+    bool succeeded = true;
+
+    for (pid_t pid : processes) {
+        int status;
+
+        if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            succeeded = false;
+    }
+
+    double render_time = duration_cast<milliseconds>(high_resolution_clock::now() - start).count();
+
+    if (!succeeded) {
+        std::cerr << "ERROR: A render process failed!" << std::endl;
+        return 1;
+    }
+
+    std::vector<char *> merge_argv;
+
+    for (auto &argument : merge_arguments) {
+        merge_argv.push_back(&argument[0]);
+    }
+
+    int result = merge_files((int) merge_argv.size(), merge_argv.data());
+
+    for (auto &file_name : region_files) {
+        std::remove(file_name.c_str());
+    }
+
+    std::cout << "Rendered " << process_count << " regions in " << render_time << "ms, merged in "
+              << duration_cast<milliseconds>(high_resolution_clock::now() - start).count() - render_time
+              << "ms" << std::endl;
+
+    return result;
+}
+
+/**
+ * Progressive supersampled render of the frame, resumed from the checkpoint file if it exists:
+ * <samples per pixel> <output> [checkpoint file] [checkpoint interval in seconds]
+ */
+static int render_progressive(int argc, char **argv)
+{
+    if (argc < 2 || atoi(argv[0]) <= 0) {
+        std::cerr << "Usage: helios --progressive <samples per pixel> <output> [checkpoint] [interval]" << std::endl;
+        return 1;
+    }
+
+    Image image;
+
+    if (!image.create(frame_width, frame_height, pixel_format))
+        return 1;
+
+    unsigned int samples = (unsigned int) atoi(argv[0]);
+
+    Scene *scene = create_scene();
+
+    if (!scene)
+        return 1;
+
+    RayTracer *renderer = new RayTracer(scene, image);
+    renderer->set_adaptive_sampling(samples, samples, 0.0f);
+    renderer->set_progressive(true);
+
+    std::string checkpoint = argc > 2 ? argv[2] : "";
+
+    if (!checkpoint.empty())
+        renderer->set_checkpoint(checkpoint, argc > 3 ? atof(argv[3]) : 60.0);
+
+    enable_aovs(renderer);
+
+    if (!renderer->initialize())
+        return 1;
+
+    if (!checkpoint.empty() && access(checkpoint.c_str(), F_OK) == 0 && !renderer->resume(checkpoint))
+        return 1;
 
-    renderer->initialize();
     renderer->render();
 
-    image.save("test.ppm", Image::IMG_FMT_PPM);
+    bool saved = image.save(argv[1]) && save_aovs(renderer);
+
+    delete renderer;
+    image.destroy();
+
+    return saved ? 0 : 1;
+}
+
+/**
+ * Progressive render of the frame stopped at a wall clock deadline:
+ * <budget in seconds> <max samples per pixel> <output>
+ */
+static int render_budgeted(int argc, char **argv)
+{
+    if (argc < 3 || atof(argv[0]) <= 0.0 || atoi(argv[1]) <= 0) {
+        std::cerr << "Usage: helios --budget <seconds> <max samples per pixel> <output>" << std::endl;
+        return 1;
+    }
+
+    Image image;
+
+    if (!image.create(frame_width, frame_height, pixel_format))
+        return 1;
+
+    unsigned int samples = (unsigned int) atoi(argv[1]);
+
+    Scene *scene = create_scene();
+
+    if (!scene)
+        return 1;
+
+    RayTracer *renderer = new RayTracer(scene, image);
+    renderer->set_adaptive_sampling(samples, samples, 0.0f);
+    renderer->set_progressive(true);
+    renderer->set_time_budget(atof(argv[0]));
+
+    enable_aovs(renderer);
+
+    if (!renderer->initialize())
+        return 1;
+
+    renderer->render();
+
+    bool saved = image.save(argv[2]) && save_aovs(renderer);
+
+    delete renderer;
+    image.destroy();
+
+    return saved ? 0 : 1;
+}
+
+/**
+ * Path traced render of the frame:
+ * <samples per pixel> <output> [max depth]
+ */
+static int render_path_traced(int argc, char **argv)
+{
+    if (argc < 2 || atoi(argv[0]) <= 0 || (argc > 2 && atoi(argv[2]) <= 0)) {
+        std::cerr << "Usage: helios --path-trace <samples per pixel> <output> [max depth]" << std::endl;
+        return 1;
+    }
+
+    Image image;
+
+    if (!image.create(frame_width, frame_height, pixel_format))
+        return 1;
+
+    Scene *scene = create_scene();
+
+    if (!scene)
+        return 1;
+
+    PathTracer *renderer = new PathTracer(scene, image);
+    renderer->set_samples_per_pixel((unsigned int) atoi(argv[0]));
+
+    if (argc > 2)
+        renderer->set_max_depth(atoi(argv[2]));
+
+    enable_aovs(renderer);
+
+    if (!renderer->initialize())
+        return 1;
+
+    renderer->render();
+
+    bool saved = image.save(argv[1]) && save_aovs(renderer);
+
+    delete renderer;
+    image.destroy();
+
+    return saved ? 0 : 1;
+}
+
+/**
+ * Root mean square difference of the display values of two images of the same size.
+ */
+static double get_rms_difference(const Image &a, const Image &b)
+{
+    size_t count = (size_t) a.get_width() * a.get_height() * 3;
+
+    std::vector<float> pixels_a(count), pixels_b(count);
+    a.read_rows(0, a.get_height(), pixels_a.data());
+    b.read_rows(0, b.get_height(), pixels_b.data());
+
+    double sum = 0.0;
+
+    for (size_t i = 0; i < count; i++) {
+        double difference = std::min(pixels_a[i], 1.0f) - std::min(pixels_b[i], 1.0f);
+        sum += difference * difference;
+    }
+
+    return sqrt(sum / count);
+}
+
+/**
+ * Checks the convergence of the path tracer on a quarter size frame. With every doubling of
+ * the sample count the difference between consecutive path traced images has to shrink. The
+ * difference to the ray traced image is reported but not checked, it levels off well above 0
+ * since the ray tracer has no indirect diffuse light and shades with other B.R.D.F.s:
+ * [samples per pixel] [doublings]
+ */
+static int compare_integrators(int argc, char **argv)
+{
+    unsigned int samples = argc > 0 ? (unsigned int) atoi(argv[0]) : 4;
+    int doublings = argc > 1 ? atoi(argv[1]) : 3;
+
+    if (!samples || doublings < 2) {
+        std::cerr << "Usage: helios --compare-integrators [samples per pixel] [doublings, at least 2]" << std::endl;
+        return 1;
+    }
+
+    Image reference, previous, current;
+
+    if (!reference.create(frame_width / 4, frame_height / 4) || !previous.create(frame_width / 4, frame_height / 4) ||
+        !current.create(frame_width / 4, frame_height / 4))
+        return 1;
+
+    Scene *scene = create_scene();
+
+    if (!scene)
+        return 1;
+
+    RayTracer *ray_tracer = new RayTracer(scene, reference);
+
+    if (!ray_tracer->initialize())
+        return 1;
+
+    ray_tracer->render();
+    ray_tracer->set_scene(nullptr);
+
+    delete ray_tracer;
+
+    PathTracer *path_tracer = new PathTracer(scene, previous);
+    double previous_difference = 0.0;
+
+    for (int i = 0; i <= doublings; i++, samples *= 2) {
+        path_tracer->set_image(i ? current : previous);
+        path_tracer->set_samples_per_pixel(samples);
+
+        if (!path_tracer->initialize())
+            return 1;
+
+        path_tracer->render();
+
+        if (!i)
+            continue;
+
+        double difference = get_rms_difference(previous, current);
+        double reference_difference = get_rms_difference(reference, current);
+
+        std::cout << samples << " samples per pixel: " << difference << " RMS from " << samples / 2 << ", "
+                  << reference_difference << " RMS from the ray tracer" << std::endl;
+
+        if (i > 1 && difference >= previous_difference) {
+            std::cerr << "ERROR: The path tracer does not converge." << std::endl;
+            return 1;
+        }
+
+        previous_difference = difference;
+        std::swap(previous, current);
+    }
+
+    delete path_tracer;
+    previous.destroy();
+    current.destroy();
+    reference.destroy();
 
     return 0;
 }
+
+/**
+ * Backs the denoiser's error numbers on a half size frame. It path traces a reference and a
+ * noisy image with AOVs, denoises the noisy one and reports the RMSE to the reference before and
+ * after. Fails unless denoising lowers it:
+ * [samples per pixel] [reference samples per pixel]
+ */
+static int compare_denoiser(int argc, char **argv)
+{
+    unsigned int samples = argc > 0 ? (unsigned int) atoi(argv[0]) : 8;
+    unsigned int reference_samples = argc > 1 ? (unsigned int) atoi(argv[1]) : 256;
+
+    if (!samples || reference_samples <= samples) {
+        std::cerr << "Usage: helios --compare-denoiser [samples per pixel] [reference samples per pixel, more than "
+                "the first]" << std::endl;
+        return 1;
+    }
+
+    Image reference, noisy, output;
+
+    if (!reference.create(frame_width / 2, frame_height / 2) || !noisy.create(frame_width / 2, frame_height / 2))
+        return 1;
+
+    Scene *scene = create_scene();
+
+    if (!scene)
+        return 1;
+
+    PathTracer *path_tracer = new PathTracer(scene, reference);
+    path_tracer->set_samples_per_pixel(reference_samples);
+
+    if (!path_tracer->initialize())
+        return 1;
+
+    path_tracer->render();
+
+    path_tracer->set_image(noisy);
+    path_tracer->set_samples_per_pixel(samples);
+
+    for (int i = 0; i < AOV_COUNT; i++) {
+        path_tracer->enable_aov((AovType) i);
+    }
+
+    if (!path_tracer->initialize())
+        return 1;
+
+    path_tracer->render();
+
+    Denoiser denoiser;
+
+    if (!denoiser.denoise(noisy, &path_tracer->get_aov(AOV_NORMAL), &path_tracer->get_aov(AOV_ALBEDO),
+                          &path_tracer->get_aov(AOV_DEPTH), &output))
+        return 1;
+
+    double before = Denoiser::rmse(noisy, reference);
+    double after = Denoiser::rmse(output, reference);
+
+    std::cout << samples << " samples per pixel against " << reference_samples << ": RMSE before " << before
+              << ", after " << after << " (" << denoiser.get_denoise_time() << "ms)" << std::endl;
+
+    delete path_tracer;
+    output.destroy();
+    noisy.destroy();
+    reference.destroy();
+
+    if (after >= before) {
+        std::cerr << "ERROR: Denoising does not lower the error." << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
+
+/**
+ * Number of pixels whose display values, after the default display transform, differ by more
+ * than the tolerance in any channel.
+ */
+static size_t count_display_differences(const Image &a, const Image &b, float tolerance)
+{
+    size_t count = (size_t) a.get_width() * a.get_height() * 3;
+
+    std::vector<float> pixels_a(count), pixels_b(count);
+    a.read_rows(0, a.get_height(), pixels_a.data());
+    b.read_rows(0, b.get_height(), pixels_b.data());
+
+    PostProcess post_process;
+    post_process.apply(pixels_a.data(), pixels_a.data(), count);
+    post_process.apply(pixels_b.data(), pixels_b.data(), count);
+
+    size_t differences = 0;
+
+    for (size_t i = 0; i < count; i += 3) {
+        if (fabs(pixels_a[i] - pixels_b[i]) > tolerance || fabs(pixels_a[i + 1] - pixels_b[i + 1]) > tolerance ||
+            fabs(pixels_a[i + 2] - pixels_b[i + 2]) > tolerance)
+            differences++;
+    }
+
+    return differences;
+}
+
+/**
+ * Progressive render of the frame followed by a series of look-dev edits, each re-rendering only
+ * the pixels it invalidates. The image after edit n is saved with _n appended to the output name.
+ * Fails if a material edit invalidates or changes any pixel whose paths missed the edit, or if
+ * the image after any edit differs by more than 8/255 from a full render of the edited scene:
+ * <samples per pixel> <output>
+ */
+static int render_look_dev(int argc, char **argv)
+{
+    if (argc < 2 || atoi(argv[0]) <= 0) {
+        std::cerr << "Usage: helios --look-dev <samples per pixel> <output>" << std::endl;
+        return 1;
+    }
+
+    Image image;
+
+    if (!image.create(frame_width, frame_height))
+        return 1;
+
+    unsigned int samples = (unsigned int) atoi(argv[0]);
+
+    Scene *scene = create_scene();
+
+    if (!scene)
+        return 1;
+
+    /**
+     * The edits are made to the first drawable with bounds.
+     */
+    uint32_t target = 0;
+    Vec3 min, max;
+
+    while (target < scene->get_drawable_count() && !scene->get_drawable(target)->get_bounds(&min, &max)) {
+        target++;
+    }
+
+    if (target == scene->get_drawable_count()) {
+        std::cerr << "ERROR: The scene has no bounded drawable to edit." << std::endl;
+        delete scene;
+        return 1;
+    }
+
+    RayTracer *renderer = new RayTracer(scene, image);
+    renderer->set_adaptive_sampling(samples, samples, 0.0f);
+    renderer->set_progressive(true);
+
+    if (!renderer->initialize())
+        return 1;
+
+    renderer->render();
+
+    std::cout << "Initial render took " << renderer->get_render_time() << "ms" << std::endl;
+
+    Drawable *drawable = scene->get_drawable(target);
+    Vec3 size = max - min;
+
+    Material edited = scene->get_material(drawable->material);
+    edited.albedo = Vec3(edited.albedo.z, edited.albedo.x, edited.albedo.y);
+
+    Material assigned = edited;
+    assigned.roughness = 0.1f;
+
+    const char *names[] = {"Material edit", "Material assignment", "Move", "Add", "Light"};
+
+    size_t pixel_count = (size_t) frame_width * frame_height;
+
+    for (int edit = 0; edit < 5; edit++) {
+        /**
+         * Material edits must only invalidate the pixels tagged with the edited material or
+         * drawable, the others keep their samples and colors.
+         */
+        bool checked = edit < 2;
+        uint32_t checked_tag = edit == 0 ? PixelTags::get_material_tag(drawable->material)
+                                         : PixelTags::get_object_tag(target);
+
+        std::vector<PixelTags> tags;
+        std::vector<float> before;
+        size_t tagged = 0;
+
+        if (checked) {
+            tags = renderer->get_pixel_tags();
+
+            for (const PixelTags &pixel_tags : tags) {
+                if (pixel_tags.contains(checked_tag))
+                    tagged++;
+            }
+
+            before.resize(pixel_count * 3);
+            image.read_rows(0, frame_height, before.data());
+        }
+
+        switch (edit) {
+            case 0:
+                scene->set_material(drawable->material, edited);
+                break;
+            case 1:
+                scene->set_drawable_material(target, scene->get_material_library().add(assigned));
+                break;
+            case 2:
+                scene->move_drawable(target, drawable->get_position() + Vec3(0.0f, size.y * 0.25f, 0.0f));
+                break;
+            case 3:
+                scene->create_drawable<Sphere>(drawable->get_position() + Vec3(size.x, 0.0f, 0.0f),
+                                               size.x * 0.25f)->material = drawable->material;
+                break;
+            default:
+                if (scene->get_lights_count())
+                    scene->set_light_color(0, scene->get_light(0)->get_color() * 0.5f);
+        }
+
+        high_resolution_clock::time_point start = high_resolution_clock::now();
+
+        SceneChanges changes;
+        BvhUpdate update = scene->commit_changes(&changes);
+        size_t invalidated = renderer->invalidate(changes);
+
+        double update_time = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+
+        renderer->render();
+
+        std::cout << names[edit] << ": BVH " << (update == BVH_REBUILT ? "rebuilt" : "updated") << ", "
+                  << invalidated << " pixels invalidated in " << update_time << "ms, rendered in "
+                  << renderer->get_render_time() << "ms" << std::endl;
+
+        if (checked) {
+            /**
+             * Pixels are compared bitwise, so that NaN pixels compare equal to themselves.
+             */
+            std::vector<float> after(pixel_count * 3);
+            image.read_rows(0, frame_height, after.data());
+
+            size_t changed = 0;
+
+            for (size_t i = 0; i < pixel_count; i++) {
+                if (!tags[i].contains(checked_tag) && memcmp(&before[i * 3], &after[i * 3], 3 * sizeof(float)))
+                    changed++;
+            }
+
+            if (invalidated != tagged || tagged == pixel_count || changed) {
+                std::cerr << "ERROR: " << names[edit] << " invalidated " << invalidated << " pixels, " << tagged
+                          << " are tagged with the edit and " << changed << " untagged ones changed." << std::endl;
+                return 1;
+            }
+        }
+
+        /**
+         * Pixels the edit was missed for keep showing the scene before it.
+         */
+        Image reference;
+
+        if (!reference.create(frame_width, frame_height))
+            return 1;
+
+        RayTracer *reference_renderer = new RayTracer(scene, reference);
+        reference_renderer->set_adaptive_sampling(samples, samples, 0.0f);
+        reference_renderer->set_progressive(true);
+
+        if (!reference_renderer->initialize())
+            return 1;
+
+        reference_renderer->render();
+        reference_renderer->set_scene(nullptr);
+
+        delete reference_renderer;
+
+        size_t stale = count_display_differences(image, reference, 8.0f / 255.0f);
+
+        reference.destroy();
+
+        if (stale) {
+            std::cerr << "ERROR: " << names[edit] << ": " << stale << " pixels differ from a full render of the "
+                      << "edited scene." << std::endl;
+            return 1;
+        }
+
+        std::string output = argv[1];
+        size_t extension = output.find_last_of('.');
+
+        if (extension == std::string::npos || output.find('/', extension) != std::string::npos)
+            extension = output.size();
+
+        if (!image.save(output.substr(0, extension) + "_" + std::to_string(edit) + output.substr(extension)))
+            return 1;
+    }
+
+    delete renderer;
+    image.destroy();
+
+    return 0;
+}
+
+/**
+ * Adaptively sampled render with adaptive lens sampling for thin lens cameras, saving the sample
+ * heatmap next to the output:
+ * <min samples> <max samples> <noise threshold> <samples per blurred pixel> <output>
+ */
+static int render_lens_sampling(int argc, char **argv)
+{
+    if (argc < 5 || atoi(argv[0]) <= 0 || atoi(argv[1]) < atoi(argv[0]) || atof(argv[2]) < 0.0 ||
+        atof(argv[3]) < 0.0) {
+        std::cerr << "Usage: helios --lens-sampling <min samples> <max samples> <noise threshold> "
+                  << "<samples per blurred pixel> <output>" << std::endl;
+        return 1;
+    }
+
+    Image image;
+
+    if (!image.create(frame_width, frame_height, pixel_format))
+        return 1;
+
+    Scene *scene = create_scene();
+
+    if (!scene)
+        return 1;
+
+    if (scene->get_camera().get_type() != Camera::CAM_THIN_LENS || scene->get_camera().get_aperture() <= 0.0f)
+        std::cerr << "WARNING: The camera has no lens, every pixel is sampled the same." << std::endl;
+
+    RayTracer *renderer = new RayTracer(scene, image);
+    renderer->set_adaptive_sampling((unsigned int) atoi(argv[0]), (unsigned int) atoi(argv[1]), (float) atof(argv[2]));
+    renderer->set_lens_sampling((float) atof(argv[3]));
+
+    enable_aovs(renderer);
+
+    if (!renderer->initialize())
+        return 1;
+
+    renderer->render();
+
+    std::cout << (double) renderer->get_total_samples() / ((double) frame_width * frame_height)
+              << " samples per pixel on average" << std::endl;
+
+    std::string output = argv[4];
+    size_t extension = output.find_last_of('.');
+
+    if (extension == std::string::npos || output.find('/', extension) != std::string::npos)
+        extension = output.size();
+
+    bool saved = image.save(output) &&
+                 renderer->save_sample_heatmap(output.substr(0, extension) + "_samples" + output.substr(extension)) &&
+                 save_aovs(renderer);
+
+    delete renderer;
+    image.destroy();
+
+    return saved ? 0 : 1;
+}
+
+/**
+ * Writes the scene given with --scene, or the built in one, to a scene cache: <output>
+ */
+static int build_scene_cache(int argc, char **argv)
+{
+    if (argc < 1) {
+        std::cerr << "Usage: helios [--scene <file>] --build-scene-cache <output>" << std::endl;
+        return 1;
+    }
+
+    Scene *scene = create_scene();
+
+    if (!scene)
+        return 1;
+
+    bool saved = scene->save_cache(argv[0]);
+
+    delete scene;
+
+    return saved ? 0 : 1;
+}
+
+/**
+ * Adds a sphere flake with every sphere allocated with new, as scenes used to be built.
+ */
+static void add_heap_sphere_flake(Scene *scene, const Vec3 &position, float radius, int depth)
+{
+    if (depth <= 0)
+        return;
+
+    scene->add_drawable(new Sphere(position, radius));
+
+    const Vec3 offsets[] = {Vec3(1, 0, 0), Vec3(-1, 0, 0), Vec3(0, 1, 0), Vec3(0, -1, 0), Vec3(0, 0, 1), Vec3(0, 0, -1)};
+
+    for (const Vec3 &offset : offsets) {
+        add_heap_sphere_flake(scene, position + offset * (radius + radius * 0.4f), radius * 0.4f, depth - 1);
+    }
+}
+
+/**
+ * Compares scenes allocating their spheres one by one with new and from the scene's arena:
+ * creating a sphere flake, building the BVH and tracing rays through it, which walk the
+ * spheres, and destroying it: [depth]
+ */
+static int benchmark_allocation(int argc, char **argv)
+{
+    int depth = argc > 0 ? atoi(argv[0]) : 8;
+
+    if (depth <= 0) {
+        std::cerr << "Usage: helios --benchmark-allocation [sphere flake depth]" << std::endl;
+        return 1;
+    }
+
+    const unsigned int ray_count = 1000000;
+
+    for (int arena = 0; arena < 2; arena++) {
+        high_resolution_clock::time_point start = high_resolution_clock::now();
+
+        Scene *scene = new Scene;
+
+        if (arena)
+            Utils::generate_sphere_flake(scene, MaterialLibrary::default_material, Vec3(), 1.0f, 0.4f, depth);
+        else
+            add_heap_sphere_flake(scene, Vec3(), 1.0f, depth);
+
+        high_resolution_clock::time_point created = high_resolution_clock::now();
+
+        scene->build_bvh();
+
+        high_resolution_clock::time_point built = high_resolution_clock::now();
+
+        /**
+         * Rays from a sphere around the flake towards random points near its center.
+         */
+        uint32_t state = 1;
+        auto random = [&state]() {
+            state = state * 1664525u + 1013904223u;
+            return (state >> 8) / 16777216.0f * 2.0f - 1.0f;
+        };
+
+        unsigned long hits = 0;
+
+        for (unsigned int i = 0; i < ray_count; i++) {
+            Vec3 origin = Vec3(random(), random(), random()).normalized() * 4.0f;
+            Vec3 target = Vec3(random(), random(), random()) * 1.5f;
+
+            HitPoint hit_point;
+            hit_point.distance = std::numeric_limits<float>::max();
+
+            hits += scene->intersect(Ray(origin, (target - origin).normalized()), &hit_point);
+        }
+
+        high_resolution_clock::time_point traced = high_resolution_clock::now();
+
+        unsigned long drawable_count = scene->get_drawable_count();
+
+        delete scene;
+
+        high_resolution_clock::time_point end = high_resolution_clock::now();
+
+        std::cout << (arena ? "Arena" : "New/delete") << ": " << drawable_count << " spheres created in "
+                  << duration_cast<microseconds>(created - start).count() / 1000.0 << "ms, "
+                  << ray_count << " rays (" << hits << " hits) traced in "
+                  << duration_cast<microseconds>(traced - built).count() / 1000.0 << "ms, destroyed in "
+                  << duration_cast<microseconds>(end - traced).count() / 1000.0 << "ms" << std::endl;
+    }
+
+    return 0;
+}
+
+/**
+ * Renders the keyframe animation of the scene given with --scene, saving frame n of
+ * <output> as name_n.extension: <frames> <frames per second> <samples per pixel> <output>
+ */
+static int render_animation(int argc, char **argv)
+{
+    if (argc < 4 || atoi(argv[0]) <= 0 || atof(argv[1]) <= 0.0 || atoi(argv[2]) <= 0) {
+        std::cerr << "Usage: helios --scene <file> --animate <frames> <frames per second> <samples per pixel> <output>"
+                  << std::endl;
+        return 1;
+    }
+
+    unsigned int frames = (unsigned int) atoi(argv[0]);
+    double frame_rate = atof(argv[1]);
+    unsigned int samples = (unsigned int) atoi(argv[2]);
+
+    std::string output = argv[3];
+    size_t extension = output.find_last_of('.');
+
+    if (extension == std::string::npos || output.find('/', extension) != std::string::npos)
+        extension = output.size();
+
+    Scene *scene = create_scene();
+
+    if (!scene)
+        return 1;
+
+    if (scene->get_animation().is_empty())
+        std::cerr << "WARNING: The scene has no keyframes, every frame is the same." << std::endl;
+
+    double update_time = 0.0;
+    unsigned int rebuilds = 0;
+
+    for (unsigned int frame = 0; frame < frames; frame++) {
+        high_resolution_clock::time_point start = high_resolution_clock::now();
+
+        BvhUpdate update = scene->set_time((float) (frame / frame_rate));
+
+        double frame_update_time = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+
+        update_time += frame_update_time;
+        rebuilds += update == BVH_REBUILT;
+
+        Image image;
+
+        if (!image.create(frame_width, frame_height, pixel_format))
+            return 1;
+
+        RayTracer *renderer = new RayTracer(scene, image);
+        renderer->set_adaptive_sampling(samples, samples, 0.0f);
+
+        if (!renderer->initialize())
+            return 1;
+
+        renderer->render();
+
+        char number[16];
+        snprintf(number, sizeof(number), "_%04u", frame);
+
+        std::string file_name = output.substr(0, extension) + number + output.substr(extension);
+        bool saved = image.save(file_name);
+
+        std::cout << "Frame " << frame << ": BVH " << (update == BVH_REBUILT ? "rebuilt" : "refitted") << " in "
+                  << frame_update_time << "ms, rendered in " << renderer->get_render_time() << "ms" << std::endl;
+
+        /**
+         * The renderer deletes the scene it renders, detach it so it survives into the next frame.
+         */
+        renderer->set_scene(nullptr);
+        delete renderer;
+        image.destroy();
+
+        if (!saved)
+            return 1;
+    }
+
+    std::cout << "Rendered " << frames << " frames, scene updates took " << update_time / frames
+              << "ms per frame on average, " << rebuilds << " BVH rebuilds" << std::endl;
+
+    delete scene;
+
+    return 0;
+}
+
+/**
+ * Times the procedural stress scene generators, each producing about as many spheres as a
+ * sphere flake of the given depth, and the BVH builds over them: [depth]
+ */
+static int benchmark_generators(int argc, char **argv)
+{
+    int depth = argc > 0 ? atoi(argv[0]) : 8;
+
+    if (depth <= 2) {
+        std::cerr << "Usage: helios --benchmark-generators [sphere flake depth > 2]" << std::endl;
+        return 1;
+    }
+
+    const char *names[] = {"Sphere flake", "Sphere flake grid", "Random spheres"};
+
+    for (int generator = 0; generator < 3; generator++) {
+        Scene scene;
+
+        high_resolution_clock::time_point start = high_resolution_clock::now();
+
+        if (generator == 0) {
+            Utils::generate_sphere_flake(&scene, MaterialLibrary::default_material, Vec3(), 1.0f, 0.4f, depth);
+        }
+        else if (generator == 1) {
+            Utils::generate_sphere_flake_grid(&scene, MaterialLibrary::default_material, Vec3(), 2.0f, 6, 6, 0.5f,
+                                              0.4f, depth - 2);
+        }
+        else {
+            Utils::generate_random_spheres(&scene, MaterialLibrary::default_material, Vec3(-10, -10, -10),
+                                           Vec3(10, 10, 10), 0.001f, 0.02f,
+                                           (unsigned int) Utils::sphere_flake_size(depth), 1);
+        }
+
+        high_resolution_clock::time_point end = high_resolution_clock::now();
+
+        std::cout << names[generator] << ": " << scene.get_drawable_count() << " spheres ("
+                  << scene.get_drawable_count() * sizeof(Sphere) / 1048576.0 << "MB) generated in "
+                  << duration_cast<microseconds>(end - start).count() / 1000.0 << "ms" << std::endl;
+
+        scene.build_bvh();
+    }
+
+    return 0;
+}
+
+/**
+ * Times primary ray generation over a 1920x1080 frame on one thread, transforming every ray by
+ * the camera matrix as the renderer used to, with the precomputed camera basis, and in batches of
+ * 32x32 pixel tiles, then the other projections one at a time and batched: [frames]
+ */
+static int benchmark_camera_rays(int argc, char **argv)
+{
+    int frames = argc > 0 ? atoi(argv[0]) : 10;
+
+    if (frames <= 0) {
+        std::cerr << "Usage: helios --benchmark-camera-rays [frames]" << std::endl;
+        return 1;
+    }
+
+    const unsigned int width = 1920;
+    const unsigned int height = 1080;
+    const unsigned int tile_size = 32;
+
+    Camera camera(Vec3(1.0f, 2.0f, -12.0f));
+    camera.set_target(Vec3(0.0f, 0.5f, 0.0f));
+    camera.set_fov(50.0f, Camera::CAM_FOV_DEGREES);
+
+    CameraRayGenerator generator;
+    generator.set_camera(camera, width, height);
+
+    auto transform_ray = [&](float pixel_x, float pixel_y) {
+        Camera copy = camera;
+
+        Ray ray;
+        ray.direction.x = (2.0f * pixel_x / (float) width - 1.0f) * ((float) width / (float) height);
+        ray.direction.y = 1.0f - 2.0f * pixel_y / (float) height;
+        ray.direction.z = 1.0f / (float) tan(copy.get_fov() / 2.0f);
+        ray.direction.normalize();
+
+        copy.calculate_transformation();
+        ray.transform(copy.get_transformation_matrix());
+
+        return ray;
+    };
+
+    const char *names[] = {"Camera matrix per ray", "Precomputed basis", "Batched tiles"};
+
+    std::vector<Vec3> directions[3];
+    CameraRayBatch batch;
+
+    for (int method = 0; method < 3; method++) {
+        directions[method].resize((size_t) width * height);
+
+        high_resolution_clock::time_point start = high_resolution_clock::now();
+
+        for (int frame = 0; frame < frames; frame++) {
+            if (method == 2) {
+                for (unsigned int y = 0; y < height; y += tile_size) {
+                    for (unsigned int x = 0; x < width; x += tile_size) {
+                        unsigned int tile_width = std::min(tile_size, width - x);
+                        unsigned int tile_height = std::min(tile_size, height - y);
+
+                        generator.generate_tile(x, y, tile_width, tile_height, &batch);
+
+                        for (size_t i = 0; i < batch.count; i++) {
+                            size_t pixel = (size_t) (y + i / tile_width) * width + x + i % tile_width;
+                            directions[method][pixel] = Vec3(batch.x[i], batch.y[i], batch.z[i]);
+                        }
+                    }
+                }
+
+                continue;
+            }
+
+            for (unsigned int y = 0; y < height; y++) {
+                for (unsigned int x = 0; x < width; x++) {
+                    Ray ray = method == 0 ? transform_ray((float) x, (float) y)
+                                          : generator.generate((float) x, (float) y);
+
+                    directions[method][(size_t) y * width + x] = ray.direction;
+                }
+            }
+        }
+
+        double time = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1e6;
+
+        std::cout << names[method] << ": " << (double) width * height * frames / time / 1e6 << "M rays/s" << std::endl;
+    }
+
+    size_t mismatches = 0;
+
+    for (int method = 1; method < 3; method++) {
+        for (size_t i = 0; i < directions[0].size(); i++) {
+            const Vec3 &a = directions[0][i];
+            const Vec3 &b = directions[method][i];
+
+            mismatches += a.x != b.x || a.y != b.y || a.z != b.z;
+        }
+    }
+
+    std::cout << mismatches << " rays differ from the camera matrix ones" << std::endl;
+
+    /**
+     * The other projections, batched against one ray at a time through the lens centre.
+     */
+    const Camera::CameraType types[] = {Camera::CAM_ORTHOGRAPHIC, Camera::CAM_THIN_LENS, Camera::CAM_EQUIRECTANGULAR};
+    const char *type_names[] = {"Orthographic", "Thin lens", "Equirectangular"};
+
+    camera.set_aperture(0.1f);
+    camera.set_focus_distance(12.0f);
+
+    for (int type = 0; type < 3; type++) {
+        camera.set_type(types[type]);
+        generator.set_camera(camera, width, height);
+
+        std::vector<Ray> rays((size_t) width * height);
+        double times[2];
+
+        for (int method = 0; method < 2; method++) {
+            high_resolution_clock::time_point start = high_resolution_clock::now();
+
+            for (int frame = 0; frame < frames; frame++) {
+                for (unsigned int y = 0; y < height; y += tile_size) {
+                    for (unsigned int x = 0; x < width; x += tile_size) {
+                        unsigned int tile_width = std::min(tile_size, width - x);
+                        unsigned int tile_height = std::min(tile_size, height - y);
+
+                        if (method == 1)
+                            generator.generate_tile(x, y, tile_width, tile_height, &batch);
+
+                        for (size_t i = 0; i < (size_t) tile_width * tile_height; i++) {
+                            unsigned int pixel_x = x + (unsigned int) (i % tile_width);
+                            unsigned int pixel_y = y + (unsigned int) (i / tile_width);
+
+                            Ray ray = method == 0 ? generator.generate((float) pixel_x, (float) pixel_y)
+                                                  : batch.get_ray(i);
+
+                            Ray &reference = rays[(size_t) pixel_y * width + pixel_x];
+
+                            if (method == 0) {
+                                reference = ray;
+                            }
+                            else if (frame == 0) {
+                                mismatches += ray.origin.x != reference.origin.x || ray.origin.y != reference.origin.y ||
+                                              ray.origin.z != reference.origin.z ||
+                                              ray.direction.x != reference.direction.x ||
+                                              ray.direction.y != reference.direction.y ||
+                                              ray.direction.z != reference.direction.z;
+                            }
+                        }
+                    }
+                }
+            }
+
+            times[method] = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1e6;
+        }
+
+        std::cout << type_names[type] << ": " << (double) width * height * frames / times[0] / 1e6
+                  << "M rays/s one at a time, " << (double) width * height * frames / times[1] / 1e6
+                  << "M rays/s batched" << std::endl;
+    }
+
+    std::cout << mismatches << " rays differ in total" << std::endl;
+
+    return mismatches ? 1 : 0;
+}
+
+/**
+ * Imports OBJ files and reports the parse throughput: <file.obj>...
+ */
+static int import_obj_files(int argc, char **argv)
+{
+    if (argc < 1) {
+        std::cerr << "Usage: helios --import-obj <file.obj>..." << std::endl;
+        return 1;
+    }
+
+    ObjImporter importer;
+    MaterialLibrary materials;
+
+    for (int i = 0; i < argc; i++) {
+        Mesh mesh;
+
+        if (!importer.load(argv[i], &mesh, &materials))
+            return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    while (argc > 2) {
+        std::string option = argv[1];
+
+        if (option == "--scene")
+            scene_file = argv[2];
+        else if (option == "--aov")
+            aov_prefix = argv[2];
+        else if (option == "--pixel-format") {
+            if (!parse_pixel_format(argv[2], &pixel_format))
+                return 1;
+        }
+        else
+            break;
+
+        argv[2] = argv[0];
+        argc -= 2;
+        argv += 2;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--benchmark-post-process") {
+        PostProcess().benchmark(1920 * 1080);
+        PostProcess(TONE_MAP_ACES, CURVE_SRGB, 0.5f).benchmark(1920 * 1080);
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--benchmark-allocation") {
+        return benchmark_allocation(argc - 2, argv + 2);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--benchmark-generators") {
+        return benchmark_generators(argc - 2, argv + 2);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--benchmark-camera-rays") {
+        return benchmark_camera_rays(argc - 2, argv + 2);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--denoise") {
+        return denoise_files(argc - 2, argv + 2);
+    }
+
+    if (argc > 6 && std::string(argv[1]) == "--region") {
+        return render_region((unsigned int) atoi(argv[2]), (unsigned int) atoi(argv[3]),
+                             (unsigned int) atoi(argv[4]), (unsigned int) atoi(argv[5]), argv[6]);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--stream") {
+        return render_streamed(argc - 2, argv + 2);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--merge") {
+        return merge_files(argc - 2, argv + 2);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--distribute") {
+        return distribute(argc - 2, argv + 2);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--progressive") {
+        return render_progressive(argc - 2, argv + 2);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--budget") {
+        return render_budgeted(argc - 2, argv + 2);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--lens-sampling") {
+        return render_lens_sampling(argc - 2, argv + 2);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--path-trace") {
+        return render_path_traced(argc - 2, argv + 2);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--compare-integrators") {
+        return compare_integrators(argc - 2, argv + 2);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--compare-denoiser") {
+        return compare_denoiser(argc - 2, argv + 2);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--look-dev") {
+        return render_look_dev(argc - 2, argv + 2);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--animate") {
+        return render_animation(argc - 2, argv + 2);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--build-scene-cache") {
+        return build_scene_cache(argc - 2, argv + 2);
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--import-obj") {
+        return import_obj_files(argc - 2, argv + 2);
+    }
+
+    Scene *scene = create_scene();
+
+    if (!scene)
+        return 1;
+
+    Image image;
+    image.create(frame_width, frame_height, pixel_format);
+
+    RayTracer *renderer = new RayTracer(scene, image);
+    enable_aovs(renderer);
+
+    renderer->initialize();
+    renderer->render();
+
+    /**
+     * The writer is picked from the extension, so an .exr name gives a linear OpenEXR file.
+     */
+    std::string output = argc > 1 ? argv[1] : "test.ppm";
+
+    return image.save(output) && save_aovs(renderer) ? 0 : 1;
+}
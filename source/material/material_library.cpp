@@ -0,0 +1,158 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstring>
+#include "material_library.h"
+
+const MaterialHandle MaterialLibrary::default_material;
+const MaterialHandle MaterialLibrary::no_material;
+
+/* Private Functions -------------------------------------------------------- */
+
+size_t MaterialLibrary::MaterialHash::operator()(const Material &material) const
+{
+    const float values[] = {material.albedo.x, material.albedo.y, material.albedo.z, material.roughness,
+                            material.ior};
+    const ShadingModel &model = material.shading_model;
+
+    size_t hash = 14695981039346656037ull;
+
+    auto combine = [&hash](uint32_t value) {
+        hash = (hash ^ value) * 1099511628211ull;
+    };
+
+    for (float value : values) {
+        uint32_t bits;
+        memcpy(&bits, &value, sizeof(bits));
+        combine(bits);
+    }
+
+    combine((uint32_t) material.metallic);
+    combine((uint32_t) model.diffuse_function);
+    combine((uint32_t) model.ndf);
+    combine((uint32_t) model.gsf);
+    combine((uint32_t) model.fresnel);
+
+    return hash;
+}
+
+bool MaterialLibrary::MaterialEqual::operator()(const Material &a, const Material &b) const
+{
+    return a.albedo.x == b.albedo.x && a.albedo.y == b.albedo.y && a.albedo.z == b.albedo.z &&
+           a.roughness == b.roughness && a.ior == b.ior && a.metallic == b.metallic &&
+           a.shading_model.diffuse_function == b.shading_model.diffuse_function &&
+           a.shading_model.ndf == b.shading_model.ndf && a.shading_model.gsf == b.shading_model.gsf &&
+           a.shading_model.fresnel == b.shading_model.fresnel;
+}
+
+/* -------------------------------------------------------------------------- */
+
+MaterialLibrary::MaterialLibrary()
+{
+    clear();
+}
+
+MaterialHandle MaterialLibrary::add(const Material &material)
+{
+    auto found = handles.find(material);
+
+    if (found != handles.end())
+        return found->second;
+
+    if (materials.size() >= no_material) {
+        std::cerr << "ERROR: The material library is full, using the default material!" << std::endl;
+        return default_material;
+    }
+
+    MaterialHandle handle = (MaterialHandle) materials.size();
+
+    materials.push_back(material);
+    unique.push_back(false);
+    handles.emplace(material, handle);
+
+    return handle;
+}
+
+MaterialHandle MaterialLibrary::add_unique(const Material &material)
+{
+    if (materials.size() >= no_material) {
+        std::cerr << "ERROR: The material library is full, using the default material!" << std::endl;
+        return default_material;
+    }
+
+    materials.push_back(material);
+    unique.push_back(true);
+
+    return (MaterialHandle) (materials.size() - 1);
+}
+
+void MaterialLibrary::set(MaterialHandle handle, const Material &material)
+{
+    if (unique[handle]) {
+        materials[handle] = material;
+        return;
+    }
+
+    auto found = handles.find(materials[handle]);
+
+    if (found != handles.end() && found->second == handle)
+        handles.erase(found);
+
+    materials[handle] = material;
+
+    /**
+     * An identical material that is already there keeps its handle, later additions share it.
+     */
+    handles.emplace(material, handle);
+}
+
+void MaterialLibrary::set_materials(const Material *materials, size_t count)
+{
+    this->materials.clear();
+    unique.clear();
+    handles.clear();
+
+    for (size_t i = 0; i < count && i < no_material; i++) {
+        this->materials.push_back(materials[i]);
+        unique.push_back(false);
+        handles.emplace(materials[i], (MaterialHandle) i);
+    }
+
+    if (this->materials.empty())
+        clear();
+}
+
+const std::vector<Material> &MaterialLibrary::get_materials() const
+{
+    return materials;
+}
+
+size_t MaterialLibrary::size() const
+{
+    return materials.size();
+}
+
+void MaterialLibrary::clear()
+{
+    materials.assign(1, Material());
+    unique.assign(1, false);
+
+    handles.clear();
+    handles.emplace(materials[0], default_material);
+}
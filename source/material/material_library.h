@@ -0,0 +1,105 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_MATERIAL_LIBRARY_H
+#define HELIOS_MATERIAL_LIBRARY_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <unordered_map>
+#include "material.h"
+
+/**
+ * Index of a material in a MaterialLibrary.
+ */
+typedef uint16_t MaterialHandle;
+
+/**
+ * The materials of a scene. Drawables and hit points refer to them by handle, identical
+ * materials share one handle unless added with add_unique(), and editing a material changes
+ * it for everything using it. Handle 0 is the default material.
+ */
+class MaterialLibrary {
+private:
+    struct MaterialHash {
+        size_t operator()(const Material &material) const;
+    };
+
+    struct MaterialEqual {
+        bool operator()(const Material &a, const Material &b) const;
+    };
+
+    std::vector<Material> materials;
+
+    std::unordered_map<Material, MaterialHandle, MaterialHash, MaterialEqual> handles;
+
+    /**
+     * Whether the material with the handle as index was added with add_unique(), which keeps
+     * it out of the handles shared by identical materials.
+     */
+    std::vector<bool> unique;
+
+public:
+    static const MaterialHandle default_material = 0;
+
+    /**
+     * Handle of no material, used by hit points that didn't hit anything.
+     */
+    static const MaterialHandle no_material = 0xffff;
+
+    MaterialLibrary();
+
+    /**
+     * Returns the handle of an identical material if there is one, otherwise adds the material.
+     * The default material is returned once the library is full.
+     */
+    MaterialHandle add(const Material &material);
+
+    /**
+     * Adds the material with a handle of its own, even if an identical one exists, for named
+     * materials that are edited independently of each other.
+     */
+    MaterialHandle add_unique(const Material &material);
+
+    const Material &get(MaterialHandle handle) const
+    {
+        return materials[handle];
+    }
+
+    /**
+     * Replaces the material for all its users.
+     */
+    void set(MaterialHandle handle, const Material &material);
+
+    /**
+     * Replaces the library with the materials, whose indices become their handles.
+     */
+    void set_materials(const Material *materials, size_t count);
+
+    const std::vector<Material> &get_materials() const;
+
+    size_t size() const;
+
+    /**
+     * Removes all materials but the default one.
+     */
+    void clear();
+};
+
+#endif //HELIOS_MATERIAL_LIBRARY_H
@@ -21,15 +21,29 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <vec3.h>
 #include <mat4.h>
+#include <material_library.h>
 
 class Object;
 
 struct HitPoint {
     Object *object = nullptr;
+
+    /**
+     * Material of the hit surface in the scene's material library, set by the scene's intersection
+     * search. Primitives of a mapped scene cache have no object, so this is what tells hits from
+     * misses.
+     */
+    MaterialHandle material = MaterialLibrary::no_material;
+
     Vec3 position;
     Vec3 normal;
     double distance = 0.0;
 
+    /**
+     * Index of the hit drawable in the scene, set by the renderer's intersection search.
+     */
+    long object_index = -1;
+
 };
 
 class Ray {
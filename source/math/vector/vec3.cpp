@@ -19,12 +19,12 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <math.h>
 #include <mat4.h>
 
-float Vec3::length()
+float Vec3::length() const
 {
     return (float)sqrt(x * x + y * y + z * z);
 }
 
-float Vec3::length_squared()
+float Vec3::length_squared() const
 {
     return x * x + y * y + z * z;
 }
@@ -40,7 +40,7 @@ void Vec3::normalize()
     }
 }
 
-Vec3 Vec3::normalized()
+Vec3 Vec3::normalized() const
 {
     float length = this->length();
 
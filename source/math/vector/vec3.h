@@ -32,13 +32,13 @@ public:
     Vec3(float x, float y, float z) : x(x), y(y), z(z)
     { }
 
-    float length();
+    float length() const;
 
-    float length_squared();
+    float length_squared() const;
 
     void normalize();
 
-    Vec3 normalized();
+    Vec3 normalized() const;
 
     void transform(const Mat4 &matrix);
 };
@@ -173,4 +173,17 @@ inline Vec3 reflect(const Vec3 &vec, const Vec3 &normal)
     return vec - 2 * dot(vec, normal) * normal;
 }
 
+/**
+ * Builds two unit vectors that together with the unit vector n form an orthonormal basis.
+ */
+inline void orthonormal_basis(const Vec3 &n, Vec3 *tangent, Vec3 *bitangent)
+{
+    Vec3 axis = (n.x > 0.9f || n.x < -0.9f) ? Vec3(0.0f, 1.0f, 0.0f) : Vec3(1.0f, 0.0f, 0.0f);
+
+    *tangent = cross(axis, n);
+    tangent->normalize();
+
+    *bitangent = cross(n, *tangent);
+}
+
 #endif //HELIOS_VEC3_H
@@ -0,0 +1,61 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_AOV_H
+#define HELIOS_AOV_H
+
+#include <vec3.h>
+
+/**
+ * Arbitrary output variables: per pixel feature buffers rendered alongside the color.
+ */
+enum AovType {
+    /**
+     * Distance from the camera to the primary hit, 0 where the ray escapes.
+     */
+    AOV_DEPTH,
+
+    /**
+     * World space shading normal at the primary hit.
+     */
+    AOV_NORMAL,
+
+    /**
+     * Material albedo at the primary hit.
+     */
+    AOV_ALBEDO,
+
+    /**
+     * Index of the primary hit's drawable in the scene plus one, 0 for the background.
+     */
+    AOV_OBJECT_ID,
+
+    AOV_COUNT
+};
+
+/**
+ * Primary hit features of one camera sample.
+ */
+struct AovSample {
+    float depth = 0.0f;
+    Vec3 normal;
+    Vec3 albedo;
+    unsigned int object_id = 0;
+};
+
+#endif //HELIOS_AOV_H
@@ -0,0 +1,154 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <string.h>
+#include <unistd.h>
+#include "checkpoint.h"
+
+static const char magic[4] = {'H', 'L', 'C', 'K'};
+static const uint32_t version = 2;
+
+static const unsigned int header_field_count = 13;
+
+static uint32_t float_bits(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    return bits;
+}
+
+static float bits_float(uint32_t bits)
+{
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+
+    return value;
+}
+
+bool Checkpoint::save(const std::string &file_name) const
+{
+    std::string temporary_name = file_name + ".tmp";
+
+    FILE *file = fopen(temporary_name.c_str(), "wb");
+
+    if (!file) {
+        std::cerr << "Could not open file " << temporary_name << " for writing!" << std::endl;
+        return false;
+    }
+
+    const uint32_t header[header_field_count] = {frame_width, frame_height, region_x, region_y, width, height,
+                                                 sampler_type, sampler_seed, completed_passes, min_samples,
+                                                 max_samples, float_bits(adaptive_threshold),
+                                                 float_bits(lens_sample_density)};
+
+    bool written = fwrite(magic, sizeof(magic), 1, file) == 1 &&
+                   fwrite(&version, sizeof(version), 1, file) == 1 &&
+                   fwrite(header, sizeof(header), 1, file) == 1 &&
+                   fwrite(sample_counts.data(), sizeof(unsigned int), sample_counts.size(), file) ==
+                   sample_counts.size() &&
+                   fwrite(accumulation.data(), sizeof(float), accumulation.size(), file) == accumulation.size() &&
+                   fwrite(luminance_moments.data(), sizeof(float), luminance_moments.size(), file) ==
+                   luminance_moments.size();
+
+    /**
+     * The data has to be on disk before the rename makes it the checkpoint, or a crash could
+     * leave a renamed but empty file behind.
+     */
+    written = written && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    written = fclose(file) == 0 && written;
+
+    if (!written || std::rename(temporary_name.c_str(), file_name.c_str()) != 0) {
+        std::cerr << "Failed writing checkpoint " << file_name << "!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool Checkpoint::load(const std::string &file_name)
+{
+    std::ifstream file(file_name, std::ios::binary | std::ios::in);
+
+    if (!file.is_open()) {
+        std::cerr << "Could not open file " << file_name << " for reading!" << std::endl;
+        return false;
+    }
+
+    char file_magic[4];
+    uint32_t file_version;
+    uint32_t header[header_field_count];
+
+    file.read(file_magic, sizeof(file_magic));
+    file.read((char *) &file_version, sizeof(file_version));
+    file.read((char *) header, sizeof(header));
+
+    if (!file || memcmp(file_magic, magic, sizeof(magic)) != 0 || file_version != version) {
+        std::cerr << "ERROR: " << file_name << " is not a valid checkpoint!" << std::endl;
+        return false;
+    }
+
+    frame_width = header[0];
+    frame_height = header[1];
+    region_x = header[2];
+    region_y = header[3];
+    width = header[4];
+    height = header[5];
+    sampler_type = header[6];
+    sampler_seed = header[7];
+    completed_passes = header[8];
+    min_samples = header[9];
+    max_samples = header[10];
+    adaptive_threshold = bits_float(header[11]);
+    lens_sample_density = bits_float(header[12]);
+
+    size_t pixel_count = (size_t) width * height;
+
+    /**
+     * The header has to match the file size before the buffers are sized from it, so a corrupt
+     * header can't ask for a huge allocation.
+     */
+    std::streamoff header_size = file.tellg();
+
+    file.seekg(0, std::ios::end);
+    std::streamoff payload_size = file.tellg() - header_size;
+    file.seekg(header_size);
+
+    if (!file || (uint64_t) payload_size != (uint64_t) pixel_count * (sizeof(unsigned int) + 5 * sizeof(float))) {
+        std::cerr << "ERROR: Checkpoint " << file_name << " is truncated or corrupt!" << std::endl;
+        return false;
+    }
+
+    sample_counts.resize(pixel_count);
+    accumulation.resize(pixel_count * 3);
+    luminance_moments.resize(pixel_count * 2);
+
+    file.read((char *) sample_counts.data(), sample_counts.size() * sizeof(unsigned int));
+    file.read((char *) accumulation.data(), accumulation.size() * sizeof(float));
+    file.read((char *) luminance_moments.data(), luminance_moments.size() * sizeof(float));
+
+    if (!file) {
+        std::cerr << "ERROR: Checkpoint " << file_name << " is truncated!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,78 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_CHECKPOINT_H
+#define HELIOS_CHECKPOINT_H
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+/**
+ * Snapshot of a progressive render, enough to continue it later.
+ *
+ * Samplers are counter based, so their state is the type, seed and every pixel's sample count.
+ * The file is a small header followed by the raw per pixel arrays in native byte order.
+ */
+struct Checkpoint {
+    uint32_t frame_width = 0;
+    uint32_t frame_height = 0;
+
+    uint32_t region_x = 0;
+    uint32_t region_y = 0;
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    uint32_t sampler_type = 0;
+    uint32_t sampler_seed = 0;
+
+    uint32_t completed_passes = 0;
+
+    /**
+     * Sampling settings, which decide how many samples every pixel ends up with.
+     */
+    uint32_t min_samples = 0;
+    uint32_t max_samples = 0;
+
+    float adaptive_threshold = 0.0f;
+
+    float lens_sample_density = 0.0f;
+
+    std::vector<unsigned int> sample_counts;
+
+    /**
+     * Sum of every pixel's RGB samples.
+     */
+    std::vector<float> accumulation;
+
+    /**
+     * Running mean and sum of squared differences of every pixel's tone mapped luminance.
+     */
+    std::vector<float> luminance_moments;
+
+    /**
+     * Writes to a temporary file which is synced to disk and then renamed, so neither an
+     * interrupted write nor a crash replaces an older valid checkpoint.
+     */
+    bool save(const std::string &file_name) const;
+
+    bool load(const std::string &file_name);
+};
+
+#endif //HELIOS_CHECKPOINT_H
@@ -0,0 +1,182 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <limits>
+#include <algorithm>
+#include <drawable.h>
+#include "path_tracer.h"
+
+void PathTracer::set_samples_per_pixel(unsigned int samples_per_pixel)
+{
+    set_adaptive_sampling(samples_per_pixel, samples_per_pixel, adaptive_threshold);
+}
+
+unsigned int PathTracer::get_samples_per_pixel() const
+{
+    return max_samples;
+}
+
+void PathTracer::set_max_depth(int max_depth)
+{
+    this->max_depth = max_depth;
+}
+
+int PathTracer::get_max_depth() const
+{
+    return max_depth;
+}
+
+void PathTracer::render()
+{
+    RayTracer::render();
+
+    double samples = (double) get_total_samples();
+
+    std::cout << "Path tracing: " << samples / ((double) image.get_width() * image.get_height())
+              << " samples per pixel on average, " << samples / (render_time / 1000.0) << " samples/s" << std::endl;
+}
+
+Vec3 PathTracer::shade(const Ray &ray, HitPoint &hit_point, Sampler &sampler, int iterations)
+{
+    Vec3 color;
+
+    const Material &material = scene->get_material(hit_point.material);
+
+    Vec3 view_direction = -ray.direction;
+    view_direction.normalize();
+
+    auto &lights = scene->get_lights();
+
+    /**
+     * Next event estimation. Area lights are sampled with their own light/B.R.D.F. MIS estimator,
+     * point lights deliver their color as irradiance at normal incidence.
+     */
+    for (unsigned int light_idx = 0; light_idx < lights.size(); light_idx++) {
+        Light *light = lights[light_idx];
+
+        if (light->is_area_light()) {
+            color = color + sample_area_light(light, light_idx, hit_point, view_direction, material, sampler);
+            continue;
+        }
+
+        Vec3 to_light = light->get_position() - hit_point.position;
+        Vec3 light_direction = to_light.normalized();
+
+        float n_dot_l = dot(hit_point.normal, light_direction);
+
+        if (n_dot_l <= 0.0f || is_occluded(Ray(hit_point.position, to_light), light_idx))
+            continue;
+
+        color = color + light->get_color() * shader.evaluate_brdf(light_direction, view_direction, hit_point, material) *
+                        n_dot_l;
+    }
+
+    return color;
+}
+
+Vec3 PathTracer::find_light_emission(const Ray &ray, double max_distance) const
+{
+    Vec3 emission;
+
+    for (auto light : scene->get_lights()) {
+        float distance;
+
+        if (light->intersect(ray, &distance) && distance < max_distance) {
+            max_distance = distance;
+            emission = light->get_color();
+        }
+    }
+
+    return emission;
+}
+
+Vec3 PathTracer::trace_ray(const Ray &primary_ray, Sampler &sampler, int iterations, AovSample *aov)
+{
+    Vec3 radiance;
+    Vec3 throughput(1.0f, 1.0f, 1.0f);
+
+    Ray ray = primary_ray;
+    ray.direction.normalize();
+
+    for (int depth = iterations; depth < max_depth; depth++) {
+        HitPoint hit_point;
+        hit_point.distance = std::numeric_limits<float>::max();
+
+        find_intersection(ray, hit_point, depth == 0);
+
+        if (depth == iterations) {
+            record_aov(ray, hit_point, aov);
+        }
+
+        /**
+         * Light reaching the following vertices is accounted for by next event estimation,
+         * so emission is only picked up by rays leaving the camera.
+         */
+        if (depth == 0) {
+            radiance = radiance + find_light_emission(ray, hit_point.distance);
+        }
+
+        if (hit_point.material == MaterialLibrary::no_material)
+            break;
+
+        const Material &material = scene->get_material(hit_point.material);
+
+        Vec3 view_direction = -ray.direction;
+
+        radiance = radiance + throughput * shade(ray, hit_point, sampler, depth);
+
+        /**
+         * Continue the path in a direction importance sampled from the B.R.D.F.
+         */
+        Vec3 in_dir;
+        float pdf;
+        float u, v;
+
+        sampler.get_2d(&u, &v);
+
+        if (!shader.sample_brdf(view_direction, hit_point.normal, material, u, v, &in_dir, &pdf))
+            break;
+
+        Vec3 brdf = shader.evaluate_brdf(in_dir, view_direction, hit_point, material);
+
+        throughput = throughput * brdf * (dot(hit_point.normal, in_dir) / pdf);
+
+        ray = Ray(hit_point.position, in_dir);
+        ray.energy = std::max(throughput.x, std::max(throughput.y, throughput.z));
+
+        if (ray.energy <= 0.0)
+            break;
+
+        /**
+         * Russian roulette. Paths carrying little energy are terminated with a matching probability
+         * and the survivors are boosted so the estimate stays unbiased.
+         */
+        if (depth + 1 >= russian_roulette_depth) {
+            float survival = (float) std::min(1.0, ray.energy);
+
+            if (sampler.get_1d() >= survival)
+                break;
+
+            throughput = throughput / survival;
+            ray.energy /= survival;
+        }
+    }
+
+    return radiance;
+}
@@ -0,0 +1,76 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_PATH_TRACER_H
+#define HELIOS_PATH_TRACER_H
+
+#include "ray_tracer.h"
+
+/**
+ * Unidirectional Monte Carlo path tracer.
+ *
+ * Bounces are importance sampled from the B.R.D.F. (cosine weighted diffuse, GGX specular) and
+ * direct lighting is computed at every vertex with next event estimation. Paths are terminated
+ * with Russian roulette driven by the ray energy, which carries the path throughput.
+ *
+ * The scene, shader, thread pool and render jobs are shared with the RayTracer.
+ */
+class PathTracer : public RayTracer {
+protected:
+    int max_depth = 16;
+
+    /**
+     * Russian roulette is only applied after this many bounces.
+     */
+    int russian_roulette_depth = 3;
+
+    Vec3 shade(const Ray &ray, HitPoint &hit_point, Sampler &sampler, int iterations);
+
+    Vec3 trace_ray(const Ray &ray, Sampler &sampler, int iterations = 0, AovSample *aov = nullptr);
+
+    /**
+     * Emitted radiance of the nearest area light the ray hits before the given distance.
+     */
+    Vec3 find_light_emission(const Ray &ray, double max_distance) const;
+
+public:
+    PathTracer()
+    {
+        set_samples_per_pixel(16);
+    }
+
+    PathTracer(const Scene *scene, const Image &image) : RayTracer(scene, image)
+    {
+        set_samples_per_pixel(16);
+    }
+
+    /**
+     * Uniform sampling with the given sample count. Use set_adaptive_sampling() to sample adaptively.
+     */
+    void set_samples_per_pixel(unsigned int samples_per_pixel);
+
+    unsigned int get_samples_per_pixel() const;
+
+    void set_max_depth(int max_depth);
+
+    int get_max_depth() const;
+
+    void render();
+};
+
+#endif //HELIOS_PATH_TRACER_H
@@ -0,0 +1,174 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_PIXEL_TAGS_H
+#define HELIOS_PIXEL_TAGS_H
+
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+
+/**
+ * The objects and materials the paths of one pixel hit, as a sorted list of tags. A tag is an
+ * object index, or a material handle with material_flag set. Edits look their own tags up, so
+ * unlike a bit mask no two objects or materials are ever confused.
+ *
+ * A pixel takes 32 bytes. Once its paths hit more than capacity distinct objects and materials
+ * the same words hold a 224 bit Bloom filter with two bits per tag instead, which keeps
+ * recording everything but may also match tags that were never added: about 3% of them at 20
+ * tags and 13% at 50. Such false matches only invalidate a pixel needlessly, never too little.
+ */
+struct PixelTags {
+    static const unsigned int capacity = 7;
+
+    static const unsigned int filter_bits = capacity * 32;
+
+    static const uint32_t material_flag = 1u << 31;
+
+    /**
+     * Value of count once words hold a Bloom filter rather than a list.
+     */
+    static const uint32_t filtered = ~0u;
+
+    uint32_t words[capacity];
+
+    uint32_t count = 0;
+
+    static uint32_t get_object_tag(uint32_t object_index)
+    {
+        return object_index & ~material_flag;
+    }
+
+    static uint32_t get_material_tag(uint32_t material)
+    {
+        return material | material_flag;
+    }
+
+    /**
+     * Tags matching every tag, for pixels whose history is unknown.
+     */
+    static PixelTags everything()
+    {
+        PixelTags all;
+        all.count = filtered;
+        std::fill(all.words, all.words + capacity, ~0u);
+
+        return all;
+    }
+
+    bool is_filtered() const
+    {
+        return count == filtered;
+    }
+
+    void add(uint32_t tag)
+    {
+        if (is_filtered()) {
+            add_to_filter(tag);
+            return;
+        }
+
+        uint32_t *end = words + count;
+        uint32_t *position = std::lower_bound(words, end, tag);
+
+        if (position != end && *position == tag)
+            return;
+
+        if (count < capacity) {
+            std::copy_backward(position, end, end + 1);
+            *position = tag;
+            count++;
+            return;
+        }
+
+        uint32_t listed[capacity];
+        std::copy(words, end, listed);
+
+        count = filtered;
+        std::fill(words, words + capacity, 0u);
+
+        for (uint32_t listed_tag : listed) {
+            add_to_filter(listed_tag);
+        }
+
+        add_to_filter(tag);
+    }
+
+    bool contains(uint32_t tag) const
+    {
+        if (!is_filtered())
+            return std::binary_search(words, words + count, tag);
+
+        unsigned int a, b;
+        get_filter_bits(tag, &a, &b);
+
+        return (words[a / 32] >> (a % 32) & 1) && (words[b / 32] >> (b % 32) & 1);
+    }
+
+    /**
+     * Whether any of the sorted tags is in the list.
+     */
+    bool contains_any(const std::vector<uint32_t> &sorted) const
+    {
+        if (is_filtered())
+            return std::any_of(sorted.begin(), sorted.end(), [this](uint32_t tag) { return contains(tag); });
+
+        const uint32_t *a = words, *a_end = words + count;
+        std::vector<uint32_t>::const_iterator b = sorted.begin();
+
+        while (a != a_end && b != sorted.end()) {
+            if (*a == *b)
+                return true;
+
+            if (*a < *b)
+                a++;
+            else
+                b++;
+        }
+
+        return false;
+    }
+
+private:
+    /**
+     * Two filter bits from a hash of the tag, so neighbouring indices spread over the filter.
+     */
+    static void get_filter_bits(uint32_t tag, unsigned int *a, unsigned int *b)
+    {
+        uint32_t hash = tag;
+        hash ^= hash >> 16;
+        hash *= 0x85ebca6bu;
+        hash ^= hash >> 13;
+        hash *= 0xc2b2ae35u;
+        hash ^= hash >> 16;
+
+        *a = (hash & 0xffffu) % filter_bits;
+        *b = (hash >> 16) % filter_bits;
+    }
+
+    void add_to_filter(uint32_t tag)
+    {
+        unsigned int a, b;
+        get_filter_bits(tag, &a, &b);
+
+        words[a / 32] |= 1u << (a % 32);
+        words[b / 32] |= 1u << (b % 32);
+    }
+};
+
+#endif //HELIOS_PIXEL_TAGS_H
@@ -27,27 +27,151 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <drawable.h>
 #include <limits>
 #include <chrono>
+#include <algorithm>
 #include <assert.h>
 #include "ray_tracer.h"
 
 using namespace std::chrono;
 
+/* Static functions */
+
+static ShadowCache &get_thread_shadow_cache()
+{
+    static thread_local ShadowCache shadow_cache;
+
+    return shadow_cache;
+}
+
+/**
+ * Objects and materials hit by the paths of the pixel the thread is rendering, see pixel_tags.
+ */
+static thread_local PixelTags path_tags;
+
+/**
+ * Bounds of the secondary and shadow ray segments of the pixel the thread is rendering, see
+ * pixel_ray_bounds.
+ */
+static thread_local Aabb path_ray_bounds;
+
+/**
+ * Far end of a ray that escapes the scene for the bounds of its segment. The ray stays within
+ * the octant its direction points into from its origin.
+ */
+static Vec3 get_escape_point(const Ray &ray)
+{
+    return Vec3(ray.direction.x > 0.0f ? INFINITY : ray.direction.x < 0.0f ? -INFINITY : ray.origin.x,
+                ray.direction.y > 0.0f ? INFINITY : ray.direction.y < 0.0f ? -INFINITY : ray.origin.y,
+                ray.direction.z > 0.0f ? INFINITY : ray.direction.z < 0.0f ? -INFINITY : ray.origin.z);
+}
+
+static bool overlaps(const Aabb &a, const Aabb &b)
+{
+    return a.min.x <= b.max.x && b.min.x <= a.max.x && a.min.y <= b.max.y && b.min.y <= a.max.y &&
+           a.min.z <= b.max.z && b.min.z <= a.max.z;
+}
+
+/**
+ * Adds the n-th sample (counting from 1) to the running mean and sum of squared differences
+ * (Welford) of the tone mapped sample luminance.
+ */
+static inline void add_luminance_sample(const Vec3 &sample, unsigned int n, float *mean, float *m2)
+{
+    float luminance = 0.2126f * sample.x + 0.7152f * sample.y + 0.0722f * sample.z;
+    luminance = luminance / (luminance + 1.0f);
+
+    float delta = luminance - *mean;
+    *mean += delta / n;
+    *m2 += delta * (luminance - *mean);
+}
+
+/* ------------------------------------------------------------------*/
+
 RayTracer::~RayTracer()
 {
+    if (checkpoint_writer.joinable())
+        checkpoint_writer.join();
+
     delete scene;
+
+    for (Image &aov_image : aov_images) {
+        aov_image.destroy();
+    }
 }
 
 bool RayTracer::initialize()
 {
-    float *pixels = image.get_pixels();
+    if (output_stream && (output_stream->get_width() != image.get_width() ||
+                          output_stream->get_height() != image.get_height())) {
+        std::cerr << "RayTracer ERROR: Output stream and image sizes differ." << std::endl;
+        return false;
+    }
 
-    unsigned int image_width = image.get_width();
+    if (!scene) {
+        std::cerr << "RayTracer ERROR: Scene pointer is null." << std::endl;
+        return false;
+    }
+
+    if (!scene->is_bvh_valid()) {
+        std::cerr << "RayTracer ERROR: The scene's BVH is out of date, call Scene::build_bvh() after changing it."
+                  << std::endl;
+        return false;
+    }
+
+    if (!region_enabled) {
+        frame_width = image.get_width();
+        frame_height = image.get_height();
+        region_x = region_y = 0;
+    }
+    else if (region_x + image.get_width() > frame_width || region_y + image.get_height() > frame_height) {
+        std::cerr << "RayTracer ERROR: Render region exceeds the frame." << std::endl;
+        return false;
+    }
+
+    size_t pixel_count = (size_t) image.get_width() * image.get_height();
+
+    if (progressive) {
+        if (output_stream) {
+            std::cerr << "RayTracer ERROR: Progressive rendering needs an in-memory image." << std::endl;
+            return false;
+        }
+
+        sample_counts.assign(pixel_count, 0);
+        accumulation.assign(pixel_count * 3, 0.0f);
+        luminance_moments.assign(pixel_count * 2, 0.0f);
+        pixel_tags.assign(pixel_count, PixelTags());
+        pixel_ray_bounds.assign(pixel_count, Aabb());
+
+        completed_passes = 0;
+    }
+    /**
+     * Per pixel sample counts are not kept when streaming so memory stays independent of the image size.
+     */
+    else if (max_samples > 1 && !output_stream) {
+        sample_counts.assign(pixel_count, 0);
+    }
+    else {
+        sample_counts.clear();
+    }
+
+    for (int i = 0; i < AOV_COUNT; i++) {
+        if (!aov_enabled[i])
+            continue;
+
+        if (!aov_images[i].create(image.get_width(), image.get_height())) {
+            std::cerr << "RayTracer ERROR: Could not allocate the AOV buffers." << std::endl;
+            return false;
+        }
+
+        aov_images[i].set_post_process(PostProcess::identity());
+    }
 
     std::cout << "Creating render jobs..." << std::endl;
 
+    render_jobs.clear();
+
     for (unsigned int x = 0; x < image.get_height(); x++) {
-        this->render_jobs.push_back([this, x, image_width, pixels] {
-            render_scan_line(x, image_width, pixels);
+        this->render_jobs.push_back([this, x] {
+            render_scan_line(x);
         });
     }
 
@@ -61,6 +185,11 @@ void RayTracer::set_image(const Image &image)
     this->image = image;
 }
 
+void RayTracer::set_output_stream(ImageStream *stream)
+{
+    output_stream = stream;
+}
+
 void RayTracer::set_scene(const Scene *scene)
 {
     this->scene = scene;
@@ -73,57 +202,143 @@ void RayTracer::render()
         exit(1);
     }
 
+    ThreadPool &thread_pool = ThreadPool::get_shared();
     thread_pool.initialize();
 
+    camera_rays.set_camera(scene->get_camera(), frame_width, frame_height);
+
+    total_samples = 0;
+
     high_resolution_clock::time_point start = high_resolution_clock::now();
 
     std::cout << "Adding render jobs..." << std::endl;
 
-    thread_pool.add_jobs(render_jobs);
-
     std::cout << "Jobs added, rendering starts..." << std::endl;
 
-    thread_pool.wait();
+    if (progressive) {
+        render_progressive();
+    }
+    else {
+        thread_pool.add_jobs(render_jobs);
+        thread_pool.wait();
+    }
 
     high_resolution_clock::time_point end = high_resolution_clock::now();
 
-    auto duration = duration_cast<microseconds>(end - start).count() / 1000.0;
+    render_time = duration_cast<microseconds>(end - start).count() / 1000.0;
+
+    std::cout << "Rendering completed in " << render_time << "ms" << std::endl;
+
+    ShadowCacheStatistics shadow_stats = get_shadow_cache_statistics();
+
+    std::cout << "Shadow cache hit rate: " << shadow_stats.hit_rate() * 100.0f << "% ("
+              << shadow_stats.hits << " / " << shadow_stats.lookups << " lookups)" << std::endl;
+}
+
+double RayTracer::get_render_time() const
+{
+    return render_time;
+}
+
+void RayTracer::set_adaptive_sampling(unsigned int min_samples, unsigned int max_samples, float threshold)
+{
+    this->min_samples = min_samples ? min_samples : 1;
+    this->max_samples = max_samples < this->min_samples ? this->min_samples : max_samples;
+    this->adaptive_threshold = threshold;
+}
+
+void RayTracer::set_lens_sampling(float samples_per_pixel)
+{
+    lens_sample_density = samples_per_pixel;
+}
 
-    std::cout << "Rendering completed in " << duration << "ms" << std::endl;
+unsigned long RayTracer::get_total_samples() const
+{
+    return total_samples;
+}
 
+void RayTracer::set_sampler(SamplerType type, unsigned int seed)
+{
+    sampler_type = type;
+    sampler_seed = seed;
 }
 
-Vec3 RayTracer::shade(const Ray &ray, HitPoint &hit_point, int iterations)
+bool RayTracer::save_sample_heatmap(const std::string &file_name) const
+{
+    if (sample_counts.empty()) {
+        std::cerr << "RayTracer ERROR: No sample counts recorded, enable supersampling first." << std::endl;
+        return false;
+    }
+
+    Image heatmap;
+
+    if (!heatmap.create(image.get_width(), image.get_height()))
+        return false;
+
+    /**
+     * The colors are already display values.
+     */
+    heatmap.set_post_process(PostProcess::identity());
+
+    float *pixels = heatmap.get_pixels();
+    float range = (float) (max_samples - min_samples);
+
+    for (unsigned int count : sample_counts) {
+        float t = range > 0.0f ? (float) (count - min_samples) / range : 1.0f;
+
+        /**
+         * Blue -> green -> red ramp.
+         */
+        *pixels++ = std::max(0.0f, 2.0f * t - 1.0f);
+        *pixels++ = 1.0f - (float) fabs(2.0f * t - 1.0f);
+        *pixels++ = std::max(0.0f, 1.0f - 2.0f * t);
+    }
+
+    bool saved = heatmap.save(file_name);
+
+    heatmap.destroy();
+
+    return saved;
+}
+
+ShadowCacheStatistics RayTracer::get_shadow_cache_statistics() const
+{
+    ShadowCacheStatistics statistics;
+    statistics.lookups = shadow_cache_lookups;
+    statistics.hits = shadow_cache_hits;
+
+    return statistics;
+}
+
+Vec3 RayTracer::shade(const Ray &ray, HitPoint &hit_point, Sampler &sampler, int iterations)
 {
     Vec3 color;
 
-    Material material = static_cast<Drawable *>(hit_point.object)->material;
+    const Material &material = scene->get_material(hit_point.material);
 
     Vec3 view_direction = -ray.direction;
     view_direction.normalize();
 
-    auto lights = scene->get_lights();
+    auto &lights = scene->get_lights();
 
-    for (auto light : lights) {
+    for (unsigned int light_idx = 0; light_idx < lights.size(); light_idx++) {
+        Light *light = lights[light_idx];
+
+        if (light->is_area_light()) {
+            color = color + sample_area_light(light, light_idx, hit_point, view_direction, material, sampler);
+            continue;
+        }
 
         /**
          * Create a shadow ray from the object hit point towards the current light in the loop.
+         * The direction is not normalized so the light sits at distance 1 along the ray.
          */
         Ray shadow_ray(hit_point.position, light->get_position() - hit_point.position);
 
-        HitPoint shadow_hit_point;
-        shadow_hit_point.distance = std::numeric_limits<float>::max();
-
-        /**
-         * Check for intersections with other objects.
-         * If an intersection is found then the being shaded is obscured by another object thus it is in shadow.
-         */
-        find_intersection(shadow_ray, shadow_hit_point);
-
         /**
-         * If an object is hit skip lighting calculations.
+         * If an object obscures the light the point being shaded is in shadow, skip lighting calculations.
          */
-        if (shadow_hit_point.object && shadow_hit_point.distance < 1.0)
+        if (is_occluded(shadow_ray, light_idx))
             continue;
 
         Vec3 light_direction = light->get_position() - hit_point.position;
@@ -155,14 +370,91 @@ Vec3 RayTracer::shade(const Ray &ray, HitPoint &hit_point, int iterations)
             Ray reflection_ray = Ray(hit_point.position, refl_dir);
             reflection_ray.energy = ray.energy * reflectivity;
             Vec3 refl_color = material.metallic ? material.albedo * reflectivity : Vec3(1.0, 1.0, 1.0) * reflectivity;
-            color = color + trace_ray(reflection_ray, iterations + 1) * refl_color;
+            color = color + trace_ray(reflection_ray, sampler, iterations + 1) * refl_color;
         }
     }
 
     return color;
 }
 
-Vec3 RayTracer::trace_ray(const Ray &ray, int iterations)
+Vec3 RayTracer::sample_area_light(const Light *light, unsigned int light_index, HitPoint &hit_point,
+                                  const Vec3 &view_direction, const Material &material, Sampler &sampler)
+{
+    Vec3 color;
+
+    unsigned int sample_count = light->get_samples();
+
+    /**
+     * Stratify the samples over a grid that is as square as possible.
+     */
+    unsigned int strata_x = std::max(1u, (unsigned int) sqrt((float) sample_count));
+    unsigned int strata_y = (sample_count + strata_x - 1) / strata_x;
+
+    for (unsigned int i = 0; i < sample_count; i++) {
+        float u, v;
+        sampler.get_2d(&u, &v);
+
+        u = ((float) (i % strata_x) + u) / (float) strata_x;
+        v = ((float) (i / strata_x) + v) / (float) strata_y;
+
+        /**
+         * Light sampling.
+         */
+        Vec3 light_point;
+        float light_pdf;
+        Vec3 radiance = light->sample(hit_point.position, u, v, &light_point, &light_pdf);
+
+        if (light_pdf > 0.0f) {
+            Vec3 to_light = light_point - hit_point.position;
+            Vec3 light_direction = to_light.normalized();
+
+            Vec3 brdf = shader.evaluate_brdf(light_direction, view_direction, hit_point, material);
+            float n_dot_l = dot(hit_point.normal, light_direction);
+
+            if (n_dot_l > 0.0f && !is_occluded(Ray(hit_point.position, to_light), light_index)) {
+                float brdf_pdf = shader.brdf_pdf(light_direction, view_direction, hit_point.normal, material);
+                float weight = power_heuristic(light_pdf, brdf_pdf);
+
+                color = color + radiance * brdf * (n_dot_l * weight / light_pdf);
+            }
+        }
+
+        /**
+         * B.R.D.F. sampling with its own stratified pair, so the two estimates are independent.
+         * Only directions that hit the light contribute.
+         */
+        sampler.get_2d(&u, &v);
+
+        u = ((float) (i % strata_x) + u) / (float) strata_x;
+        v = ((float) (i / strata_x) + v) / (float) strata_y;
+
+        Vec3 in_dir;
+        float brdf_pdf;
+
+        if (!shader.sample_brdf(view_direction, hit_point.normal, material, u, v, &in_dir, &brdf_pdf))
+            continue;
+
+        float light_distance;
+
+        if (!light->intersect(Ray(hit_point.position, in_dir), &light_distance))
+            continue;
+
+        if (is_occluded(Ray(hit_point.position, in_dir * light_distance), light_index))
+            continue;
+
+        light_pdf = light->pdf(hit_point.position, in_dir, light_distance);
+
+        float weight = power_heuristic(brdf_pdf, light_pdf);
+        float n_dot_l = dot(hit_point.normal, in_dir);
+
+        color = color + light->get_color() * shader.evaluate_brdf(in_dir, view_direction, hit_point, material) *
+                        (n_dot_l * weight / brdf_pdf);
+    }
+
+    return color / (float) sample_count;
+}
+
+Vec3 RayTracer::trace_ray(const Ray &ray, Sampler &sampler, int iterations, AovSample *aov)
 {
     if (iterations > max_iterations || ray.energy < energy_threshold) {
         return Vec3(0.0, 0.0, 0.0);
@@ -171,84 +463,809 @@ Vec3 RayTracer::trace_ray(const Ray &ray, int iterations)
     HitPoint nearest;
     nearest.distance = std::numeric_limits<float>::max();
 
-    find_intersection(ray, nearest);
+    find_intersection(ray, nearest, iterations == 0);
+
+    record_aov(ray, nearest, aov);
 
-    if (!nearest.object) {
+    if (nearest.material == MaterialLibrary::no_material) {
         return Vec3(0.0, 0.0, 0.0);
     }
 
-    Vec3 color = shade(ray, nearest, iterations);
+    Vec3 color = shade(ray, nearest, sampler, iterations);
 
     return color;
 }
 
 void RayTracer::find_intersection(const Ray &ray, HitPoint &hit_point)
 {
-    for (unsigned int i = 0; i < scene->get_drawable_count(); i++) {
-        Drawable *obj = scene->get_drawable(i);
+    find_intersection(ray, hit_point, false);
+}
+
+void RayTracer::find_intersection(const Ray &ray, HitPoint &hit_point, bool camera_ray)
+{
+    bool hit = scene->intersect(ray, &hit_point);
+
+    if (hit) {
+        path_tags.add(PixelTags::get_object_tag((uint32_t) hit_point.object_index));
+        path_tags.add(PixelTags::get_material_tag(hit_point.material));
+    }
+
+    if (camera_ray)
+        return;
+
+    path_ray_bounds.extend(ray.origin);
+    path_ray_bounds.extend(hit ? hit_point.position : get_escape_point(ray));
+}
+
+void RayTracer::record_aov(const Ray &ray, const HitPoint &hit_point, AovSample *aov) const
+{
+    if (!aov || hit_point.material == MaterialLibrary::no_material)
+        return;
+
+    /**
+     * Camera rays have normalized directions, so the hit distance is the depth.
+     */
+    aov->depth = (float) hit_point.distance;
+    aov->normal = hit_point.normal;
+    aov->albedo = scene->get_material(hit_point.material).albedo;
+    aov->object_id = (unsigned int) (hit_point.object_index + 1);
+}
+
+long RayTracer::find_occluder(const Ray &ray, double max_distance) const
+{
+    return scene->find_occluder(ray, (float) max_distance);
+}
+
+bool RayTracer::is_occluded(const Ray &shadow_ray, unsigned int light_index) const
+{
+    /**
+     * The light sits at distance 1 along shadow rays.
+     */
+    path_ray_bounds.extend(shadow_ray.origin);
+    path_ray_bounds.extend(shadow_ray.origin + shadow_ray.direction);
+
+    ShadowCache &cache = get_thread_shadow_cache();
+
+    if (cache.scene != scene || cache.occluders.size() != scene->get_lights_count()) {
+        cache.reset(scene, scene->get_lights_count());
+    }
+
+    long cached = cache.occluders[light_index];
+
+    /**
+     * Test the object that blocked the previous shadow ray towards this light first.
+     */
+    if (cached != ShadowCache::no_occluder && (unsigned long) cached < scene->get_primitive_count()) {
+        cache.lookups++;
 
         HitPoint pt;
 
-        if (obj->intersect(ray, &pt) && pt.distance < hit_point.distance) {
-            hit_point = pt;
+        if (scene->intersect_primitive((uint32_t) cached, shadow_ray, &pt) && pt.distance < 1.0) {
+            cache.hits++;
+            path_tags.add(PixelTags::get_object_tag((uint32_t) cached));
+            return true;
         }
     }
+
+    long occluder = find_occluder(shadow_ray, 1.0);
+
+    cache.occluders[light_index] = occluder;
+
+    if (occluder != ShadowCache::no_occluder)
+        path_tags.add(PixelTags::get_object_tag((uint32_t) occluder));
+
+    return occluder != ShadowCache::no_occluder;
+}
+
+void RayTracer::flush_shadow_cache_statistics()
+{
+    ShadowCache &cache = get_thread_shadow_cache();
+
+    shadow_cache_lookups += cache.lookups;
+    shadow_cache_hits += cache.hits;
+
+    cache.lookups = 0;
+    cache.hits = 0;
+}
+
+Ray RayTracer::create_primary_ray(float pixel_x, float pixel_y, float lens_u, float lens_v) const
+{
+    return camera_rays.generate(pixel_x, pixel_y, lens_u, lens_v);
+}
+
+unsigned int RayTracer::get_sample_budget(unsigned int pixel_x, unsigned int pixel_y)
+{
+    if (lens_sample_density <= 0.0f || !camera_rays.has_lens())
+        return max_samples;
+
+    HitPoint hit_point;
+    hit_point.distance = std::numeric_limits<float>::max();
+
+    find_intersection(create_primary_ray(pixel_x + 0.5f, pixel_y + 0.5f), hit_point, true);
+
+    /**
+     * Blurred objects spread into the empty background around them, which counts as infinitely far.
+     */
+    float diameter = hit_point.material == MaterialLibrary::no_material
+                     ? camera_rays.get_background_circle_of_confusion()
+                     : camera_rays.get_circle_of_confusion(hit_point.position);
+
+    float radius = diameter * 0.5f;
+    float samples = ceilf(lens_sample_density * (float) M_PI * radius * radius);
+
+    return samples >= (float) max_samples ? max_samples : std::max(min_samples, (unsigned int) samples);
+}
+
+Vec3 RayTracer::sample_pixel(float pixel_x, float pixel_y, Sampler &sampler, AovSample *aov)
+{
+    float lens_u = 0.5f;
+    float lens_v = 0.5f;
+
+    /**
+     * The lens point follows the pixel jitter in the sample's dimensions.
+     */
+    if (camera_rays.has_lens())
+        sampler.get_2d(&lens_u, &lens_v);
+
+    Ray primary_ray = create_primary_ray(pixel_x, pixel_y, lens_u, lens_v);
+
+    return trace_ray(primary_ray, sampler, 0, aov);
 }
 
-Ray RayTracer::create_primary_ray(int pixel_x, int pixel_y) const
+Vec3 RayTracer::render_pixel(unsigned int pixel_x, unsigned int pixel_y, unsigned int *sample_count,
+                             AovSample *aov, const Ray *primary_ray)
 {
-    int image_width = image.get_width();
-    int image_height = image.get_height();
+    Sampler sampler(sampler_type, sampler_seed);
+    sampler.start_pixel(pixel_x, pixel_y);
+
+    if (max_samples <= 1) {
+        *sample_count = 1;
 
-    float aspect = (float) image_width / (float) image_height;
+        if (primary_ray)
+            return trace_ray(*primary_ray, sampler, 0, aov);
 
-    auto camera = scene->get_camera();
-    float camera_fov = camera.get_fov();
+        return sample_pixel((float) pixel_x, (float) pixel_y, sampler, aov);
+    }
 
-    Ray ray;
+    Vec3 color;
 
     /**
-     * The ray origin is at 0 0 0 so we don't touch it.
+     * Running mean and variance (Welford) of the tone mapped sample luminance.
      */
-    //ray.origin = camera.get_position();
+    float mean = 0.0f;
+    float m2 = 0.0f;
+
+    unsigned int n = 0;
+    unsigned int budget = get_sample_budget(pixel_x, pixel_y);
+
+    while (n < budget) {
+        sampler.start_sample(n);
 
-    ray.direction.x = (2.0f * (float) pixel_x / (float) image_width - 1.0f) * aspect;
-    ray.direction.y = 1.0f - 2.0f * (float) pixel_y / (float) image_height;
-    ray.direction.z = 1.0f / (float) tan(camera_fov / 2.0f);
+        float jitter_x, jitter_y;
+        sampler.get_2d(&jitter_x, &jitter_y);
 
-    ray.direction.normalize();
+        AovSample sample_aov;
 
-    camera.calculate_transformation();
-    ray.transform(camera.get_transformation_matrix());
+        Vec3 sample = sample_pixel(pixel_x + jitter_x, pixel_y + jitter_y, sampler, aov ? &sample_aov : nullptr);
+
+        if (aov) {
+            if (n == 0)
+                aov->object_id = sample_aov.object_id;
+
+            aov->depth += sample_aov.depth;
+            aov->normal = aov->normal + sample_aov.normal;
+            aov->albedo = aov->albedo + sample_aov.albedo;
+        }
 
-    return ray;
+        color = color + sample;
+        n++;
+
+        add_luminance_sample(sample, n, &mean, &m2);
+
+        if (is_converged(n, m2))
+            break;
+    }
+
+    *sample_count = n;
+
+    if (aov) {
+        aov->depth /= n;
+        aov->normal = aov->normal / (float) n;
+        aov->albedo = aov->albedo / (float) n;
+    }
+
+    return color / (float) n;
 }
 
+bool RayTracer::has_aovs() const
+{
+    for (bool enabled : aov_enabled) {
+        if (enabled)
+            return true;
+    }
+
+    return false;
+}
 
-void RayTracer::render_scan_line(unsigned int line_number, unsigned int line_size, float *pixels)
+void RayTracer::write_aov_pixel(unsigned int pixel_x, unsigned int pixel_y, const AovSample &aov)
 {
+    float id = (float) aov.object_id;
+
+    const float values[AOV_COUNT][3] = {
+            {aov.depth, aov.depth, aov.depth},
+            {aov.normal.x, aov.normal.y, aov.normal.z},
+            {aov.albedo.x, aov.albedo.y, aov.albedo.z},
+            {id, id, id}
+    };
+
+    size_t offset = ((size_t) pixel_y * image.get_width() + pixel_x) * 3;
+
+    for (int i = 0; i < AOV_COUNT; i++) {
+        if (!aov_enabled[i])
+            continue;
+
+        float *pixel = aov_images[i].get_pixels() + offset;
+
+        pixel[0] = values[i][0];
+        pixel[1] = values[i][1];
+        pixel[2] = values[i][2];
+    }
+}
+
+bool RayTracer::is_converged(unsigned int n, float m2) const
+{
+    if (n < min_samples || min_samples >= max_samples)
+        return false;
+
+    float standard_error = (float) sqrt(m2 / ((n - 1) * n));
+
+    return standard_error <= adaptive_threshold;
+}
+
+void RayTracer::render_progressive_line(unsigned int line_number, unsigned int pass_samples)
+{
+    unsigned int line_size = image.get_width();
+
+    std::vector<float> line_buffer(line_size * 3);
+    float *pixels = line_buffer.data();
+
+    unsigned long line_samples = 0;
+    unsigned long unfinished = 0;
+
+    bool aovs = has_aovs();
+
+    unsigned int frame_y = region_y + line_number;
+
+    for (unsigned int x = 0; x < line_size; x++) {
+        size_t pixel = (size_t) line_number * line_size + x;
+        unsigned int frame_x = region_x + x;
+
+        float *sum = &accumulation[pixel * 3];
+        float *moments = &luminance_moments[pixel * 2];
+        unsigned int &n = sample_counts[pixel];
+        unsigned int budget = get_sample_budget(frame_x, frame_y);
+
+        Sampler sampler(sampler_type, sampler_seed);
+        sampler.start_pixel(frame_x, frame_y);
+
+        path_tags = pixel_tags[pixel];
+        path_ray_bounds = pixel_ray_bounds[pixel];
+
+        /**
+         * Samples continue the pixel's sequence where the previous pass left it, so the sums
+         * match those of a one-shot render no matter how the samples are split into passes.
+         */
+        for (unsigned int i = 0; i < pass_samples && n < budget && !is_converged(n, moments[1]); i++) {
+            sampler.start_sample(n);
+
+            float jitter_x, jitter_y;
+            sampler.get_2d(&jitter_x, &jitter_y);
+
+            AovSample aov;
+            bool first_sample = aovs && n == 0;
+
+            Vec3 sample = sample_pixel(frame_x + jitter_x, frame_y + jitter_y, sampler, first_sample ? &aov : nullptr);
+
+            if (first_sample) {
+                write_aov_pixel(x, line_number, aov);
+            }
+
+            sum[0] += sample.x;
+            sum[1] += sample.y;
+            sum[2] += sample.z;
+            n++;
+
+            add_luminance_sample(sample, n, &moments[0], &moments[1]);
+
+            line_samples++;
+        }
+
+        pixel_tags[pixel] = path_tags;
+        pixel_ray_bounds[pixel] = path_ray_bounds;
+
+        if (n < budget && !is_converged(n, moments[1]))
+            unfinished++;
+
+        Vec3 color = n ? Vec3(sum[0], sum[1], sum[2]) / (float) n : Vec3();
+
+        *pixels++ = color.x;
+        *pixels++ = color.y;
+        *pixels++ = color.z;
+    }
+
+    image.write_rows(line_number, 1, line_buffer.data());
+
+    total_samples += line_samples;
+    unfinished_pixels += unfinished;
+
+    flush_shadow_cache_statistics();
+}
+
+void RayTracer::render_progressive()
+{
+    ThreadPool &thread_pool = ThreadPool::get_shared();
+
+    high_resolution_clock::time_point last_checkpoint = high_resolution_clock::now();
+
+    deadline = steady_clock::now() + microseconds((long long) (time_budget * 1e6));
+    budget_exhausted = false;
+
     /**
-     * Advance the pointer to the correct line starting point.
+     * Time per sample per pixel measured over the last pass, which the pass sizes under a time
+     * budget are estimated from.
      */
-    pixels += (line_number * line_size * 3);
+    double sample_seconds = 0.0;
 
-    for (unsigned int y = 0; y < line_size; y++) {
+    while (true) {
+        unsigned int pass_samples = std::min(1u << std::min(completed_passes, 31u), max_pass_samples);
+
+        /**
+         * The deadline is only checked between passes, and passes are shrunk to what the rest
+         * of the budget affords, so every pixel gets the same number of samples.
+         */
+        if (time_budget > 0.0 && sample_seconds > 0.0) {
+            double remaining = duration_cast<microseconds>(deadline - steady_clock::now()).count() / 1e6;
+
+            pass_samples = std::min(pass_samples, std::max(1u, (unsigned int) (remaining / sample_seconds)));
+        }
 
-        Ray primary_ray = create_primary_ray(y, line_number);
+        steady_clock::time_point pass_start = steady_clock::now();
 
-        Vec3 color = trace_ray(primary_ray);
+        unfinished_pixels = 0;
 
-        image.tone_map_pixel(&color.x, &color.y, &color.z);
+        std::vector< std::function<void()> > pass_jobs;
+
+        for (unsigned int line = 0; line < image.get_height(); line++) {
+            pass_jobs.push_back([this, line, pass_samples] {
+                render_progressive_line(line, pass_samples);
+            });
+        }
+
+        thread_pool.add_jobs(pass_jobs);
+        thread_pool.wait();
+
+        completed_passes++;
+
+        steady_clock::time_point now = steady_clock::now();
+        sample_seconds = duration_cast<microseconds>(now - pass_start).count() / 1e6 / pass_samples;
 
         /**
-        * Gamma correction
-        */
-        color.x = (float) pow(color.x, 0.45454545f);
-        color.y = (float) pow(color.y, 0.45454545f);
-        color.z = (float) pow(color.z, 0.45454545f);
+         * The budget is used up once it can't afford another sample per pixel.
+         */
+        if (time_budget > 0.0 && now + microseconds((long long) (sample_seconds * 1e6)) > deadline)
+            budget_exhausted = true;
+
+        bool finished = unfinished_pixels == 0 || budget_exhausted;
+
+        std::cout << "Pass " << completed_passes << " done, " << unfinished_pixels << " pixels need more samples"
+                  << std::endl;
+
+        if (budget_exhausted) {
+            std::cout << "Time budget of " << time_budget << "s exhausted" << std::endl;
+        }
+
+        if (!checkpoint_file.empty()) {
+            high_resolution_clock::time_point now = high_resolution_clock::now();
+            double elapsed = duration_cast<milliseconds>(now - last_checkpoint).count() / 1000.0;
+
+            if (finished) {
+                write_checkpoint(true);
+            }
+            else if (elapsed >= checkpoint_interval && write_checkpoint(false)) {
+                last_checkpoint = now;
+            }
+        }
+
+        if (finished)
+            break;
+    }
+
+    if (checkpoint_writer.joinable())
+        checkpoint_writer.join();
+
+    RenderQuality quality = get_render_quality();
+
+    std::cout << "Progressive render: " << quality.average_samples << " samples per pixel on average ("
+              << quality.min_samples << " - " << quality.max_samples << "), estimated noise ";
+
+    if (quality.noise < 0.0)
+        std::cout << "unknown";
+    else
+        std::cout << quality.noise;
+
+    std::cout << std::endl;
+}
+
+bool RayTracer::write_checkpoint(bool wait)
+{
+    if (checkpoint_writing && !wait)
+        return false;
+
+    if (checkpoint_writer.joinable())
+        checkpoint_writer.join();
+
+    Checkpoint *snapshot = new Checkpoint;
+
+    snapshot->frame_width = frame_width;
+    snapshot->frame_height = frame_height;
+    snapshot->region_x = region_x;
+    snapshot->region_y = region_y;
+    snapshot->width = image.get_width();
+    snapshot->height = image.get_height();
+    snapshot->sampler_type = sampler_type;
+    snapshot->sampler_seed = sampler_seed;
+    snapshot->completed_passes = completed_passes;
+    snapshot->min_samples = min_samples;
+    snapshot->max_samples = max_samples;
+    snapshot->adaptive_threshold = adaptive_threshold;
+    snapshot->lens_sample_density = lens_sample_density;
+    snapshot->sample_counts = sample_counts;
+    snapshot->accumulation = accumulation;
+    snapshot->luminance_moments = luminance_moments;
+
+    std::string file_name = checkpoint_file;
+
+    checkpoint_writing = true;
+
+    checkpoint_writer = std::thread([this, snapshot, file_name] {
+        high_resolution_clock::time_point start = high_resolution_clock::now();
+
+        if (snapshot->save(file_name)) {
+            std::cout << "Checkpoint after pass " << snapshot->completed_passes << " written to " << file_name
+                      << " in " << duration_cast<milliseconds>(high_resolution_clock::now() - start).count()
+                      << "ms" << std::endl;
+        }
+
+        delete snapshot;
+
+        checkpoint_writing = false;
+    });
+
+    return true;
+}
+
+void RayTracer::render_scan_line(unsigned int line_number)
+{
+    unsigned int line_size = image.get_width();
+
+    /**
+     * The line is rendered into a local buffer of linear radiance and converted to the output
+     * format once finished. Display transforms are left to the output.
+     */
+    std::vector<float> line_buffer(line_size * 3);
+    float *pixels = line_buffer.data();
+
+    unsigned long line_samples = 0;
+
+    bool aovs = has_aovs();
+
+    /**
+     * Single sample pixels are sampled at their top left corner, so the rays of the whole line
+     * are generated up front unless they need lens samples.
+     */
+    CameraRayBatch rays;
+
+    if (max_samples <= 1 && !camera_rays.has_lens())
+        camera_rays.generate_tile(region_x, region_y + line_number, line_size, 1, &rays);
+
+    for (unsigned int y = 0; y < line_size; y++) {
+
+        unsigned int sample_count;
+
+        AovSample aov;
+
+        Ray primary_ray = rays.count ? rays.get_ray(y) : Ray();
+
+        Vec3 color = render_pixel(region_x + y, region_y + line_number, &sample_count, aovs ? &aov : nullptr,
+                                  rays.count ? &primary_ray : nullptr);
+
+        line_samples += sample_count;
+
+        if (aovs) {
+            write_aov_pixel(y, line_number, aov);
+        }
+
+        if (!sample_counts.empty()) {
+            sample_counts[(size_t) line_number * line_size + y] = sample_count;
+        }
 
         *pixels++ = color.x;
         *pixels++ = color.y;
         *pixels++ = color.z;
     }
+
+    if (output_stream) {
+        output_stream->write_rows(line_number, 1, line_buffer.data());
+    }
+    else {
+        image.write_rows(line_number, 1, line_buffer.data());
+    }
+
+    total_samples += line_samples;
+
+    flush_shadow_cache_statistics();
+}
+
+void RayTracer::enable_aov(AovType type)
+{
+    aov_enabled[type] = true;
+}
+
+const Image &RayTracer::get_aov(AovType type) const
+{
+    return aov_images[type];
+}
+
+bool RayTracer::save_aov(AovType type, const std::string &file_name) const
+{
+    if (!aov_enabled[type] || !aov_images[type].get_pixels()) {
+        std::cerr << "RayTracer ERROR: AOV " << type << " was not rendered." << std::endl;
+        return false;
+    }
+
+    Image aov_image = aov_images[type];
+
+    return aov_image.save(file_name);
+}
+
+void RayTracer::set_render_region(unsigned int frame_width, unsigned int frame_height, unsigned int x, unsigned int y)
+{
+    region_enabled = true;
+
+    this->frame_width = frame_width;
+    this->frame_height = frame_height;
+
+    region_x = x;
+    region_y = y;
+}
+
+void RayTracer::clear_render_region()
+{
+    region_enabled = false;
+}
+
+void RayTracer::set_progressive(bool enabled, unsigned int max_pass_samples)
+{
+    progressive = enabled;
+    this->max_pass_samples = max_pass_samples ? max_pass_samples : 1;
+}
+
+void RayTracer::set_checkpoint(const std::string &file_name, double interval_seconds)
+{
+    checkpoint_file = file_name;
+    checkpoint_interval = interval_seconds;
+}
+
+bool RayTracer::resume(const std::string &file_name)
+{
+    if (!progressive || accumulation.empty()) {
+        std::cerr << "RayTracer ERROR: Only initialized progressive renders can be resumed." << std::endl;
+        return false;
+    }
+
+    Checkpoint checkpoint;
+
+    if (!checkpoint.load(file_name))
+        return false;
+
+    if (checkpoint.frame_width != frame_width || checkpoint.frame_height != frame_height ||
+        checkpoint.region_x != region_x || checkpoint.region_y != region_y ||
+        checkpoint.width != image.get_width() || checkpoint.height != image.get_height() ||
+        checkpoint.sampler_type != (uint32_t) sampler_type || checkpoint.sampler_seed != sampler_seed ||
+        checkpoint.min_samples != min_samples || checkpoint.max_samples != max_samples ||
+        checkpoint.adaptive_threshold != adaptive_threshold ||
+        checkpoint.lens_sample_density != lens_sample_density) {
+        std::cerr << "RayTracer ERROR: Checkpoint " << file_name << " belongs to a different render." << std::endl;
+        return false;
+    }
+
+    sample_counts.swap(checkpoint.sample_counts);
+    accumulation.swap(checkpoint.accumulation);
+    luminance_moments.swap(checkpoint.luminance_moments);
+
+    /**
+     * What the checkpointed paths hit and where their rays went is unknown, any edit
+     * invalidates them.
+     */
+    pixel_tags.assign(sample_counts.size(), PixelTags::everything());
+    pixel_ray_bounds.assign(sample_counts.size(), Aabb(Vec3(-INFINITY, -INFINITY, -INFINITY),
+                                                       Vec3(INFINITY, INFINITY, INFINITY)));
+
+    completed_passes = checkpoint.completed_passes;
+
+    std::cout << "Resuming from " << file_name << " after pass " << completed_passes << std::endl;
+
+    return true;
+}
+
+size_t RayTracer::invalidate(const SceneChanges &changes)
+{
+    size_t pixel_count = (size_t) image.get_width() * image.get_height();
+
+    /**
+     * Without progressive state every render() starts over.
+     */
+    if (!progressive || accumulation.empty())
+        return pixel_count;
+
+    if (!changes.types)
+        return 0;
+
+    /**
+     * Light edits can change the shading and shadows of any pixel.
+     */
+    bool all = (changes.types & SCENE_LIGHT_CHANGED) != 0 ||
+               changes.moved_from.size() != changes.moved_drawables.size();
+
+    std::vector<uint32_t> tags;
+
+    for (uint32_t index : changes.material_drawables) {
+        tags.push_back(PixelTags::get_object_tag(index));
+    }
+
+    for (MaterialHandle material : changes.materials) {
+        tags.push_back(PixelTags::get_material_tag(material));
+    }
+
+    /**
+     * Moved and added drawables affect the pixels whose paths hit or were shadowed by them, the
+     * pixels their bounds cover on screen and the pixels whose secondary or shadow rays pass
+     * through their bounds, before and after the edit.
+     */
+    std::vector<Aabb> bounds;
+
+    const std::vector<Drawable *> &drawables = scene->get_drawables();
+
+    for (size_t i = 0; i < changes.moved_drawables.size(); i++) {
+        bounds.push_back(changes.moved_from[i]);
+        bounds.push_back(Aabb());
+
+        drawables[changes.moved_drawables[i]]->get_bounds(&bounds.back().min, &bounds.back().max);
+        tags.push_back(PixelTags::get_object_tag(changes.moved_drawables[i]));
+    }
+
+    if (changes.types & SCENE_OBJECT_ADDED) {
+        for (size_t i = changes.first_added_drawable; i < drawables.size(); i++) {
+            bounds.push_back(Aabb());
+
+            drawables[i]->get_bounds(&bounds.back().min, &bounds.back().max);
+            tags.push_back(PixelTags::get_object_tag((uint32_t) i));
+        }
+    }
+
+    std::vector<bool> covered;
+
+    if (!all && !bounds.empty()) {
+        camera_rays.set_camera(scene->get_camera(), frame_width, frame_height);
+        covered.assign(pixel_count, false);
+
+        for (const Aabb &box : bounds) {
+            float x0, y0, x1, y1;
+
+            /**
+             * Unbounded drawables and boxes the camera can't project may cover any pixel.
+             */
+            if (box.min.x > box.max.x || !camera_rays.project_bounds(box.min, box.max, &x0, &y0, &x1, &y1)) {
+                all = true;
+                break;
+            }
+
+            /**
+             * Samples are jittered within their pixel, so the pixels are widened by one on each
+             * side.
+             */
+            float left = std::max(x0 - region_x - 1.0f, 0.0f);
+            float top = std::max(y0 - region_y - 1.0f, 0.0f);
+            float right = std::min(x1 - region_x + 1.0f, (float) image.get_width() - 1.0f);
+            float bottom = std::min(y1 - region_y + 1.0f, (float) image.get_height() - 1.0f);
+
+            for (long y = (long) top; y <= (long) bottom; y++) {
+                for (long x = (long) left; x <= (long) right; x++) {
+                    covered[(size_t) y * image.get_width() + x] = true;
+                }
+            }
+        }
+    }
+
+    std::sort(tags.begin(), tags.end());
+
+    size_t invalidated = 0;
+
+    for (size_t i = 0; i < pixel_count; i++) {
+        if (!all && !pixel_tags[i].contains_any(tags) && (covered.empty() || !covered[i])) {
+            bool crossed = false;
+
+            for (size_t j = 0; j < bounds.size() && !crossed; j++) {
+                crossed = overlaps(pixel_ray_bounds[i], bounds[j]);
+            }
+
+            if (!crossed)
+                continue;
+        }
+
+        sample_counts[i] = 0;
+        accumulation[i * 3] = accumulation[i * 3 + 1] = accumulation[i * 3 + 2] = 0.0f;
+        luminance_moments[i * 2] = luminance_moments[i * 2 + 1] = 0.0f;
+        pixel_tags[i] = PixelTags();
+        pixel_ray_bounds[i] = Aabb();
+
+        invalidated++;
+    }
+
+    /**
+     * The invalidated pixels restart with small passes for a quick preview.
+     */
+    if (invalidated)
+        completed_passes = 0;
+
+    return invalidated;
+}
+
+const std::vector<PixelTags> &RayTracer::get_pixel_tags() const
+{
+    return pixel_tags;
+}
+
+unsigned int RayTracer::get_completed_passes() const
+{
+    return completed_passes;
+}
+
+void RayTracer::set_time_budget(double seconds)
+{
+    time_budget = seconds;
+}
+
+RenderQuality RayTracer::get_render_quality() const
+{
+    RenderQuality quality;
+
+    if (accumulation.empty() || sample_counts.empty())
+        return quality;
+
+    unsigned long samples = 0;
+    unsigned long noise_pixels = 0;
+    double squared_error = 0.0;
+
+    quality.min_samples = sample_counts[0];
+
+    for (size_t i = 0; i < sample_counts.size(); i++) {
+        unsigned int n = sample_counts[i];
+
+        samples += n;
+        quality.min_samples = std::min(quality.min_samples, n);
+        quality.max_samples = std::max(quality.max_samples, n);
+
+        if (n >= 2) {
+            squared_error += luminance_moments[i * 2 + 1] / ((double) (n - 1) * n);
+            noise_pixels++;
+        }
+    }
+
+    quality.average_samples = (double) samples / sample_counts.size();
+
+    if (noise_pixels)
+        quality.noise = sqrt(squared_error / noise_pixels);
+
+    return quality;
 }
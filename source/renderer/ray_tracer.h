@@ -21,10 +21,34 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <scene.h>
 #include <image.h>
+#include <image_stream.h>
+#include <camera_ray_generator.h>
 #include <functional>
+#include <atomic>
+#include <thread>
+#include <chrono>
 #include <thread_pool.h>
 #include "renderer.h"
 #include "shader.h"
+#include "shadow_cache.h"
+#include "checkpoint.h"
+#include "pixel_tags.h"
+
+/**
+ * Quality reached by a progressive render.
+ */
+struct RenderQuality {
+    double average_samples = 0.0;
+
+    unsigned int min_samples = 0;
+    unsigned int max_samples = 0;
+
+    /**
+     * Root mean square of the pixels' estimated standard error of the tone mapped luminance,
+     * over the pixels with at least two samples. Negative if there are none.
+     */
+    double noise = -1.0;
+};
 
 class RayTracer : public Renderer {
 protected:
@@ -32,31 +56,237 @@ protected:
 
     Image image;
 
-    std::vector< std::function<void()> > render_jobs;
+    /**
+     * When set, finished scan lines are written to the stream instead of the image pixels.
+     */
+    ImageStream *output_stream = nullptr;
 
-    ThreadPool thread_pool;
+    std::vector< std::function<void()> > render_jobs;
 
     Shader shader;
 
+    /**
+     * Set up from the scene's camera at the start of every render.
+     */
+    CameraRayGenerator camera_rays;
+
+    std::atomic<unsigned long> shadow_cache_lookups;
+
+    std::atomic<unsigned long> shadow_cache_hits;
+
+    /**
+     * Wall clock time of the last render() call in milliseconds.
+     */
+    double render_time = 0.0;
+
+    /**
+     * Adaptive sampling settings. Every pixel takes at least min_samples and keeps
+     * sampling until the standard error of its tone mapped luminance drops below
+     * the threshold or max_samples is reached.
+     */
+    unsigned int min_samples = 1;
+
+    unsigned int max_samples = 1;
+
+    float adaptive_threshold = 0.01f;
+
+    /**
+     * Samples per pixel of blur for cameras with a lens, 0 to sample every pixel up to
+     * max_samples. See set_lens_sampling().
+     */
+    float lens_sample_density = 0.0f;
+
+    /**
+     * Number of samples every pixel received. Only kept when taking more than one sample per pixel.
+     */
+    std::vector<unsigned int> sample_counts;
+
+    std::atomic<unsigned long> total_samples;
+
     static const int max_iterations = 100;
 
     //Using 1 / 255 as a threshold.
     static constexpr double energy_threshold = 0.003921569;
 
-    Vec3 shade(const Ray &ray, HitPoint &hit_point, int iterations);
+    /**
+     * Type and seed of the samplers created for every pixel.
+     */
+    SamplerType sampler_type = SAMPLER_SOBOL;
+
+    unsigned int sampler_seed = 0;
+
+    /**
+     * Feature buffers, only allocated for the enabled AOV types. Depth and object ID are
+     * replicated over the three channels.
+     */
+    bool aov_enabled[AOV_COUNT] = {};
+
+    Image aov_images[AOV_COUNT];
+
+    /**
+     * The frame the image is a part of and the position of the image's top left pixel in it.
+     * Without a render region the image is the whole frame.
+     */
+    bool region_enabled = false;
+
+    unsigned int frame_width = 0;
+    unsigned int frame_height = 0;
+
+    unsigned int region_x = 0;
+    unsigned int region_y = 0;
+
+    /**
+     * Progressive rendering. Every pass adds up to 2^pass samples (at most max_pass_samples) to
+     * every pixel that has not reached max_samples or converged. The per pixel sums, sample counts
+     * (in sample_counts) and luminance moments carry over between passes.
+     */
+    bool progressive = false;
+
+    unsigned int max_pass_samples = 64;
+
+    unsigned int completed_passes = 0;
+
+    std::vector<float> accumulation;
+
+    std::vector<float> luminance_moments;
+
+    /**
+     * Objects and materials the paths of every pixel hit, shadow ray occluders included, used to
+     * find the pixels an edit invalidates. 32 bytes per pixel, see PixelTags.
+     */
+    std::vector<PixelTags> pixel_tags;
+
+    /**
+     * Bounds of the secondary and shadow ray segments every pixel's paths traced, 24 bytes per
+     * pixel. Moving or adding a drawable can only change the pixels whose camera rays or other
+     * segments pass through its bounds before or after the edit, and the boxes are a
+     * conservative test for the latter. Rays that escape the scene reach infinity.
+     */
+    std::vector<Aabb> pixel_ray_bounds;
+
+    std::atomic<unsigned long> unfinished_pixels;
+
+    /**
+     * Wall clock budget of a progressive render in seconds, 0 for none. Whole passes are
+     * rendered, shrunk to fit the remaining budget, so the image is never left partially
+     * rendered and samples are spread evenly over the frame.
+     */
+    double time_budget = 0.0;
+
+    std::chrono::steady_clock::time_point deadline;
+
+    std::atomic<bool> budget_exhausted;
+
+    /**
+     * Checkpoints are snapshots of the progressive state taken between passes and written by a
+     * background thread while the next pass renders.
+     */
+    std::string checkpoint_file;
+
+    double checkpoint_interval = 0.0;
+
+    std::thread checkpoint_writer;
+
+    std::atomic<bool> checkpoint_writing;
 
-    Vec3 trace_ray(const Ray &ray, int iterations = 0);
+    bool has_aovs() const;
+
+    void write_aov_pixel(unsigned int pixel_x, unsigned int pixel_y, const AovSample &aov);
+
+    Vec3 shade(const Ray &ray, HitPoint &hit_point, Sampler &sampler, int iterations);
+
+    /**
+     * Direct lighting from an area light. Stratified light samples and B.R.D.F. samples
+     * are combined with multiple importance sampling.
+     */
+    Vec3 sample_area_light(const Light *light, unsigned int light_index, HitPoint &hit_point,
+                           const Vec3 &view_direction, const Material &material, Sampler &sampler);
+
+    Vec3 trace_ray(const Ray &ray, Sampler &sampler, int iterations = 0, AovSample *aov = nullptr);
+
+    /**
+     * Fills aov with the features of a camera ray's first hit, if aov is set.
+     */
+    void record_aov(const Ray &ray, const HitPoint &hit_point, AovSample *aov) const;
 
     void find_intersection(const Ray &ray, HitPoint &hit_point);
 
-    Ray create_primary_ray(int pixel_x, int pixel_y) const;
+    /**
+     * Finds the nearest hit of the ray. The segments of rays that are not camera rays are added
+     * to the bounds of the current pixel's paths, see pixel_ray_bounds.
+     */
+    void find_intersection(const Ray &ray, HitPoint &hit_point, bool camera_ray);
+
+    /**
+     * Returns the index of any drawable that the ray hits before the given distance,
+     * or ShadowCache::no_occluder if the ray reaches it unobstructed.
+     */
+    long find_occluder(const Ray &ray, double max_distance) const;
+
+    /**
+     * Shadow query for the light with the given index. The last occluder of that light
+     * is tested first before falling back to the full intersection search.
+     */
+    bool is_occluded(const Ray &shadow_ray, unsigned int light_index) const;
+
+    void flush_shadow_cache_statistics();
+
+    /**
+     * Creates the camera ray through the given frame coordinates and lens point.
+     * Integer coordinates correspond to the top left corner of a pixel.
+     */
+    Ray create_primary_ray(float pixel_x, float pixel_y, float lens_u = 0.5f, float lens_v = 0.5f) const;
+
+    /**
+     * Most samples the frame pixel takes. With lens sampling that is the pixel's circle of
+     * confusion area times the lens sample density, within [min_samples, max_samples].
+     */
+    unsigned int get_sample_budget(unsigned int pixel_x, unsigned int pixel_y);
 
-    void render_scan_line(unsigned int line_number, unsigned int line_size, float *pixels);
+    /**
+     * Computes the color of a single sample at the given image plane coordinates.
+     */
+    virtual Vec3 sample_pixel(float pixel_x, float pixel_y, Sampler &sampler, AovSample *aov = nullptr);
+
+    /**
+     * Computes the final color of the frame pixel at the given coordinates, adaptively supersampling it if enabled.
+     * If aov is set it receives the pixel's features averaged over its samples, except for
+     * the object ID which comes from the first sample. A single sample pixel traces primary_ray
+     * if it is given.
+     */
+    Vec3 render_pixel(unsigned int pixel_x, unsigned int pixel_y, unsigned int *sample_count,
+                      AovSample *aov = nullptr, const Ray *primary_ray = nullptr);
+
+    void render_scan_line(unsigned int line_number);
+
+    /**
+     * Whether a pixel with n samples and the given sum of squared luminance differences
+     * meets the adaptive sampling threshold.
+     */
+    bool is_converged(unsigned int n, float m2) const;
+
+    /**
+     * Adds up to pass_samples samples to every pixel of the line and writes the line's
+     * current estimate to the image.
+     */
+    void render_progressive_line(unsigned int line_number, unsigned int pass_samples);
+
+    void render_progressive();
+
+    /**
+     * Snapshots the progressive state and starts writing it in the background. Unless wait is
+     * set, nothing happens while the previous checkpoint is still being written.
+     */
+    bool write_checkpoint(bool wait);
 
 public:
-    RayTracer() = default;
+    RayTracer() : shadow_cache_lookups(0), shadow_cache_hits(0), total_samples(0), unfinished_pixels(0),
+                  budget_exhausted(false), checkpoint_writing(false)
+    { }
 
-    RayTracer(const Scene *scene, const Image &image) : scene(scene), image(image)
+    RayTracer(const Scene *scene, const Image &image)
+            : scene(scene), image(image), shadow_cache_lookups(0), shadow_cache_hits(0), total_samples(0),
+              unfinished_pixels(0), budget_exhausted(false), checkpoint_writing(false)
     { }
 
     ~RayTracer();
@@ -67,7 +297,114 @@ public:
 
     void set_image(const Image &image);
 
+    /**
+     * Streams the rendered scan lines to the given stream, which must match the image size.
+     * The image then only needs its dimensions set and no pixel memory.
+     */
+    void set_output_stream(ImageStream *stream);
+
     void render();
+
+    double get_render_time() const;
+
+    /**
+     * Enables adaptive supersampling. Passing the same min and max sample count gives uniform supersampling.
+     */
+    void set_adaptive_sampling(unsigned int min_samples, unsigned int max_samples, float threshold);
+
+    /**
+     * Adaptive lens sampling for thin lens cameras. Every pixel takes the given number of
+     * samples per pixel of area that the lens blurs its centre's first hit over, but no fewer
+     * than min_samples and no more than max_samples. In focus pixels stop at min_samples while
+     * blurred ones get more, and all of them still stop once converged. 0 disables it.
+     */
+    void set_lens_sampling(float samples_per_pixel);
+
+    unsigned long get_total_samples() const;
+
+    void set_sampler(SamplerType type, unsigned int seed = 0);
+
+    /**
+     * Saves an image showing how many samples every pixel took, from blue (min) to red (max).
+     */
+    bool save_sample_heatmap(const std::string &file_name) const;
+
+    ShadowCacheStatistics get_shadow_cache_statistics() const;
+
+    /**
+     * Renders only the part of a frame_width x frame_height frame covered by the image, placed
+     * with its top left pixel at (x, y). Every pixel gets the same rays and samples it gets in a
+     * full frame render, so separately rendered regions merge into an identical frame.
+     */
+    void set_render_region(unsigned int frame_width, unsigned int frame_height, unsigned int x, unsigned int y);
+
+    void clear_render_region();
+
+    /**
+     * Renders in passes of increasing sample counts, updating the image after every pass,
+     * until every pixel has max_samples samples or has converged. The final image is identical
+     * to a one-shot render with the same sampling settings. AOVs come from every pixel's first
+     * sample. Needs an in-memory image.
+     */
+    void set_progressive(bool enabled, unsigned int max_pass_samples = 64);
+
+    /**
+     * Writes a checkpoint of a progressive render after a pass whenever the given number of
+     * seconds has passed since the last one, and once the render is done.
+     */
+    void set_checkpoint(const std::string &file_name, double interval_seconds);
+
+    /**
+     * Continues a progressive render from a checkpoint. Call after initialize(); the image
+     * size, render region, sampler and sampling settings must match those of the checkpointed
+     * render.
+     */
+    bool resume(const std::string &file_name);
+
+    /**
+     * Discards the progressive samples of the pixels the scene changes affect, which the next
+     * render() takes again while the others keep their samples. Material edits affect the
+     * pixels whose paths hit the edited materials or drawables. Moved and added drawables affect
+     * the pixels their bounds cover on screen and the pixels whose secondary or shadow rays may
+     * pass through them, before and after the edit, so the result matches a full re-render.
+     * Light edits, unbounded drawables and panoramic cameras affect every pixel. Call with the
+     * changes from Scene::commit_changes(). Returns the number of affected pixels.
+     */
+    size_t invalidate(const SceneChanges &changes);
+
+    /**
+     * The objects and materials the paths of every pixel of a progressive render hit.
+     */
+    const std::vector<PixelTags> &get_pixel_tags() const;
+
+    unsigned int get_completed_passes() const;
+
+    /**
+     * Stops progressive renders once the given number of seconds has passed, keeping the
+     * image of the samples taken so far. 0 disables the budget.
+     */
+    void set_time_budget(double seconds);
+
+    /**
+     * Sample counts and noise estimate of the progressive render's current image.
+     */
+    RenderQuality get_render_quality() const;
+
+    /**
+     * Requests a feature buffer, allocated by initialize().
+     */
+    void enable_aov(AovType type);
+
+    /**
+     * The buffer of an enabled AOV type, owned by the ray tracer.
+     */
+    const Image &get_aov(AovType type) const;
+
+    /**
+     * Saves an AOV buffer without any display transform. Linear formats (.pfm, .exr) keep
+     * negative normals and depths beyond 1.
+     */
+    bool save_aov(AovType type, const std::string &file_name) const;
 };
 
 #endif //HELIOS_RAY_TRACER_H
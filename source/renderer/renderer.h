@@ -19,12 +19,17 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef HELIOS_RENDERER_H
 #define HELIOS_RENDERER_H
 
+#include <sampler.h>
+#include "aov.h"
 
 class Renderer {
 protected:
-    virtual Vec3 shade(const Ray &ray, HitPoint &hit_point, int iterations) = 0;
+    virtual Vec3 shade(const Ray &ray, HitPoint &hit_point, Sampler &sampler, int iterations) = 0;
 
-    virtual Vec3 trace_ray(const Ray &ray, int iterations) = 0;
+    /**
+     * If aov is given it receives the features of the ray's first hit.
+     */
+    virtual Vec3 trace_ray(const Ray &ray, Sampler &sampler, int iterations, AovSample *aov) = 0;
 
     virtual void find_intersection(const Ray &ray, HitPoint &hit_point) = 0;
 
@@ -28,6 +28,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <drawable.h>
 #include <algorithm>
 
+static const float min_roughness = 0.027f;
+
 /* Private Functions ------------------------------------------------------------------------------ */
 
 float Shader::diffuse_lambert(const Vec3 &light_direction, const Vec3 &normal) const
@@ -37,19 +39,20 @@ float Shader::diffuse_lambert(const Vec3 &light_direction, const Vec3 &normal) c
 
 
 float Shader::diffuse_oren_nayar(const Vec3 &light_direction, const Vec3 &view_direction,
-                                 const HitPoint &hit_point) const
+                                 const HitPoint &hit_point, const Material &material) const
 {
-    Drawable *obj = static_cast<Drawable *>(hit_point.object);
-
-    float roughness = obj->material.roughness;
+    float roughness = material.roughness;
 
     float roughness_squared = roughness * roughness;
 
     float n_dot_l = dot(hit_point.normal, light_direction);
     float n_dot_v = dot(hit_point.normal, view_direction);
 
-    float view_normal_angle = (float) acos(n_dot_v);
-    float light_normal_angle = (float) acos(n_dot_l);
+    /**
+     * Rounding can push the cosines just past 1, where acos() is NaN.
+     */
+    float view_normal_angle = (float) acos(std::min(std::max(n_dot_v, -1.0f), 1.0f));
+    float light_normal_angle = (float) acos(std::min(std::max(n_dot_l, -1.0f), 1.0f));
 
     float a = std::max(view_normal_angle, light_normal_angle);
     float b = std::min(view_normal_angle, light_normal_angle);
@@ -95,6 +98,31 @@ float Shader::fresnel_schlick_approximation(const ShadingVariables &variables) c
     return reflectivity + (1.0f - reflectivity) * (float) pow(1.0f - (variables.v_dot_h), 5.0f);
 }
 
+float Shader::specular_sampling_probability(const Material &material) const
+{
+    return std::min(std::max(1.0f - material.roughness, 0.1f), 0.9f);
+}
+
+float Shader::specular_sampling_pdf(const Vec3 &normal, const Vec3 &in_dir, const Vec3 &out_dir,
+                                    const Material &material) const
+{
+    float roughness = material.roughness < min_roughness ? min_roughness : material.roughness;
+
+    Vec3 h = (out_dir + in_dir).normalized();
+
+    ShadingVariables shading_variables;
+    shading_variables.n_dot_h = std::max(dot(normal, h), 0.0f);
+    shading_variables.n_dot_h_squared = shading_variables.n_dot_h * shading_variables.n_dot_h;
+    shading_variables.roughness_squared = roughness * roughness;
+
+    float v_dot_h = std::max(dot(out_dir, h), 1e-6f);
+
+    /**
+     * The half vector pdf is D(h) * (n . h), transformed to the incoming direction.
+     */
+    return ndf_ggx(shading_variables) * shading_variables.n_dot_h / (4.0f * v_dot_h);
+}
+
 /* ------------------------------------------------------------------------------------------------ */
 
 float Shader::calculate_diffuse_contribution(const Vec3 &light_direction, const Vec3 &view_direction,
@@ -104,7 +132,7 @@ float Shader::calculate_diffuse_contribution(const Vec3 &light_direction, const
         case LAMBERT:
             return diffuse_lambert(light_direction, hit_point.normal);
         case OREN_NYAR:
-            return diffuse_oren_nayar(light_direction, view_direction, hit_point);
+            return diffuse_oren_nayar(light_direction, view_direction, hit_point, material);
     }
 
     return 0;
@@ -113,7 +141,6 @@ float Shader::calculate_diffuse_contribution(const Vec3 &light_direction, const
 float Shader::calculate_specular_contribution(const Vec3 &normal, const Vec3 &in_dir, const Vec3 &out_dir,
                                               const Material &material)
 {
-    static const float min_roughness = 0.027f;
     float roughness = material.roughness < min_roughness ? min_roughness : material.roughness;
 
     float normal_distribution = 0.0f;
@@ -172,3 +199,74 @@ float Shader::calculate_specular_contribution(const Vec3 &normal, const Vec3 &in
     return (normal_distribution * fresnel * geometric_shadowing) /
            (4.0f * shading_variables.n_dot_l * shading_variables.n_dot_v);
 }
+
+Vec3 Shader::evaluate_brdf(const Vec3 &in_dir, const Vec3 &out_dir, HitPoint &hit_point, const Material &material)
+{
+    float n_dot_l = dot(hit_point.normal, in_dir);
+
+    if (n_dot_l <= 0.0f || dot(hit_point.normal, out_dir) <= 0.0f)
+        return Vec3();
+
+    /**
+     * The diffuse functions include the cosine term so it is divided out here.
+     */
+    float diffuse = calculate_diffuse_contribution(in_dir, out_dir, hit_point, material) / n_dot_l;
+    float specular = calculate_specular_contribution(hit_point.normal, in_dir, out_dir, material);
+
+    Vec3 specular_color = material.metallic ? material.albedo : Vec3(1.0f, 1.0f, 1.0f);
+
+    return material.albedo * (diffuse / (float) M_PI) + specular_color * specular;
+}
+
+bool Shader::sample_brdf(const Vec3 &out_dir, const Vec3 &normal, const Material &material, float u, float v,
+                         Vec3 *in_dir, float *pdf) const
+{
+    Vec3 tangent, bitangent;
+    orthonormal_basis(normal, &tangent, &bitangent);
+
+    float phi = 2.0f * (float) M_PI * v;
+    float specular_probability = specular_sampling_probability(material);
+
+    if (u < specular_probability) {
+        /**
+         * Reuse u for the GGX half vector sample.
+         */
+        u /= specular_probability;
+
+        float roughness = material.roughness < min_roughness ? min_roughness : material.roughness;
+        float a_sq = roughness * roughness * roughness * roughness;
+
+        float cos_theta = (float) sqrt((1.0f - u) / (1.0f + (a_sq - 1.0f) * u));
+        float sin_theta = (float) sqrt(std::max(0.0f, 1.0f - cos_theta * cos_theta));
+
+        Vec3 h = tangent * (sin_theta * (float) cos(phi)) + bitangent * (sin_theta * (float) sin(phi)) +
+                 normal * cos_theta;
+
+        *in_dir = reflect(-out_dir, h);
+    }
+    else {
+        u = (u - specular_probability) / (1.0f - specular_probability);
+
+        float r = (float) sqrt(u);
+
+        *in_dir = tangent * (r * (float) cos(phi)) + bitangent * (r * (float) sin(phi)) +
+                  normal * (float) sqrt(std::max(0.0f, 1.0f - u));
+    }
+
+    *pdf = brdf_pdf(*in_dir, out_dir, normal, material);
+
+    return *pdf > 0.0f;
+}
+
+float Shader::brdf_pdf(const Vec3 &in_dir, const Vec3 &out_dir, const Vec3 &normal, const Material &material) const
+{
+    float n_dot_l = dot(normal, in_dir);
+
+    if (n_dot_l <= 0.0f || dot(normal, out_dir) <= 0.0f)
+        return 0.0f;
+
+    float specular_probability = specular_sampling_probability(material);
+
+    return specular_probability * specular_sampling_pdf(normal, in_dir, out_dir, material) +
+           (1.0f - specular_probability) * n_dot_l / (float) M_PI;
+}
@@ -34,6 +34,17 @@ struct ShadingVariables {
     float ior = 0.0f;
 };
 
+/**
+ * Power heuristic (beta = 2) weight for multiple importance sampling.
+ */
+inline float power_heuristic(float pdf, float other_pdf)
+{
+    float pdf_squared = pdf * pdf;
+    float sum = pdf_squared + other_pdf * other_pdf;
+
+    return sum > 0.0f ? pdf_squared / sum : 0.0f;
+}
+
 class Shader {
 private:
 
@@ -42,7 +53,8 @@ private:
      */
     float diffuse_lambert(const Vec3 &light_direction, const Vec3 &normal) const;
 
-    float diffuse_oren_nayar(const Vec3 &light_direction, const Vec3 &view_direction, const HitPoint &hit_point) const;
+    float diffuse_oren_nayar(const Vec3 &light_direction, const Vec3 &view_direction, const HitPoint &hit_point,
+                             const Material &material) const;
 
     /**
      * NDF functions
@@ -59,6 +71,14 @@ private:
      */
     float fresnel_schlick_approximation(const ShadingVariables &variables) const;
 
+    /**
+     * Probability of importance sampling the specular lobe rather than the diffuse one.
+     */
+    float specular_sampling_probability(const Material &material) const;
+
+    float specular_sampling_pdf(const Vec3 &normal, const Vec3 &in_dir, const Vec3 &out_dir,
+                                const Material &material) const;
+
 public:
     float calculate_diffuse_contribution(const Vec3 &light_direction, const Vec3 &view_direction, HitPoint &hit_point,
                                          const Material &material) const;
@@ -67,6 +87,24 @@ public:
      * Evaluate the B.R.D.F.
      */
     float calculate_specular_contribution(const Vec3 &normal, const Vec3 &in_dir, const Vec3 &out_dir, const Material &material);
+
+    /**
+     * Evaluate the diffuse and specular lobes together, without the cosine term.
+     */
+    Vec3 evaluate_brdf(const Vec3 &in_dir, const Vec3 &out_dir, HitPoint &hit_point, const Material &material);
+
+    /**
+     * Importance sample an incoming direction from the two uniform numbers u and v.
+     * The diffuse lobe is cosine weighted and the specular lobe samples GGX distributed half vectors.
+     * Returns false if the sampled direction is beneath the surface.
+     */
+    bool sample_brdf(const Vec3 &out_dir, const Vec3 &normal, const Material &material, float u, float v,
+                     Vec3 *in_dir, float *pdf) const;
+
+    /**
+     * The solid angle pdf of sample_brdf() choosing in_dir.
+     */
+    float brdf_pdf(const Vec3 &in_dir, const Vec3 &out_dir, const Vec3 &normal, const Material &material) const;
 };
 
 #endif //HELIOS_SHADER_H
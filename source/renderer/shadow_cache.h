@@ -0,0 +1,74 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_SHADOW_CACHE_H
+#define HELIOS_SHADOW_CACHE_H
+
+#include <vector>
+
+class Scene;
+
+/**
+ * Remembers, for every light, the last object that blocked a shadow ray towards it.
+ * Neighbouring pixels are usually shadowed by the same object, so testing that object
+ * first lets most occluded shadow rays skip the full intersection search.
+ *
+ * Each render thread owns one cache so no synchronization is needed on lookups.
+ */
+struct ShadowCache {
+    static const long no_occluder = -1;
+
+    /**
+     * The scene the cached indices refer to.
+     */
+    const Scene *scene = nullptr;
+
+    /**
+     * Primitive index of the last occluder per light index.
+     */
+    std::vector<long> occluders;
+
+    unsigned long lookups = 0;
+
+    unsigned long hits = 0;
+
+    void reset(const Scene *scene, unsigned long light_count)
+    {
+        this->scene = scene;
+        occluders.assign(light_count, (long) no_occluder);
+    }
+};
+
+struct ShadowCacheStatistics {
+    /**
+     * Number of shadow rays that were tested against a cached occluder.
+     */
+    unsigned long lookups = 0;
+
+    /**
+     * Number of shadow rays that were resolved by the cached occluder alone.
+     */
+    unsigned long hits = 0;
+
+    float hit_rate() const
+    {
+        return lookups ? (float) hits / (float) lookups : 0.0f;
+    }
+};
+
+#endif //HELIOS_SHADOW_CACHE_H
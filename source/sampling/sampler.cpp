@@ -0,0 +1,170 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "sampler.h"
+
+/* Static functions */
+
+/**
+ * PCG output permutation used as an integer hash (Jarzynski & Olano, "Hash Functions for GPU Rendering").
+ */
+static inline uint32_t pcg_hash(uint32_t value)
+{
+    uint32_t state = value * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+
+    return (word >> 22u) ^ word;
+}
+
+static inline uint32_t hash_combine(uint32_t seed, uint32_t value)
+{
+    return pcg_hash(seed ^ (value + 0x9e3779b9u + (seed << 6) + (seed >> 2)));
+}
+
+static inline uint32_t reverse_bits(uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+
+    return (x >> 16) | (x << 16);
+}
+
+/**
+ * Hash based Owen scrambling (Burley, "Practical Hash-based Owen Scrambling").
+ */
+static inline uint32_t laine_karras_permutation(uint32_t x, uint32_t seed)
+{
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+
+    return x;
+}
+
+static inline uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed)
+{
+    return reverse_bits(laine_karras_permutation(reverse_bits(x), seed));
+}
+
+/**
+ * The second Sobol dimension. The first one is the bit reversed index.
+ */
+static inline uint32_t sobol_dimension_1(uint32_t index)
+{
+    uint32_t result = 0;
+
+    for (uint32_t v = 1u << 31; index; index >>= 1, v ^= v >> 1) {
+        if (index & 1u)
+            result ^= v;
+    }
+
+    return result;
+}
+
+/**
+ * Maps 32 random bits to a float in [0, 1).
+ */
+static inline float to_unit_float(uint32_t x)
+{
+    return (float) (x >> 8) * (1.0f / 16777216.0f);
+}
+
+/* ------------------------------------------------------------------*/
+
+/* Private Functions */
+
+uint32_t Sampler::next_random(uint32_t dimension_hash) const
+{
+    return hash_combine(hash_combine(pixel_hash, sample_index), dimension_hash);
+}
+
+void Sampler::sobol_2d(float *u, float *v)
+{
+    uint32_t dimension_seed = hash_combine(pixel_hash, dimension);
+
+    /**
+     * Shuffle the sample order per dimension pair to decorrelate the pairs,
+     * then scramble the two coordinates independently.
+     */
+    uint32_t index = nested_uniform_scramble(sample_index, dimension_seed);
+
+    *u = to_unit_float(nested_uniform_scramble(reverse_bits(index), hash_combine(dimension_seed, 0u)));
+    *v = to_unit_float(nested_uniform_scramble(sobol_dimension_1(index), hash_combine(dimension_seed, 1u)));
+}
+
+/* ---------------------------------------------------------------------- */
+
+void Sampler::start_pixel(unsigned int pixel_x, unsigned int pixel_y)
+{
+    pixel_hash = hash_combine(hash_combine(pcg_hash(seed), pixel_x), pixel_y);
+
+    start_sample(0);
+}
+
+void Sampler::start_sample(unsigned int sample_index)
+{
+    this->sample_index = sample_index;
+    dimension = 0;
+}
+
+unsigned int Sampler::get_sample_index() const
+{
+    return sample_index;
+}
+
+unsigned int Sampler::get_dimension() const
+{
+    return dimension;
+}
+
+float Sampler::get_1d()
+{
+    /**
+     * One dimensional requests use up a whole dimension pair so 2D requests stay on Sobol pairs.
+     */
+    float u;
+
+    if (type == SAMPLER_SOBOL) {
+        float unused;
+        sobol_2d(&u, &unused);
+    }
+    else {
+        u = to_unit_float(next_random(dimension));
+    }
+
+    dimension += 2;
+
+    return u;
+}
+
+void Sampler::get_2d(float *u, float *v)
+{
+    if (type == SAMPLER_SOBOL) {
+        sobol_2d(u, v);
+    }
+    else {
+        *u = to_unit_float(next_random(dimension));
+        *v = to_unit_float(next_random(dimension + 1));
+    }
+
+    dimension += 2;
+}
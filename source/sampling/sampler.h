@@ -0,0 +1,85 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_SAMPLER_H
+#define HELIOS_SAMPLER_H
+
+#include <stdint.h>
+
+enum SamplerType {
+    /**
+     * Independent uniform numbers from a counter based hash.
+     */
+    SAMPLER_RANDOM,
+
+    /**
+     * Owen scrambled Sobol (0,2)-sequence. Every pair of dimensions is a separately shuffled
+     * and scrambled copy of the first two Sobol dimensions.
+     */
+    SAMPLER_SOBOL
+};
+
+/**
+ * Deterministic sample generator.
+ *
+ * Every number is a pure function of (seed, pixel, sample index, dimension), so a sampler holds no
+ * state that is shared between threads and renders are identical regardless of how pixels are
+ * distributed over the worker threads. A sampler is cheap to create and is used by one pixel at a time.
+ */
+class Sampler {
+private:
+    SamplerType type = SAMPLER_SOBOL;
+
+    uint32_t seed = 0;
+
+    uint32_t pixel_hash = 0;
+
+    uint32_t sample_index = 0;
+
+    uint32_t dimension = 0;
+
+    uint32_t next_random(uint32_t dimension_hash) const;
+
+    void sobol_2d(float *u, float *v);
+
+public:
+    Sampler() = default;
+
+    Sampler(SamplerType type, uint32_t seed) : type(type), seed(seed)
+    { }
+
+    /**
+     * Pixels are identified by their coordinates in the full frame.
+     */
+    void start_pixel(unsigned int pixel_x, unsigned int pixel_y);
+
+    /**
+     * Moves to the given sample of the current pixel and resets the dimension counter.
+     */
+    void start_sample(unsigned int sample_index);
+
+    unsigned int get_sample_index() const;
+
+    unsigned int get_dimension() const;
+
+    float get_1d();
+
+    void get_2d(float *u, float *v);
+};
+
+#endif //HELIOS_SAMPLER_H
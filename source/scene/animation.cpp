@@ -0,0 +1,107 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include "animation.h"
+
+void Animation::add_keyframe(uint32_t drawable, float time, const Vec3 &position)
+{
+    auto found = track_indices.find(drawable);
+
+    if (found == track_indices.end()) {
+        found = track_indices.emplace(drawable, tracks.size()).first;
+
+        Track track;
+        track.drawable = drawable;
+        tracks.push_back(track);
+    }
+
+    std::vector<Keyframe> &keyframes = tracks[found->second].keyframes;
+
+    auto position_in_time = std::lower_bound(keyframes.begin(), keyframes.end(), time,
+                                             [](const Keyframe &keyframe, float time) {
+                                                 return keyframe.time < time;
+                                             });
+
+    Keyframe keyframe;
+    keyframe.time = time;
+    keyframe.position = position;
+
+    if (position_in_time != keyframes.end() && position_in_time->time == time)
+        *position_in_time = keyframe;
+    else
+        keyframes.insert(position_in_time, keyframe);
+
+    duration = std::max(duration, time);
+}
+
+bool Animation::is_empty() const
+{
+    return tracks.empty();
+}
+
+float Animation::get_duration() const
+{
+    return duration;
+}
+
+void Animation::apply(const std::vector<Drawable *> &drawables, float time, std::vector<uint32_t> *moved) const
+{
+    for (const Track &track : tracks) {
+        if (track.drawable >= drawables.size())
+            continue;
+
+        const std::vector<Keyframe> &keyframes = track.keyframes;
+
+        auto next = std::upper_bound(keyframes.begin(), keyframes.end(), time,
+                                     [](float time, const Keyframe &keyframe) {
+                                         return time < keyframe.time;
+                                     });
+
+        Vec3 position;
+
+        if (next == keyframes.begin()) {
+            position = next->position;
+        }
+        else if (next == keyframes.end()) {
+            position = keyframes.back().position;
+        }
+        else {
+            const Keyframe &previous = *(next - 1);
+            float t = (time - previous.time) / (next->time - previous.time);
+
+            position = previous.position * (1.0f - t) + next->position * t;
+        }
+
+        Drawable *drawable = drawables[track.drawable];
+        const Vec3 &current = drawable->get_position();
+
+        if (current.x == position.x && current.y == position.y && current.z == position.z)
+            continue;
+
+        drawable->set_position(position);
+        moved->push_back(track.drawable);
+    }
+}
+
+void Animation::clear()
+{
+    tracks.clear();
+    track_indices.clear();
+    duration = 0.0f;
+}
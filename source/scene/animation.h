@@ -0,0 +1,77 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_ANIMATION_H
+#define HELIOS_ANIMATION_H
+
+#include <vector>
+#include <cstdint>
+#include <unordered_map>
+#include <drawable.h>
+
+struct Keyframe {
+    float time;
+
+    Vec3 position;
+};
+
+/**
+ * Keyframed positions of a scene's drawables. Positions are interpolated linearly between
+ * keyframes and held before the first and after the last keyframe of a drawable.
+ */
+class Animation {
+private:
+    struct Track {
+        uint32_t drawable;
+
+        /**
+         * Sorted by time.
+         */
+        std::vector<Keyframe> keyframes;
+    };
+
+    std::vector<Track> tracks;
+
+    std::unordered_map<uint32_t, size_t> track_indices;
+
+    float duration = 0.0f;
+
+public:
+    /**
+     * Adds a keyframe for the drawable with the given index in the scene, replacing one at the
+     * same time.
+     */
+    void add_keyframe(uint32_t drawable, float time, const Vec3 &position);
+
+    bool is_empty() const;
+
+    /**
+     * Time of the last keyframe.
+     */
+    float get_duration() const;
+
+    /**
+     * Moves the animated drawables to their positions at the given time and appends the indices
+     * of the ones that moved to moved.
+     */
+    void apply(const std::vector<Drawable *> &drawables, float time, std::vector<uint32_t> *moved) const;
+
+    void clear();
+};
+
+#endif //HELIOS_ANIMATION_H
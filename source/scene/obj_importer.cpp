@@ -0,0 +1,622 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <unordered_map>
+#include <algorithm>
+#include <functional>
+#include <cmath>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <number_parser.h>
+#include <thread_pool.h>
+#include "obj_importer.h"
+
+using namespace std::chrono;
+
+/**
+ * Material of the faces of a chunk that come before its first usemtl statement, which is only
+ * known once the chunks before it are merged.
+ */
+static const MaterialHandle inherited_material = 0xffff;
+
+struct ObjImporter::Chunk {
+    const char *begin = nullptr;
+    const char *end = nullptr;
+
+    /**
+     * Counted by the first pass.
+     */
+    size_t position_count = 0;
+    size_t normal_count = 0;
+    size_t face_count = 0;
+    unsigned long line_count = 0;
+
+    /**
+     * Where the chunk's vertices and lines start in the whole file, and the file's totals.
+     */
+    size_t first_position = 0;
+    size_t first_normal = 0;
+    size_t total_positions = 0;
+    size_t total_normals = 0;
+    unsigned long first_line = 0;
+
+    /**
+     * Triangle materials index the names of the usemtl statements in this chunk.
+     */
+    std::vector<MeshTriangle> triangles;
+
+    std::vector<std::string> material_names;
+
+    MaterialHandle last_material = inherited_material;
+
+    std::vector<std::string> libraries;
+
+    std::string error;
+
+    unsigned long error_line = 0;
+};
+
+static inline bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline const char *skip_spaces(const char *p, const char *end)
+{
+    while (p < end && is_space(*p))
+        p++;
+
+    return p;
+}
+
+static inline const char *find_line_end(const char *p, const char *end)
+{
+    const char *line_end = static_cast<const char *>(memchr(p, '\n', (size_t) (end - p)));
+
+    return line_end ? line_end : end;
+}
+
+static inline bool parse_vec3(const char *p, const char *end, Vec3 *vec)
+{
+    float *components[3] = {&vec->x, &vec->y, &vec->z};
+
+    for (float *component : components) {
+        p = parse_float(skip_spaces(p, end), end, component);
+
+        if (!p || (p < end && !is_space(*p)))
+            return false;
+    }
+
+    return true;
+}
+
+/**
+ * Turns a one based or negative relative OBJ index into a zero based one.
+ */
+static inline bool resolve_index(long index, size_t defined_count, size_t total_count, uint32_t *resolved)
+{
+    if (index > 0 && (size_t) index <= total_count) {
+        *resolved = (uint32_t) (index - 1);
+        return true;
+    }
+
+    if (index < 0 && (size_t) -index <= defined_count) {
+        *resolved = (uint32_t) (defined_count + index);
+        return true;
+    }
+
+    return false;
+}
+
+static std::string trim(const char *begin, const char *end)
+{
+    begin = skip_spaces(begin, end);
+
+    while (end > begin && is_space(end[-1]))
+        end--;
+
+    return std::string(begin, end);
+}
+
+enum ObjLineType {
+    OBJ_LINE_OTHER,
+    OBJ_LINE_POSITION,
+    OBJ_LINE_NORMAL,
+    OBJ_LINE_FACE
+};
+
+/**
+ * Splits a line into its keyword and the arguments after it and classifies it by the keyword.
+ * Both passes classify lines with this, so the second one parses exactly the vertices the
+ * first one counted.
+ */
+static inline ObjLineType classify_line(const char *line, const char *line_end, const char **keyword,
+                                        const char **arguments)
+{
+    const char *begin = skip_spaces(line, line_end);
+    const char *end = begin;
+
+    while (end < line_end && !is_space(*end))
+        end++;
+
+    *keyword = begin;
+    *arguments = end;
+
+    if (end - begin == 1 && begin[0] == 'v')
+        return OBJ_LINE_POSITION;
+
+    if (end - begin == 2 && begin[0] == 'v' && begin[1] == 'n')
+        return OBJ_LINE_NORMAL;
+
+    if (end - begin == 1 && begin[0] == 'f')
+        return OBJ_LINE_FACE;
+
+    return OBJ_LINE_OTHER;
+}
+
+/* Private Functions -------------------------------------------------------- */
+
+void ObjImporter::count_chunk(Chunk &chunk)
+{
+    for (const char *p = chunk.begin; p < chunk.end; p++) {
+        const char *line_end = find_line_end(p, chunk.end);
+        const char *keyword, *arguments;
+
+        switch (classify_line(p, line_end, &keyword, &arguments)) {
+            case OBJ_LINE_POSITION:
+                chunk.position_count++;
+                break;
+            case OBJ_LINE_NORMAL:
+                chunk.normal_count++;
+                break;
+            case OBJ_LINE_FACE:
+                chunk.face_count++;
+                break;
+            default:
+                break;
+        }
+
+        chunk.line_count++;
+        p = line_end;
+    }
+}
+
+void ObjImporter::parse_chunk(Chunk &chunk, std::vector<Vec3> &positions, std::vector<Vec3> &normals)
+{
+    size_t position = chunk.first_position;
+    size_t normal = chunk.first_normal;
+    unsigned long line = chunk.first_line;
+
+    MaterialHandle material = inherited_material;
+
+    /**
+     * Reused for every face so polygons don't allocate.
+     */
+    std::vector<uint32_t> face_positions;
+    std::vector<uint32_t> face_normals;
+
+    chunk.triangles.reserve(chunk.face_count);
+
+    auto fail = [&](const char *message) {
+        chunk.error = message;
+        chunk.error_line = line;
+    };
+
+    for (const char *p = chunk.begin; p < chunk.end; p++, line++) {
+        const char *line_end = find_line_end(p, chunk.end);
+        const char *keyword, *arguments;
+
+        ObjLineType type = classify_line(p, line_end, &keyword, &arguments);
+
+        p = line_end;
+
+        if (keyword == line_end || *keyword == '#')
+            continue;
+
+        size_t keyword_length = (size_t) (arguments - keyword);
+
+        if (type == OBJ_LINE_POSITION) {
+            if (!parse_vec3(arguments, line_end, &positions[position++]))
+                return fail("invalid vertex position");
+        }
+        else if (type == OBJ_LINE_NORMAL) {
+            if (!parse_vec3(arguments, line_end, &normals[normal++]))
+                return fail("invalid vertex normal");
+        }
+        else if (type == OBJ_LINE_FACE) {
+            face_positions.clear();
+            face_normals.clear();
+
+            bool has_normals = true;
+
+            for (const char *q = skip_spaces(arguments, line_end); q < line_end; q = skip_spaces(q, line_end)) {
+                long index;
+                uint32_t resolved;
+
+                q = parse_int(q, line_end, &index);
+
+                if (!q)
+                    return fail("invalid face vertex");
+
+                if (!resolve_index(index, position, chunk.total_positions, &resolved))
+                    return fail("face vertex index out of range");
+
+                face_positions.push_back(resolved);
+
+                long normal_index = 0;
+
+                /**
+                 * Texture coordinates are skipped.
+                 */
+                if (q < line_end && *q == '/') {
+                    q++;
+
+                    long texture_index;
+
+                    if (q < line_end && *q != '/' && !(q = parse_int(q, line_end, &texture_index)))
+                        return fail("invalid face texture coordinate index");
+
+                    if (q < line_end && *q == '/' && !(q = parse_int(q + 1, line_end, &normal_index)))
+                        return fail("invalid face normal index");
+                }
+
+                if (q < line_end && !is_space(*q))
+                    return fail("invalid face vertex");
+
+                if (normal_index) {
+                    if (!resolve_index(normal_index, normal, chunk.total_normals, &resolved))
+                        return fail("face normal index out of range");
+
+                    face_normals.push_back(resolved);
+                }
+                else {
+                    has_normals = false;
+                }
+            }
+
+            if (face_positions.size() < 3)
+                return fail("faces need at least three vertices");
+
+            for (size_t i = 1; i + 1 < face_positions.size(); i++) {
+                MeshTriangle triangle;
+                triangle.positions[0] = face_positions[0];
+                triangle.positions[1] = face_positions[i];
+                triangle.positions[2] = face_positions[i + 1];
+
+                triangle.normals[0] = has_normals ? face_normals[0] : MeshTriangle::no_normal;
+                triangle.normals[1] = has_normals ? face_normals[i] : MeshTriangle::no_normal;
+                triangle.normals[2] = has_normals ? face_normals[i + 1] : MeshTriangle::no_normal;
+
+                triangle.material = material;
+
+                chunk.triangles.push_back(triangle);
+            }
+        }
+        else if (keyword_length == 6 && memcmp(keyword, "usemtl", 6) == 0) {
+            std::string name = trim(arguments, line_end);
+
+            auto found = std::find(chunk.material_names.begin(), chunk.material_names.end(), name);
+
+            if (found == chunk.material_names.end() && chunk.material_names.size() >= inherited_material)
+                return fail("too many materials");
+
+            material = (MaterialHandle) (found - chunk.material_names.begin());
+
+            if (found == chunk.material_names.end())
+                chunk.material_names.push_back(name);
+        }
+        else if (keyword_length == 6 && memcmp(keyword, "mtllib", 6) == 0) {
+            std::istringstream names(trim(arguments, line_end));
+            std::string name;
+
+            while (names >> name) {
+                chunk.libraries.push_back(name);
+            }
+        }
+
+        /**
+         * Texture coordinates, groups, smoothing groups and the rest are ignored.
+         */
+    }
+
+    chunk.last_material = material;
+}
+
+bool ObjImporter::load_material_library(const std::string &file_name, std::vector<std::string> *names,
+                                        std::vector<Material> *materials)
+{
+    std::ifstream file(file_name);
+
+    if (!file.is_open()) {
+        std::cerr << "WARNING: Could not open material library " << file_name << "!" << std::endl;
+        return false;
+    }
+
+    std::string line;
+    Material *material = nullptr;
+    bool has_roughness = false;
+
+    while (std::getline(file, line)) {
+        std::istringstream tokens(line);
+        std::string keyword;
+
+        if (!(tokens >> keyword) || keyword[0] == '#')
+            continue;
+
+        if (keyword == "newmtl") {
+            std::string name;
+            std::getline(tokens, name);
+
+            names->push_back(trim(name.data(), name.data() + name.size()));
+            materials->push_back(Material());
+
+            material = &materials->back();
+            has_roughness = false;
+
+            continue;
+        }
+
+        if (!material)
+            continue;
+
+        if (keyword == "Kd") {
+            tokens >> material->albedo.x >> material->albedo.y >> material->albedo.z;
+        }
+        else if (keyword == "Pr") {
+            tokens >> material->roughness;
+            has_roughness = true;
+        }
+        else if (keyword == "Ns" && !has_roughness) {
+            float exponent = 0.0f;
+            tokens >> exponent;
+
+            material->roughness = std::min(1.0f, (float) sqrt(2.0 / (std::max(exponent, 0.0f) + 2.0)));
+        }
+        else if (keyword == "Pm") {
+            float metallic = 0.0f;
+            tokens >> metallic;
+
+            material->metallic = metallic >= 0.5f;
+        }
+        else if (keyword == "Ni") {
+            tokens >> material->ior;
+        }
+    }
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+bool ObjImporter::load(const std::string &file_name, Mesh *mesh, MaterialLibrary *library)
+{
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    int file = open(file_name.c_str(), O_RDONLY);
+
+    if (file < 0) {
+        std::cerr << "Could not open file " << file_name << " for reading!" << std::endl;
+        return false;
+    }
+
+    struct stat status;
+
+    if (fstat(file, &status) != 0 || status.st_size == 0) {
+        std::cerr << "ERROR: " << file_name << " is empty!" << std::endl;
+        close(file);
+        return false;
+    }
+
+    size_t size = (size_t) status.st_size;
+    void *mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+
+    close(file);
+
+    if (mapping == MAP_FAILED) {
+        std::cerr << "ERROR: Could not map " << file_name << "!" << std::endl;
+        return false;
+    }
+
+    madvise(mapping, size, MADV_SEQUENTIAL);
+
+    ThreadPool &thread_pool = ThreadPool::get_shared();
+
+    if (!thread_pool.initialize()) {
+        munmap(mapping, size);
+        return false;
+    }
+
+    /**
+     * Chunk boundaries are moved forward to the start of the next line.
+     */
+    const char *data = static_cast<const char *>(mapping);
+    const char *data_end = data + size;
+
+    size_t chunk_count = std::max((size_t) 1, size / chunk_size);
+    std::vector<Chunk> chunks(chunk_count);
+
+    const char *chunk_begin = data;
+
+    for (size_t i = 0; i < chunk_count; i++) {
+        const char *chunk_end = i + 1 == chunk_count ? data_end : data + size * (i + 1) / chunk_count;
+
+        if (chunk_end < chunk_begin)
+            chunk_end = chunk_begin;
+
+        if (chunk_end < data_end)
+            chunk_end = std::min(find_line_end(chunk_end, data_end) + 1, data_end);
+
+        chunks[i].begin = chunk_begin;
+        chunks[i].end = chunk_end;
+
+        chunk_begin = chunk_end;
+    }
+
+    std::vector<std::function<void()>> jobs;
+
+    for (Chunk &chunk : chunks) {
+        jobs.push_back([&chunk] { count_chunk(chunk); });
+    }
+
+    thread_pool.add_jobs(jobs);
+    thread_pool.wait();
+
+    size_t position_count = 0;
+    size_t normal_count = 0;
+    unsigned long line_count = 0;
+
+    for (Chunk &chunk : chunks) {
+        chunk.first_position = position_count;
+        chunk.first_normal = normal_count;
+        chunk.first_line = line_count + 1;
+
+        position_count += chunk.position_count;
+        normal_count += chunk.normal_count;
+        line_count += chunk.line_count;
+    }
+
+    std::vector<Vec3> positions(position_count);
+    std::vector<Vec3> normals(normal_count);
+
+    jobs.clear();
+
+    for (Chunk &chunk : chunks) {
+        chunk.total_positions = position_count;
+        chunk.total_normals = normal_count;
+
+        jobs.push_back([&chunk, &positions, &normals] { parse_chunk(chunk, positions, normals); });
+    }
+
+    thread_pool.add_jobs(jobs);
+    thread_pool.wait();
+
+    munmap(mapping, size);
+
+    double parse_time = duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0;
+
+    for (Chunk &chunk : chunks) {
+        if (!chunk.error.empty()) {
+            std::cerr << "ERROR: " << file_name << ":" << chunk.error_line << ": " << chunk.error << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<std::string> material_names;
+    std::vector<Material> materials;
+    std::vector<std::string> libraries;
+
+    std::string directory;
+    size_t separator = file_name.find_last_of('/');
+
+    if (separator != std::string::npos)
+        directory = file_name.substr(0, separator + 1);
+
+    for (Chunk &chunk : chunks) {
+        for (std::string &library : chunk.libraries) {
+            if (std::find(libraries.begin(), libraries.end(), library) != libraries.end())
+                continue;
+
+            libraries.push_back(library);
+            load_material_library(library[0] == '/' ? library : directory + library, &material_names, &materials);
+        }
+    }
+
+    /**
+     * Faces before any usemtl statement and with unknown material names get the mesh's material.
+     */
+    std::unordered_map<std::string, MaterialHandle> material_handles;
+
+    for (size_t i = 0; i < material_names.size(); i++) {
+        material_handles.emplace(material_names[i], library->add(materials[i]));
+    }
+
+    size_t triangle_count = 0;
+
+    for (Chunk &chunk : chunks) {
+        triangle_count += chunk.triangles.size();
+    }
+
+    if (!triangle_count) {
+        std::cerr << "ERROR: " << file_name << " has no faces!" << std::endl;
+        return false;
+    }
+
+    std::vector<MeshTriangle> triangles;
+    triangles.reserve(triangle_count);
+
+    MaterialHandle current_material = mesh->material;
+
+    for (Chunk &chunk : chunks) {
+        std::vector<MaterialHandle> chunk_materials;
+
+        for (std::string &name : chunk.material_names) {
+            auto found = material_handles.find(name);
+
+            if (found == material_handles.end()) {
+                std::cerr << "WARNING: " << file_name << ": unknown material " << name << std::endl;
+                material_handles.emplace(name, mesh->material);
+                chunk_materials.push_back(mesh->material);
+            }
+            else {
+                chunk_materials.push_back(found->second);
+            }
+        }
+
+        for (MeshTriangle &triangle : chunk.triangles) {
+            triangle.material = triangle.material == inherited_material ? current_material
+                                                                        : chunk_materials[triangle.material];
+        }
+
+        triangles.insert(triangles.end(), chunk.triangles.begin(), chunk.triangles.end());
+
+        if (chunk.last_material != inherited_material)
+            current_material = chunk_materials[chunk.last_material];
+
+        std::vector<MeshTriangle>().swap(chunk.triangles);
+    }
+
+    size_t vertex_count = positions.size();
+
+    high_resolution_clock::time_point bvh_start = high_resolution_clock::now();
+
+    mesh->set_geometry(positions, normals, triangles);
+
+    high_resolution_clock::time_point end = high_resolution_clock::now();
+
+    import_time = duration_cast<microseconds>(end - start).count() / 1000.0;
+
+    std::cout << "Imported " << file_name << ": " << vertex_count << " vertices, " << triangle_count
+              << " triangles, " << materials.size() << " materials. Parsed " << size / 1048576.0
+              << "MB in " << chunk_count << " chunks in " << parse_time << "ms ("
+              << size / (parse_time / 1000.0) / 1e9 << " GB/s), BVH built in "
+              << duration_cast<microseconds>(end - bvh_start).count() / 1000.0 << "ms" << std::endl;
+
+    return true;
+}
+
+double ObjImporter::get_import_time() const
+{
+    return import_time;
+}
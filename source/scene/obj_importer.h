@@ -0,0 +1,63 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_OBJ_IMPORTER_H
+#define HELIOS_OBJ_IMPORTER_H
+
+#include <string>
+#include <vector>
+#include <mesh.h>
+
+/**
+ * Wavefront OBJ importer. The file is mapped into memory and split into chunks at line
+ * boundaries, which are parsed in parallel in two passes: the first counts the vertices and lines
+ * of every chunk so that the second can write vertices straight to their final place, resolve
+ * relative indices and report errors with their line numbers. Faces are fan triangulated.
+ *
+ * MTL materials map onto Material as: Kd -> albedo, Pr -> roughness (or Ns converted with
+ * sqrt(2 / (Ns + 2)) when there is no Pr), Pm >= 0.5 -> metallic, Ni -> ior.
+ */
+class ObjImporter {
+private:
+    size_t chunk_size = 4 << 20;
+
+    double import_time = 0.0;
+
+    struct Chunk;
+
+    static void count_chunk(Chunk &chunk);
+
+    static void parse_chunk(Chunk &chunk, std::vector<Vec3> &positions, std::vector<Vec3> &normals);
+
+    static bool load_material_library(const std::string &file_name, std::vector<std::string> *names,
+                                      std::vector<Material> *materials);
+
+public:
+    /**
+     * Imports the OBJ file into the mesh and the materials of the MTL libraries it references
+     * into the material library. Faces without a material get the mesh's material.
+     */
+    bool load(const std::string &file_name, Mesh *mesh, MaterialLibrary *library);
+
+    /**
+     * Wall clock time of the last load() call in milliseconds.
+     */
+    double get_import_time() const;
+};
+
+#endif //HELIOS_OBJ_IMPORTER_H
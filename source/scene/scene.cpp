@@ -17,28 +17,67 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
 #include <iostream>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <chrono>
+#include <sphere_light.h>
+#include <rectangle_light.h>
 #include "scene.h"
+#include "scene_parser.h"
+#include "scene_cache.h"
+
+using namespace std::chrono;
+
+/**
+ * Slab test of a ray against a box, like the one the BVH applies to its nodes.
+ */
+static inline bool intersects(const Aabb &box, const Vec3 &origin, const Vec3 &inverse_direction,
+                              float max_distance)
+{
+    float tx0 = (box.min.x - origin.x) * inverse_direction.x;
+    float tx1 = (box.max.x - origin.x) * inverse_direction.x;
+    float ty0 = (box.min.y - origin.y) * inverse_direction.y;
+    float ty1 = (box.max.y - origin.y) * inverse_direction.y;
+    float tz0 = (box.min.z - origin.z) * inverse_direction.z;
+    float tz1 = (box.max.z - origin.z) * inverse_direction.z;
+
+    float t_near = std::max(std::max(std::min(tx0, tx1), std::min(ty0, ty1)), std::max(std::min(tz0, tz1), 0.0f));
+    float t_far = std::min(std::min(std::max(tx0, tx1), std::max(ty0, ty1)), std::min(std::max(tz0, tz1), max_distance));
+
+    return t_near <= t_far;
+}
 
 /* Private Functions -------------------------------------------------------- */
 
 void Scene::destroy_drawables()
 {
-    if(drawables.empty())
-        return;
-
-    for(Drawable *drawable : drawables) {
+    for(Drawable *drawable : allocated_drawables) {
         delete drawable;
     }
+
+    allocated_drawables.clear();
+    drawable_arena.clear();
+    drawables.clear();
 }
 
 void Scene::destroy_lights()
 {
-    if(lights.empty())
-        return;
-
-    for(Light *light : lights) {
+    for(Light *light : allocated_lights) {
         delete light;
     }
+
+    allocated_lights.clear();
+    light_arena.clear();
+    lights.clear();
+}
+
+void Scene::record_added_drawable()
+{
+    if (!(changes.types & SCENE_OBJECT_ADDED)) {
+        changes.types |= SCENE_OBJECT_ADDED;
+        changes.first_added_drawable = drawables.size();
+    }
 }
 
 /* -------------------------------------------------------------------------- */
@@ -47,6 +86,8 @@ Scene::~Scene()
 {
     destroy_lights();
     destroy_drawables();
+
+    delete cache;
 }
 
 void Scene::set_camera(const Camera &camera)
@@ -61,7 +102,16 @@ const Camera &Scene::get_camera() const
 
 void Scene::add_drawable(Drawable *drawable)
 {
+    if (cache) {
+        std::cerr << "ERROR: Drawables can't be added to a scene mapped from a scene cache!" << std::endl;
+        delete drawable;
+        return;
+    }
+
+    record_added_drawable();
     drawables.push_back(drawable);
+    allocated_drawables.push_back(drawable);
+    bvh_valid = false;
 }
 
 Drawable *Scene::get_drawable(unsigned int idx) const
@@ -75,9 +125,41 @@ Drawable *Scene::get_drawable(unsigned int idx) const
 }
 
 void Scene::set_drawables(const std::vector<Drawable *> &drawables)
+{
+    set_drawables(drawables, ObjectArena());
+    allocated_drawables = drawables;
+}
+
+void Scene::set_drawables(const std::vector<Drawable *> &drawables, ObjectArena &&arena)
 {
     destroy_drawables();
     this->drawables = drawables;
+    drawable_arena = std::move(arena);
+
+    /**
+     * The drawables replace the geometry of a mapped scene cache.
+     */
+    delete cache;
+    cache = nullptr;
+
+    bvh.clear();
+    bvh_valid = false;
+    drawable_bounds.clear();
+
+    /**
+     * The animation and the recorded edits refer to the replaced drawables by index.
+     */
+    animation.clear();
+
+    changes.types |= SCENE_OBJECT_ADDED;
+    changes.first_added_drawable = 0;
+    changes.moved_drawables.clear();
+    changes.moved_from.clear();
+    changes.material_drawables.clear();
+
+    unbounded_drawables.clear();
+    unbounded = nullptr;
+    unbounded_count = 0;
 }
 
 const std::vector<Drawable *> &Scene::get_drawables() const
@@ -90,9 +172,109 @@ unsigned long Scene::get_drawable_count() const
     return drawables.size();
 }
 
+bool Scene::move_drawable(uint32_t index, const Vec3 &position)
+{
+    if (index >= drawables.size()) {
+        std::cerr << "ERROR: There is no drawable " << index << " to move!" << std::endl;
+        return false;
+    }
+
+    Aabb bounds;
+
+    if (!drawables[index]->get_bounds(&bounds.min, &bounds.max))
+        bounds = Aabb();
+
+    drawables[index]->set_position(position);
+
+    changes.types |= SCENE_OBJECT_MOVED;
+    changes.moved_drawables.push_back(index);
+    changes.moved_from.push_back(bounds);
+
+    return true;
+}
+
+bool Scene::set_drawable_material(uint32_t index, MaterialHandle material)
+{
+    if (index >= drawables.size() || material >= material_library.get_materials().size()) {
+        std::cerr << "ERROR: Can't give drawable " << index << " material " << material << "!" << std::endl;
+        return false;
+    }
+
+    drawables[index]->set_material(material);
+
+    changes.types |= SCENE_MATERIAL_CHANGED;
+    changes.material_drawables.push_back(index);
+
+    return true;
+}
+
+bool Scene::set_material(MaterialHandle handle, const Material &material)
+{
+    if (handle >= material_library.get_materials().size()) {
+        std::cerr << "ERROR: There is no material " << handle << " to change!" << std::endl;
+        return false;
+    }
+
+    material_library.set(handle, material);
+
+    changes.types |= SCENE_MATERIAL_CHANGED;
+    changes.materials.push_back(handle);
+
+    return true;
+}
+
+bool Scene::move_light(uint32_t index, const Vec3 &position)
+{
+    if (index >= lights.size()) {
+        std::cerr << "ERROR: There is no light " << index << " to move!" << std::endl;
+        return false;
+    }
+
+    lights[index]->set_position(position);
+
+    changes.types |= SCENE_LIGHT_CHANGED;
+    changes.lights.push_back(index);
+
+    return true;
+}
+
+bool Scene::set_light_color(uint32_t index, const Vec3 &color)
+{
+    if (index >= lights.size()) {
+        std::cerr << "ERROR: There is no light " << index << " to change!" << std::endl;
+        return false;
+    }
+
+    lights[index]->set_color(color);
+
+    changes.types |= SCENE_LIGHT_CHANGED;
+    changes.lights.push_back(index);
+
+    return true;
+}
+
+const SceneChanges &Scene::get_changes() const
+{
+    return changes;
+}
+
+BvhUpdate Scene::commit_changes(SceneChanges *changes)
+{
+    BvhUpdate update = update_bvh(this->changes.moved_drawables);
+
+    *changes = std::move(this->changes);
+    this->changes = SceneChanges();
+
+    return update;
+}
+
 void Scene::add_light(Light *light)
 {
+    changes.types |= SCENE_LIGHT_CHANGED;
+    changes.lights.push_back((uint32_t) lights.size());
+
     lights.push_back(light);
+    allocated_lights.push_back(light);
 }
 
 Light *Scene::get_light(unsigned int index) const
@@ -106,9 +288,23 @@ Light *Scene::get_light(unsigned int index) const
 }
 
 void Scene::set_lights(const std::vector<Light *> &lights)
+{
+    set_lights(lights, ObjectArena());
+    allocated_lights = lights;
+}
+
+void Scene::set_lights(const std::vector<Light *> &lights, ObjectArena &&arena)
 {
     destroy_lights();
     this->lights = lights;
+    light_arena = std::move(arena);
+
+    changes.types |= SCENE_LIGHT_CHANGED;
+    changes.lights.clear();
+
+    for (uint32_t i = 0; i < lights.size(); i++) {
+        changes.lights.push_back(i);
+    }
 }
 
 const std::vector<Light *> &Scene::get_lights() const
@@ -121,7 +317,434 @@ unsigned long Scene::get_lights_count() const
     return lights.size();
 }
 
+MaterialLibrary &Scene::get_material_library()
+{
+    return material_library;
+}
+
+const MaterialLibrary &Scene::get_material_library() const
+{
+    return material_library;
+}
+
+void Scene::set_material_library(MaterialLibrary &&library)
+{
+    material_library = std::move(library);
+
+    changes.types |= SCENE_MATERIAL_CHANGED;
+    changes.materials.clear();
+
+    for (size_t i = 0; i < material_library.get_materials().size(); i++) {
+        changes.materials.push_back((MaterialHandle) i);
+    }
+}
+
+void Scene::add_mesh_reference(const MeshReference &mesh)
+{
+    mesh_references.push_back(mesh);
+}
+
+void Scene::set_mesh_references(const std::vector<MeshReference> &meshes)
+{
+    mesh_references = meshes;
+}
+
+const std::vector<MeshReference> &Scene::get_mesh_references() const
+{
+    return mesh_references;
+}
+
 bool Scene::load(std::string path)
 {
-    return false;
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    FILE *file = fopen(path.c_str(), "rb");
+
+    if (!file) {
+        std::cerr << "ERROR: Could not open scene file " << path << "!" << std::endl;
+        return false;
+    }
+
+    char magic[4] = {0};
+
+    if (fread(magic, 1, sizeof(magic), file) == sizeof(magic) && memcmp(magic, "HLSC", sizeof(magic)) == 0) {
+        fclose(file);
+        return load_cache(path);
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    /**
+     * The whole file is read in one go and tokenized in place.
+     */
+    std::vector<char> data((size_t) std::max(size, 0L));
+
+    bool read = size >= 0 && fread(data.data(), 1, data.size(), file) == data.size();
+    fclose(file);
+
+    if (!read) {
+        std::cerr << "ERROR: Could not read scene file " << path << "!" << std::endl;
+        return false;
+    }
+
+    SceneParser parser(path);
+
+    if (!parser.parse(data.data(), data.size(), this))
+        return false;
+
+    build_bvh();
+
+    std::cout << "Loaded " << path << ": " << drawables.size() << " drawables, " << lights.size() << " lights, "
+              << mesh_references.size() << " mesh references in "
+              << duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0 << "ms"
+              << std::endl;
+
+    return true;
+}
+
+void Scene::build_bvh()
+{
+    rebuild_bvh();
+
+    /**
+     * Renderers start from the scene as built, so there is nothing for them to update yet.
+     */
+    changes = SceneChanges();
+}
+
+void Scene::rebuild_bvh()
+{
+    if (cache)
+        return;
+
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    std::vector<uint32_t> bounded;
+
+    drawable_bounds.assign(drawables.size(), Aabb());
+    unbounded_drawables.clear();
+
+    for (uint32_t i = 0; i < drawables.size(); i++) {
+        if (drawables[i]->get_bounds(&drawable_bounds[i].min, &drawable_bounds[i].max))
+            bounded.push_back(i);
+        else
+            unbounded_drawables.push_back(i);
+    }
+
+    bvh.build(bounded, drawable_bounds);
+    bvh_build_cost = bvh.get_sah_cost();
+
+    unbounded = unbounded_drawables.data();
+    unbounded_count = unbounded_drawables.size();
+    unindexed_drawables = 0;
+
+    bvh_valid = true;
+
+    std::cout << "Built BVH over " << bounded.size() << " drawables (" << bvh.get_node_count() << " nodes) in "
+              << duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0 << "ms"
+              << std::endl;
+}
+
+BvhUpdate Scene::update_bvh(const std::vector<uint32_t> &moved)
+{
+    if (cache)
+        return BVH_REFITTED;
+
+    size_t indexed = drawable_bounds.size();
+
+    if (!indexed || indexed > drawables.size() ||
+        unindexed_drawables + (drawables.size() - indexed) > max_unindexed_drawables) {
+        rebuild_bvh();
+        return BVH_REBUILT;
+    }
+
+    /**
+     * Drawables added since the last build join the unbounded ones.
+     */
+    for (size_t i = indexed; i < drawables.size(); i++) {
+        Aabb bounds;
+
+        if (drawables[i]->get_bounds(&bounds.min, &bounds.max))
+            unindexed_drawables++;
+
+        drawable_bounds.push_back(bounds);
+        unbounded_drawables.push_back((uint32_t) i);
+    }
+
+    unbounded = unbounded_drawables.data();
+    unbounded_count = unbounded_drawables.size();
+    bvh_valid = true;
+
+    for (uint32_t index : moved) {
+        Aabb &bounds = drawable_bounds[index];
+
+        /**
+         * Unbounded drawables are tested against every ray wherever they are.
+         */
+        if (!drawables[index]->get_bounds(&bounds.min, &bounds.max))
+            bounds = Aabb();
+    }
+
+    if (moved.empty())
+        return BVH_REFITTED;
+
+    if (!bvh.refit(drawable_bounds) || bvh.get_sah_cost() > bvh_build_cost * bvh_rebuild_threshold) {
+        rebuild_bvh();
+        return BVH_REBUILT;
+    }
+
+    return BVH_REFITTED;
+}
+
+void Scene::set_bvh_rebuild_threshold(float threshold)
+{
+    bvh_rebuild_threshold = threshold;
+}
+
+bool Scene::is_bvh_valid() const
+{
+    return bvh_valid;
+}
+
+const Bvh &Scene::get_bvh() const
+{
+    return bvh;
+}
+
+const uint32_t *Scene::get_unbounded() const
+{
+    return unbounded;
+}
+
+size_t Scene::get_unbounded_count() const
+{
+    return unbounded_count;
+}
+
+Animation &Scene::get_animation()
+{
+    return animation;
+}
+
+const Animation &Scene::get_animation() const
+{
+    return animation;
+}
+
+void Scene::set_animation(const Animation &animation)
+{
+    this->animation = animation;
+}
+
+BvhUpdate Scene::set_time(float time)
+{
+    std::vector<uint32_t> moved;
+
+    animation.apply(drawables, time, &moved);
+
+    return update_bvh(moved);
+}
+
+unsigned long Scene::get_primitive_count() const
+{
+    return cache ? cache->get_primitive_count() : drawables.size();
+}
+
+bool Scene::intersect_primitive(uint32_t index, const Ray &ray, HitPoint *hit_point) const
+{
+    if (cache)
+        return cache->intersect(index, ray, hit_point);
+
+    Drawable *drawable = drawables[index];
+
+    if (!drawable->intersect(ray, hit_point))
+        return false;
+
+    /**
+     * Meshes report the material of the triangle that was hit.
+     */
+    if (hit_point->material == MaterialLibrary::no_material)
+        hit_point->material = drawable->material;
+
+    return true;
+}
+
+bool Scene::is_unindexed_missed(uint32_t index, const Ray &ray, const Vec3 &inverse_direction,
+                                float max_distance) const
+{
+    if (cache || index >= drawable_bounds.size())
+        return false;
+
+    const Aabb &bounds = drawable_bounds[index];
+
+    return bounds.min.x <= bounds.max.x && !intersects(bounds, ray.origin, inverse_direction, max_distance);
+}
+
+bool Scene::intersect(const Ray &ray, HitPoint *hit_point) const
+{
+    auto test = [&](uint32_t index, float *max_distance) {
+        HitPoint pt;
+
+        if (!intersect_primitive(index, ray, &pt) || pt.distance >= hit_point->distance)
+            return false;
+
+        *hit_point = pt;
+        hit_point->object_index = index;
+        *max_distance = (float) pt.distance;
+
+        return true;
+    };
+
+    float max_distance = (float) hit_point->distance;
+    bool hit = false;
+
+    if (unbounded_count) {
+        Vec3 inverse_direction(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+        for (size_t i = 0; i < unbounded_count; i++) {
+            if (!is_unindexed_missed(unbounded[i], ray, inverse_direction, max_distance))
+                hit |= test(unbounded[i], &max_distance);
+        }
+    }
+
+    return bvh.traverse(ray, max_distance, false, test) || hit;
+}
+
+long Scene::find_occluder(const Ray &ray, float max_distance) const
+{
+    long occluder = -1;
+
+    auto test = [&](uint32_t index, float *distance) {
+        HitPoint pt;
+
+        if (!intersect_primitive(index, ray, &pt) || pt.distance >= *distance)
+            return false;
+
+        occluder = index;
+
+        return true;
+    };
+
+    if (unbounded_count) {
+        Vec3 inverse_direction(1.0f / ray.direction.x, 1.0f / ray.direction.y, 1.0f / ray.direction.z);
+
+        for (size_t i = 0; i < unbounded_count; i++) {
+            if (!is_unindexed_missed(unbounded[i], ray, inverse_direction, max_distance) &&
+                test(unbounded[i], &max_distance))
+                return occluder;
+        }
+    }
+
+    bvh.traverse(ray, max_distance, true, test);
+
+    return occluder;
+}
+
+bool Scene::load_cache(const std::string &path)
+{
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    SceneCache *mapped = new SceneCache;
+
+    if (!mapped->map(path)) {
+        delete mapped;
+        return false;
+    }
+
+    const SceneCacheHeader &header = mapped->get_header();
+
+    std::vector<Light *> cached_lights;
+    ObjectArena cached_light_arena;
+    const SceneLightRecord *records = mapped->get_lights();
+
+    for (size_t i = 0; i < header.lights.count; i++) {
+        const SceneLightRecord &record = records[i];
+
+        Vec3 position(record.position[0], record.position[1], record.position[2]);
+        Vec3 color(record.color[0], record.color[1], record.color[2]);
+
+        Light *light;
+
+        if (record.type == SCENE_LIGHT_SPHERE) {
+            light = cached_light_arena.create<SphereLight>(position, record.data[0], color);
+        }
+        else if (record.type == SCENE_LIGHT_RECTANGLE) {
+            light = cached_light_arena.create<RectangleLight>(
+                    position, Vec3(record.data[0], record.data[1], record.data[2]),
+                    Vec3(record.data[3], record.data[4], record.data[5]), color);
+        }
+        else {
+            light = cached_light_arena.create<Light>(position, color);
+        }
+
+        light->set_samples(record.samples);
+        cached_lights.push_back(light);
+    }
+
+    std::vector<MeshReference> meshes;
+    const SceneMeshRecord *mesh_records = mapped->get_meshes();
+
+    for (size_t i = 0; i < header.meshes.count; i++) {
+        MeshReference mesh;
+        mesh.path = mapped->get_string(mesh_records[i].path_offset, mesh_records[i].path_length);
+        mesh.material = (MaterialHandle) mesh_records[i].material;
+
+        meshes.push_back(mesh);
+    }
+
+    Camera cached_camera;
+    cached_camera.set_position(Vec3(header.camera_position[0], header.camera_position[1], header.camera_position[2]));
+    cached_camera.set_target(Vec3(header.camera_target[0], header.camera_target[1], header.camera_target[2]));
+    cached_camera.set_fov(header.camera_fov, Camera::CAM_FOV_RADIANS);
+    cached_camera.set_type((Camera::CameraType) header.camera_type);
+    cached_camera.set_aperture(header.camera_aperture);
+    cached_camera.set_focus_distance(header.camera_focus_distance);
+    cached_camera.set_up(Vec3(header.camera_up[0], header.camera_up[1], header.camera_up[2]));
+    cached_camera.set_orthographic_height(header.camera_orthographic_height);
+
+    set_drawables(std::vector<Drawable *>());
+    set_lights(cached_lights, std::move(cached_light_arena));
+    set_mesh_references(meshes);
+    set_camera(cached_camera);
+
+    material_library.set_materials(mapped->get_materials(), (size_t) header.materials.count);
+
+    cache = mapped;
+
+    bvh.map(mapped->get_bvh_nodes(), (size_t) header.bvh_nodes.count, mapped->get_bvh_indices(),
+            (size_t) header.bvh_indices.count);
+
+    unbounded = mapped->get_unbounded();
+    unbounded_count = mapped->get_unbounded_count();
+    bvh_valid = true;
+
+    changes = SceneChanges();
+
+    std::cout << "Mapped scene cache " << path << ": " << header.primitives.count << " primitives, "
+              << header.bvh_nodes.count << " BVH nodes, " << lights.size() << " lights in "
+              << duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0 << "ms"
+              << std::endl;
+
+    return true;
+}
+
+bool Scene::save_cache(const std::string &path) const
+{
+    if (cache) {
+        std::cerr << "ERROR: The scene is already mapped from a scene cache!" << std::endl;
+        return false;
+    }
+
+    high_resolution_clock::time_point start = high_resolution_clock::now();
+
+    if (!SceneCache::write(path, *this))
+        return false;
+
+    std::cout << "Wrote scene cache " << path << " in "
+              << duration_cast<microseconds>(high_resolution_clock::now() - start).count() / 1000.0 << "ms"
+              << std::endl;
+
+    return true;
 }
@@ -20,12 +20,71 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #define HELIOS_SCENE_H
 
 #include <vector>
+#include <iostream>
 #include <object.h>
 #include <string>
 #include <camera.h>
 #include <drawable.h>
 #include <light.h>
+#include <bvh.h>
+#include <object_arena.h>
+#include <material_library.h>
+#include "animation.h"
 
+class SceneCache;
+
+enum BvhUpdate {
+    BVH_REFITTED,
+    BVH_REBUILT
+};
+
+enum SceneChangeType {
+    SCENE_OBJECT_ADDED = 1 << 0,
+    SCENE_OBJECT_MOVED = 1 << 1,
+    SCENE_MATERIAL_CHANGED = 1 << 2,
+    SCENE_LIGHT_CHANGED = 1 << 3
+};
+
+/**
+ * Edits made to a scene, see Scene::commit_changes(). Drawables and lights are referred to by
+ * index. Drawables from first_added_drawable on were added.
+ */
+struct SceneChanges {
+    unsigned int types = 0;
+
+    size_t first_added_drawable = 0;
+
+    std::vector<uint32_t> moved_drawables;
+
+    /**
+     * Bounds of every moved drawable before its move, empty for unbounded drawables.
+     */
+    std::vector<Aabb> moved_from;
+
+    /**
+     * Drawables that were given another material.
+     */
+    std::vector<uint32_t> material_drawables;
+
+    /**
+     * Library materials that were edited.
+     */
+    std::vector<MaterialHandle> materials;
+
+    std::vector<uint32_t> lights;
+};
+
+/**
+ * A mesh file referenced by a scene description. The material replaces the materials of the
+ * mesh file when material_override is set.
+ */
+struct MeshReference {
+    std::string path;
+
+    MaterialHandle material = MaterialLibrary::default_material;
+
+    bool material_override = false;
+};
 
 class Scene {
 private:
@@ -35,39 +94,310 @@ private:
 
     std::vector<Light *> lights;
 
+    /**
+     * Drawables and lights created by the scene are stored in the arenas and freed in bulk, the
+     * ones added with new are deleted one by one.
+     */
+    ObjectArena drawable_arena;
+
+    ObjectArena light_arena;
+
+    std::vector<Drawable *> allocated_drawables;
+
+    std::vector<Light *> allocated_lights;
+
+    std::vector<MeshReference> mesh_references;
+
+    MaterialLibrary material_library;
+
+    /**
+     * Drawables with bounds are found through the BVH, the rest are tested against every ray.
+     */
+    Bvh bvh;
+
+    bool bvh_valid = false;
+
+    /**
+     * Bounds of the drawables by index, kept for refitting the BVH.
+     */
+    std::vector<Aabb> drawable_bounds;
+
+    float bvh_build_cost = 0.0f;
+
+    float bvh_rebuild_threshold = 1.5f;
+
+    Animation animation;
+
+    /**
+     * Edits since the last commit_changes() or build_bvh().
+     */
+    SceneChanges changes;
+
+    /**
+     * Drawables added after the BVH was built are tested against every ray along with the
+     * unbounded ones, up to this many before the BVH is rebuilt.
+     */
+    static const size_t max_unindexed_drawables = 32;
+
+    size_t unindexed_drawables = 0;
+
+    std::vector<uint32_t> unbounded_drawables;
+
+    const uint32_t *unbounded = nullptr;
+
+    size_t unbounded_count = 0;
+
+    /**
+     * Mapped scene cache holding the geometry instead of the drawables, nullptr if there is none.
+     */
+    SceneCache *cache = nullptr;
+
     void destroy_drawables();
 
     void destroy_lights();
 
+    void record_added_drawable();
+
+    /**
+     * build_bvh() without discarding the recorded changes, for updates of a scene being rendered.
+     */
+    void rebuild_bvh();
+
+    /**
+     * Whether a ray misses the bounds of an added drawable that is not in the BVH yet, so drawables
+     * waiting for a rebuild are culled as if they were indexed.
+     */
+    bool is_unindexed_missed(uint32_t index, const Ray &ray, const Vec3 &inverse_direction,
+                             float max_distance) const;
+
 public:
 
+    Scene() = default;
+
+    Scene(const Scene &) = delete;
+
+    Scene &operator=(const Scene &) = delete;
+
     ~Scene();
 
     void set_camera(const Camera &camera);
 
     const Camera &get_camera() const;
 
+    /**
+     * Adds a drawable allocated with new, which the scene deletes.
+     */
     void add_drawable(Drawable *object);
 
+    /**
+     * Constructs a drawable in the scene's arena and adds it. Returns nullptr for a scene mapped
+     * from a scene cache.
+     */
+    template<typename T, typename... Arguments>
+    T *create_drawable(Arguments &&... arguments);
+
+    /**
+     * Constructs count drawables next to each other in the scene's arena and adds them in order.
+     * construct(storage) has to construct all of them with placement new, see ObjectArena.
+     */
+    template<typename T, typename Constructor>
+    T *create_drawables(size_t count, Constructor construct);
+
     Drawable *get_drawable(unsigned int index) const;
 
     void set_drawables(const std::vector<Drawable *> &objects);
 
+    /**
+     * Replaces the drawables with ones allocated from the arena, which the scene takes over.
+     */
+    void set_drawables(const std::vector<Drawable *> &objects, ObjectArena &&arena);
+
     const std::vector<Drawable *> &get_drawables() const;
 
     unsigned long get_drawable_count() const;
 
+    /**
+     * Change tracked edits, see commit_changes().
+     */
+    bool move_drawable(uint32_t index, const Vec3 &position);
+
+    bool set_drawable_material(uint32_t index, MaterialHandle material);
+
+    bool set_material(MaterialHandle handle, const Material &material);
+
+    bool move_light(uint32_t index, const Vec3 &position);
+
+    bool set_light_color(uint32_t index, const Vec3 &color);
+
+    const SceneChanges &get_changes() const;
+
+    /**
+     * Brings the BVH up to date with the edits made since the last call and hands them over in
+     * changes, to be passed to RayTracer::invalidate(). Moved drawables are refitted and added
+     * ones are kept out of the BVH until there are too many of them, see update_bvh().
+     */
+    BvhUpdate commit_changes(SceneChanges *changes);
+
     void add_light(Light *light);
 
+    template<typename T, typename... Arguments>
+    T *create_light(Arguments &&... arguments);
+
     Light *get_light(unsigned int index) const;
 
     void set_lights(const std::vector<Light *> &lights);
 
+    void set_lights(const std::vector<Light *> &lights, ObjectArena &&arena);
+
     const std::vector<Light *> &get_lights() const;
 
     unsigned long get_lights_count() const;
 
+    MaterialLibrary &get_material_library();
+
+    const MaterialLibrary &get_material_library() const;
+
+    /**
+     * Replaces the materials the drawables' handles refer to.
+     */
+    void set_material_library(MaterialLibrary &&library);
+
+    /**
+     * Material of a hit point's handle.
+     */
+    const Material &get_material(MaterialHandle handle) const
+    {
+        return material_library.get(handle);
+    }
+
+    void add_mesh_reference(const MeshReference &mesh);
+
+    void set_mesh_references(const std::vector<MeshReference> &meshes);
+
+    const std::vector<MeshReference> &get_mesh_references() const;
+
+    /**
+     * Builds the BVH over the drawables. Has to be called after changing them and before
+     * rendering. Discards the recorded changes, the built scene is what renderers start from;
+     * edits to a scene being rendered go through commit_changes() instead.
+     */
+    void build_bvh();
+
+    /**
+     * Updates the BVH after the drawables with the given indices moved. The BVH is refitted bottom
+     * up, and rebuilt instead once refitting has made its SAH cost more than the rebuild threshold
+     * times the cost after the last build, or when the drawables were replaced. Drawables added
+     * since the last build are tested against every ray until there are more than
+     * max_unindexed_drawables of them.
+     */
+    BvhUpdate update_bvh(const std::vector<uint32_t> &moved);
+
+    void set_bvh_rebuild_threshold(float threshold);
+
+    bool is_bvh_valid() const;
+
+    const Bvh &get_bvh() const;
+
+    const uint32_t *get_unbounded() const;
+
+    size_t get_unbounded_count() const;
+
+    Animation &get_animation();
+
+    void set_animation(const Animation &animation);
+
+    const Animation &get_animation() const;
+
+    /**
+     * Moves the animated drawables to their positions at the given time and updates the BVH.
+     */
+    BvhUpdate set_time(float time);
+
+    /**
+     * Number of drawables, or of primitives of a mapped scene cache.
+     */
+    unsigned long get_primitive_count() const;
+
+    bool intersect_primitive(uint32_t index, const Ray &ray, HitPoint *hit_point) const;
+
+    /**
+     * Finds the nearest hit closer than the hit point's distance, setting its material and object index.
+     */
+    bool intersect(const Ray &ray, HitPoint *hit_point) const;
+
+    /**
+     * Index of any primitive hit before max_distance, or -1.
+     */
+    long find_occluder(const Ray &ray, float max_distance) const;
+
+    /**
+     * Replaces the scene with the contents of a scene description file, or maps it if it is a
+     * scene cache. See scene_parser.h for the text format. A failed load leaves the scene
+     * untouched.
+     */
     bool load(std::string path);
+
+    /**
+     * Maps a scene cache written by save_cache(). The scene's geometry is read from the mapping
+     * and can't be changed while it is used.
+     */
+    bool load_cache(const std::string &path);
+
+    bool save_cache(const std::string &path) const;
 };
 
+template<typename T, typename... Arguments>
+T *Scene::create_drawable(Arguments &&... arguments)
+{
+    if (cache) {
+        std::cerr << "ERROR: Drawables can't be added to a scene mapped from a scene cache!" << std::endl;
+        return nullptr;
+    }
+
+    T *drawable = drawable_arena.create<T>(std::forward<Arguments>(arguments)...);
+
+    record_added_drawable();
+    drawables.push_back(drawable);
+    bvh_valid = false;
+
+    return drawable;
+}
+
+template<typename T, typename Constructor>
+T *Scene::create_drawables(size_t count, Constructor construct)
+{
+    if (cache) {
+        std::cerr << "ERROR: Drawables can't be added to a scene mapped from a scene cache!" << std::endl;
+        return nullptr;
+    }
+
+    T *objects = drawable_arena.create_array<T>(count, construct);
+
+    record_added_drawable();
+
+    size_t first = drawables.size();
+    drawables.resize(first + count);
+
+    for (size_t i = 0; i < count; i++) {
+        drawables[first + i] = objects + i;
+    }
+
+    bvh_valid = false;
+
+    return objects;
+}
+
+template<typename T, typename... Arguments>
+T *Scene::create_light(Arguments &&... arguments)
+{
+    T *light = light_arena.create<T>(std::forward<Arguments>(arguments)...);
+
+    changes.types |= SCENE_LIGHT_CHANGED;
+    changes.lights.push_back((uint32_t) lights.size());
+
+    lights.push_back(light);
+
+    return light;
+}
+
 #endif //HELIOS_SCENE_H
@@ -0,0 +1,490 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstdio>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sphere.h>
+#include <box.h>
+#include <plane.h>
+#include <sphere_light.h>
+#include <rectangle_light.h>
+#include "scene.h"
+#include "scene_cache.h"
+
+static const char magic[4] = {'H', 'L', 'S', 'C'};
+static const uint32_t byte_order = 0x01020304;
+
+/**
+ * Sections start at cache line boundaries.
+ */
+static const uint64_t section_alignment = 64;
+
+static uint64_t align_offset(uint64_t offset)
+{
+    return (offset + section_alignment - 1) & ~(section_alignment - 1);
+}
+
+static void copy_vec3(float *destination, const Vec3 &vec)
+{
+    destination[0] = vec.x;
+    destination[1] = vec.y;
+    destination[2] = vec.z;
+}
+
+/**
+ * Collects the arrays of a cache file and lays them out one after the other.
+ */
+struct SectionWriter {
+    std::vector<std::pair<const void *, uint64_t>> blocks;
+
+    uint64_t offset = sizeof(SceneCacheHeader);
+
+    template<typename T>
+    SceneCacheSection add(const T *data, size_t count)
+    {
+        SceneCacheSection section;
+        section.offset = align_offset(offset);
+        section.count = count;
+
+        offset = section.offset + count * sizeof(T);
+        blocks.push_back(std::make_pair((const void *) data, (uint64_t) (count * sizeof(T))));
+
+        return section;
+    }
+};
+
+/* Private Functions -------------------------------------------------------- */
+
+template<typename T>
+const T *SceneCache::section(const SceneCacheSection &section) const
+{
+    return reinterpret_cast<const T *>(static_cast<const char *>(mapping) + section.offset);
+}
+
+template<typename T>
+bool SceneCache::check_section(const SceneCacheSection &section) const
+{
+    return section.offset % alignof(T) == 0 && section.offset <= size &&
+           section.count <= (size - section.offset) / sizeof(T);
+}
+
+bool SceneCache::check_contents() const
+{
+    const uint64_t material_count = header->materials.count;
+    const uint64_t primitive_count = header->primitives.count;
+    const uint64_t node_count = header->bvh_nodes.count;
+    const uint64_t index_count = header->bvh_indices.count;
+
+    const ScenePrimitive *primitives = get_primitives();
+
+    for (uint64_t i = 0; i < primitive_count; i++) {
+        if (primitives[i].type > SCENE_PRIMITIVE_PLANE || primitives[i].material >= material_count)
+            return false;
+    }
+
+    const uint32_t *unbounded = get_unbounded();
+
+    for (uint64_t i = 0; i < header->unbounded.count; i++) {
+        if (unbounded[i] >= primitive_count)
+            return false;
+    }
+
+    const uint32_t *indices = get_bvh_indices();
+
+    for (uint64_t i = 0; i < index_count; i++) {
+        if (indices[i] >= primitive_count)
+            return false;
+    }
+
+    /**
+     * The first child of an inner node is the next node, so the second one has to come after it.
+     */
+    const BvhNode *nodes = get_bvh_nodes();
+
+    for (uint64_t i = 0; i < node_count; i++) {
+        if (nodes[i].count > 0) {
+            if (nodes[i].offset > index_count || nodes[i].count > index_count - nodes[i].offset)
+                return false;
+        }
+        else if (i + 1 >= node_count || nodes[i].offset <= i + 1 || nodes[i].offset >= node_count) {
+            return false;
+        }
+    }
+
+    const SceneLightRecord *lights = get_lights();
+
+    for (uint64_t i = 0; i < header->lights.count; i++) {
+        if (lights[i].type > SCENE_LIGHT_RECTANGLE)
+            return false;
+    }
+
+    /**
+     * Mesh triangles are not stored in the cache, the OBJ importer reads them again from the path.
+     */
+    const SceneMeshRecord *meshes = get_meshes();
+
+    for (uint64_t i = 0; i < header->meshes.count; i++) {
+        if (meshes[i].material >= material_count || meshes[i].path_offset > header->strings.count ||
+            meshes[i].path_length > header->strings.count - meshes[i].path_offset)
+            return false;
+    }
+
+    return true;
+}
+
+/* -------------------------------------------------------------------------- */
+
+SceneCache::~SceneCache()
+{
+    unmap();
+}
+
+bool SceneCache::write(const std::string &file_name, const Scene &scene)
+{
+    if (!scene.is_bvh_valid()) {
+        std::cerr << "ERROR: The scene's BVH has to be built before writing a scene cache!" << std::endl;
+        return false;
+    }
+
+    /**
+     * The material library is stored as it is, so material handles stay valid.
+     */
+    const std::vector<Material> &library = scene.get_material_library().get_materials();
+    std::vector<Material> materials(library.size());
+
+    for (size_t i = 0; i < library.size(); i++) {
+        /**
+         * Zeroed so padding bytes don't leak into the file.
+         */
+        Material &stored = materials[i];
+        memset((void *) &stored, 0, sizeof(stored));
+        stored.albedo = library[i].albedo;
+        stored.roughness = library[i].roughness;
+        stored.ior = library[i].ior;
+        stored.metallic = library[i].metallic;
+        stored.shading_model = library[i].shading_model;
+    }
+
+    const std::vector<Drawable *> &drawables = scene.get_drawables();
+    std::vector<ScenePrimitive> primitives(drawables.size());
+
+    for (size_t i = 0; i < drawables.size(); i++) {
+        Drawable *drawable = drawables[i];
+        ScenePrimitive &primitive = primitives[i];
+
+        memset(&primitive, 0, sizeof(primitive));
+        copy_vec3(primitive.data, drawable->get_position());
+        primitive.material = drawable->material;
+
+        if (Sphere *sphere = dynamic_cast<Sphere *>(drawable)) {
+            primitive.type = SCENE_PRIMITIVE_SPHERE;
+            primitive.data[3] = sphere->get_radius();
+        }
+        else if (Box *box = dynamic_cast<Box *>(drawable)) {
+            primitive.type = SCENE_PRIMITIVE_BOX;
+            copy_vec3(primitive.data + 3, box->get_size());
+        }
+        else if (Plane *plane = dynamic_cast<Plane *>(drawable)) {
+            primitive.type = SCENE_PRIMITIVE_PLANE;
+            copy_vec3(primitive.data + 3, plane->get_normal());
+        }
+        else {
+            std::cerr << "ERROR: Drawable " << i << " has a type scene caches can't hold!" << std::endl;
+            return false;
+        }
+    }
+
+    const std::vector<Light *> &lights = scene.get_lights();
+    std::vector<SceneLightRecord> light_records(lights.size());
+
+    for (size_t i = 0; i < lights.size(); i++) {
+        Light *light = lights[i];
+        SceneLightRecord &record = light_records[i];
+
+        memset(&record, 0, sizeof(record));
+        record.type = SCENE_LIGHT_POINT;
+        record.samples = light->get_samples();
+        copy_vec3(record.position, light->get_position());
+        copy_vec3(record.color, light->get_color());
+
+        if (SphereLight *sphere_light = dynamic_cast<SphereLight *>(light)) {
+            record.type = SCENE_LIGHT_SPHERE;
+            record.data[0] = sphere_light->get_radius();
+        }
+        else if (RectangleLight *rectangle_light = dynamic_cast<RectangleLight *>(light)) {
+            record.type = SCENE_LIGHT_RECTANGLE;
+            copy_vec3(record.data, rectangle_light->get_edge_u());
+            copy_vec3(record.data + 3, rectangle_light->get_edge_v());
+        }
+    }
+
+    std::string strings;
+    std::vector<SceneMeshRecord> meshes;
+
+    for (const MeshReference &mesh : scene.get_mesh_references()) {
+        SceneMeshRecord record;
+        record.path_offset = strings.size();
+        record.path_length = (uint32_t) mesh.path.size();
+        record.material = mesh.material;
+
+        strings += mesh.path;
+        meshes.push_back(record);
+    }
+
+    const Camera &camera = scene.get_camera();
+    const Bvh &bvh = scene.get_bvh();
+
+    SceneCacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, magic, sizeof(magic));
+
+    header.version = version;
+    header.byte_order = byte_order;
+    header.header_size = sizeof(SceneCacheHeader);
+    header.material_size = sizeof(Material);
+
+    copy_vec3(header.camera_position, camera.get_position());
+    copy_vec3(header.camera_target, camera.get_target());
+    header.camera_fov = camera.get_fov();
+    header.camera_type = (uint32_t) camera.get_type();
+    header.camera_aperture = camera.get_aperture();
+    header.camera_focus_distance = camera.get_focus_distance();
+    copy_vec3(header.camera_up, camera.get_up());
+    header.camera_orthographic_height = camera.get_orthographic_height();
+
+    SectionWriter sections;
+
+    header.materials = sections.add(materials.data(), materials.size());
+    header.primitives = sections.add(primitives.data(), primitives.size());
+    header.unbounded = sections.add(scene.get_unbounded(), scene.get_unbounded_count());
+    header.bvh_nodes = sections.add(bvh.get_nodes(), bvh.get_node_count());
+    header.bvh_indices = sections.add(bvh.get_indices(), bvh.get_index_count());
+    header.lights = sections.add(light_records.data(), light_records.size());
+    header.meshes = sections.add(meshes.data(), meshes.size());
+    header.strings = sections.add(strings.data(), strings.size());
+    header.file_size = sections.offset;
+
+    std::string temporary_name = file_name + ".tmp";
+
+    FILE *file = fopen(temporary_name.c_str(), "wb");
+
+    if (!file) {
+        std::cerr << "Could not open file " << temporary_name << " for writing!" << std::endl;
+        return false;
+    }
+
+    bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    uint64_t position = sizeof(header);
+    static const char zeros[section_alignment] = {0};
+
+    for (auto &block : sections.blocks) {
+        uint64_t start = align_offset(position);
+
+        written = written && fwrite(zeros, 1, start - position, file) == start - position;
+        written = written && fwrite(block.first, 1, block.second, file) == block.second;
+
+        position = start + block.second;
+    }
+
+    /**
+     * Sync before renaming, otherwise a crash can leave the new name pointing at unwritten data.
+     */
+    written = written && fflush(file) == 0 && fsync(fileno(file)) == 0;
+    written = fclose(file) == 0 && written;
+
+    if (!written || std::rename(temporary_name.c_str(), file_name.c_str()) != 0) {
+        std::cerr << "Failed writing scene cache " << file_name << "!" << std::endl;
+        std::remove(temporary_name.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool SceneCache::map(const std::string &file_name)
+{
+    unmap();
+
+    int file = open(file_name.c_str(), O_RDONLY);
+
+    if (file < 0) {
+        std::cerr << "Could not open file " << file_name << " for reading!" << std::endl;
+        return false;
+    }
+
+    struct stat status;
+
+    if (fstat(file, &status) != 0 || status.st_size < (off_t) sizeof(SceneCacheHeader)) {
+        std::cerr << "ERROR: " << file_name << " is not a valid scene cache!" << std::endl;
+        close(file);
+        return false;
+    }
+
+    size = (size_t) status.st_size;
+    mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+
+    /**
+     * The mapping stays valid after the descriptor is closed.
+     */
+    close(file);
+
+    if (mapping == MAP_FAILED) {
+        std::cerr << "ERROR: Could not map scene cache " << file_name << "!" << std::endl;
+        mapping = nullptr;
+        size = 0;
+        return false;
+    }
+
+    header = static_cast<const SceneCacheHeader *>(mapping);
+
+    if (memcmp(header->magic, magic, sizeof(magic)) != 0 || header->byte_order != byte_order) {
+        std::cerr << "ERROR: " << file_name << " is not a valid scene cache!" << std::endl;
+        unmap();
+        return false;
+    }
+
+    if (header->version != version || header->header_size != sizeof(SceneCacheHeader) ||
+        header->material_size != sizeof(Material)) {
+        std::cerr << "ERROR: Scene cache " << file_name << " was written by a different version, rebuild it!"
+                  << std::endl;
+        unmap();
+        return false;
+    }
+
+    bool valid = header->file_size == size && header->camera_type <= Camera::CAM_EQUIRECTANGULAR &&
+                 check_section<Material>(header->materials) &&
+                 header->materials.count > 0 && header->materials.count < MaterialLibrary::no_material &&
+                 check_section<ScenePrimitive>(header->primitives) &&
+                 check_section<uint32_t>(header->unbounded) &&
+                 check_section<BvhNode>(header->bvh_nodes) &&
+                 check_section<uint32_t>(header->bvh_indices) &&
+                 check_section<SceneLightRecord>(header->lights) &&
+                 check_section<SceneMeshRecord>(header->meshes) &&
+                 check_section<char>(header->strings) && check_contents();
+
+    if (!valid) {
+        std::cerr << "ERROR: Scene cache " << file_name << " is truncated or corrupt!" << std::endl;
+        unmap();
+        return false;
+    }
+
+    return true;
+}
+
+void SceneCache::unmap()
+{
+    if (mapping)
+        munmap(mapping, size);
+
+    mapping = nullptr;
+    header = nullptr;
+    size = 0;
+}
+
+const SceneCacheHeader &SceneCache::get_header() const
+{
+    return *header;
+}
+
+const Material *SceneCache::get_materials() const
+{
+    return section<Material>(header->materials);
+}
+
+const ScenePrimitive *SceneCache::get_primitives() const
+{
+    return section<ScenePrimitive>(header->primitives);
+}
+
+size_t SceneCache::get_primitive_count() const
+{
+    return (size_t) header->primitives.count;
+}
+
+const uint32_t *SceneCache::get_unbounded() const
+{
+    return section<uint32_t>(header->unbounded);
+}
+
+size_t SceneCache::get_unbounded_count() const
+{
+    return (size_t) header->unbounded.count;
+}
+
+const BvhNode *SceneCache::get_bvh_nodes() const
+{
+    return section<BvhNode>(header->bvh_nodes);
+}
+
+const uint32_t *SceneCache::get_bvh_indices() const
+{
+    return section<uint32_t>(header->bvh_indices);
+}
+
+const SceneLightRecord *SceneCache::get_lights() const
+{
+    return section<SceneLightRecord>(header->lights);
+}
+
+const SceneMeshRecord *SceneCache::get_meshes() const
+{
+    return section<SceneMeshRecord>(header->meshes);
+}
+
+std::string SceneCache::get_string(uint64_t offset, uint32_t length) const
+{
+    if (offset > header->strings.count || length > header->strings.count - offset)
+        return std::string();
+
+    return std::string(section<char>(header->strings) + offset, length);
+}
+
+bool SceneCache::intersect(uint32_t index, const Ray &ray, HitPoint *hit_point) const
+{
+    const ScenePrimitive &primitive = get_primitives()[index];
+
+    Vec3 position(primitive.data[0], primitive.data[1], primitive.data[2]);
+    bool hit;
+
+    switch (primitive.type) {
+        case SCENE_PRIMITIVE_SPHERE:
+            hit = Sphere::intersect(position, primitive.data[3], ray, hit_point);
+            break;
+        case SCENE_PRIMITIVE_BOX:
+            hit = Box::intersect(position, Vec3(primitive.data[3], primitive.data[4], primitive.data[5]), ray,
+                                 hit_point);
+            break;
+        case SCENE_PRIMITIVE_PLANE:
+            hit = Plane::intersect(position, Vec3(primitive.data[3], primitive.data[4], primitive.data[5]), ray,
+                                   hit_point);
+            break;
+        default:
+            hit = false;
+    }
+
+    if (hit)
+        hit_point->material = (MaterialHandle) primitive.material;
+
+    return hit;
+}
@@ -0,0 +1,222 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_SCENE_CACHE_H
+#define HELIOS_SCENE_CACHE_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <material.h>
+#include <bvh.h>
+
+class Scene;
+
+enum ScenePrimitiveType : uint32_t {
+    SCENE_PRIMITIVE_SPHERE,
+    SCENE_PRIMITIVE_BOX,
+    SCENE_PRIMITIVE_PLANE
+};
+
+/**
+ * Spheres hold their position and radius, boxes their position and size, planes their position
+ * and normal.
+ */
+struct ScenePrimitive {
+    uint32_t type;
+
+    uint32_t material;
+
+    float data[6];
+};
+
+enum SceneLightType : uint32_t {
+    SCENE_LIGHT_POINT,
+    SCENE_LIGHT_SPHERE,
+    SCENE_LIGHT_RECTANGLE
+};
+
+/**
+ * Sphere lights hold their radius in data[0], rectangle lights their two edges.
+ */
+struct SceneLightRecord {
+    uint32_t type;
+
+    uint32_t samples;
+
+    float position[3];
+
+    float color[3];
+
+    float data[6];
+};
+
+struct SceneMeshRecord {
+    uint64_t path_offset;
+
+    uint32_t path_length;
+
+    uint32_t material;
+};
+
+/**
+ * Offset from the start of the file and element count of one array.
+ */
+struct SceneCacheSection {
+    uint64_t offset;
+
+    uint64_t count;
+};
+
+struct SceneCacheHeader {
+    char magic[4];
+
+    uint32_t version;
+
+    /**
+     * Written as 0x01020304 so caches are only mapped on hosts of the same byte order.
+     */
+    uint32_t byte_order;
+
+    uint32_t header_size;
+
+    /**
+     * Materials are stored as they are laid out in memory.
+     */
+    uint32_t material_size;
+
+    uint32_t padding;
+
+    uint64_t file_size;
+
+    float camera_position[4];
+
+    float camera_target[4];
+
+    float camera_fov;
+
+    /**
+     * Camera::CameraType.
+     */
+    uint32_t camera_type;
+
+    float camera_aperture;
+
+    float camera_focus_distance;
+
+    float camera_up[4];
+
+    float camera_orthographic_height;
+
+    uint32_t camera_padding[3];
+
+    SceneCacheSection materials;
+
+    SceneCacheSection primitives;
+
+    /**
+     * Indices of the primitives outside the BVH, which every ray is tested against.
+     */
+    SceneCacheSection unbounded;
+
+    SceneCacheSection bvh_nodes;
+
+    SceneCacheSection bvh_indices;
+
+    SceneCacheSection lights;
+
+    SceneCacheSection meshes;
+
+    SceneCacheSection strings;
+};
+
+/**
+ * Binary scene file that is mapped into memory and used in place. All references inside the
+ * file are offsets or indices, so nothing needs to be parsed or relocated on load and pages are
+ * only read in as rays touch them.
+ */
+class SceneCache {
+private:
+    void *mapping = nullptr;
+
+    size_t size = 0;
+
+    const SceneCacheHeader *header = nullptr;
+
+    template<typename T>
+    const T *section(const SceneCacheSection &section) const;
+
+    template<typename T>
+    bool check_section(const SceneCacheSection &section) const;
+
+    bool check_contents() const;
+
+public:
+    static const uint32_t version = 2;
+
+    SceneCache() = default;
+
+    SceneCache(const SceneCache &) = delete;
+
+    SceneCache &operator=(const SceneCache &) = delete;
+
+    ~SceneCache();
+
+    /**
+     * Writes the scene, which needs an up to date BVH, to a cache file.
+     */
+    static bool write(const std::string &file_name, const Scene &scene);
+
+    /**
+     * Maps the cache file and checks its header, section bounds and every type, material handle
+     * and index stored in the sections, so a corrupt file is rejected instead of read out of
+     * bounds while rendering.
+     */
+    bool map(const std::string &file_name);
+
+    void unmap();
+
+    const SceneCacheHeader &get_header() const;
+
+    const Material *get_materials() const;
+
+    const ScenePrimitive *get_primitives() const;
+
+    size_t get_primitive_count() const;
+
+    const uint32_t *get_unbounded() const;
+
+    size_t get_unbounded_count() const;
+
+    const BvhNode *get_bvh_nodes() const;
+
+    const uint32_t *get_bvh_indices() const;
+
+    const SceneLightRecord *get_lights() const;
+
+    const SceneMeshRecord *get_meshes() const;
+
+    std::string get_string(uint64_t offset, uint32_t length) const;
+
+    /**
+     * Intersects the primitive with the given index, setting the hit's material but no object.
+     */
+    bool intersect(uint32_t index, const Ray &ray, HitPoint *hit_point) const;
+};
+
+#endif //HELIOS_SCENE_CACHE_H
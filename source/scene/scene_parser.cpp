@@ -0,0 +1,663 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <cstring>
+#include <cstdint>
+#include <sphere.h>
+#include <plane.h>
+#include <box.h>
+#include <sphere_light.h>
+#include <rectangle_light.h>
+#include <mesh.h>
+#include <number_parser.h>
+#include "scene_parser.h"
+#include "obj_importer.h"
+
+/**
+ * FNV-1a hash of a material name.
+ */
+static uint32_t hash_name(const char *text, size_t length)
+{
+    uint32_t hash = 2166136261u;
+
+    for (size_t i = 0; i < length; i++) {
+        hash = (hash ^ (unsigned char) text[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+/* Private Functions -------------------------------------------------------- */
+
+bool SceneParser::Token::is(const char *word) const
+{
+    return strlen(word) == length && memcmp(word, text, length) == 0;
+}
+
+bool SceneParser::error(const std::string &message) const
+{
+    std::cerr << "ERROR: " << file_name << ":" << line << ": " << message << std::endl;
+    return false;
+}
+
+bool SceneParser::next_token(Token *token)
+{
+    while (cursor < end && (*cursor == ' ' || *cursor == '\t' || *cursor == '\r'))
+        cursor++;
+
+    if (cursor < end && *cursor == '#') {
+        while (cursor < end && *cursor != '\n')
+            cursor++;
+    }
+
+    if (cursor == end || *cursor == '\n')
+        return false;
+
+    token->text = cursor;
+
+    while (cursor < end && *cursor != ' ' && *cursor != '\t' && *cursor != '\r' && *cursor != '\n')
+        cursor++;
+
+    token->length = (size_t) (cursor - token->text);
+
+    return true;
+}
+
+bool SceneParser::end_line()
+{
+    Token token;
+
+    if (next_token(&token))
+        return error("unexpected '" + std::string(token.text, token.length) + "'");
+
+    if (cursor < end) {
+        cursor++;
+        line++;
+    }
+
+    return true;
+}
+
+bool SceneParser::read_float(float *value)
+{
+    Token token;
+
+    if (!next_token(&token))
+        return error("expected a number at the end of the line");
+
+    if (parse_float(token.text, token.text + token.length, value) != token.text + token.length)
+        return error("expected a number instead of '" + std::string(token.text, token.length) + "'");
+
+    return true;
+}
+
+bool SceneParser::read_vec3(Vec3 *value)
+{
+    return read_float(&value->x) && read_float(&value->y) && read_float(&value->z);
+}
+
+bool SceneParser::read_uint(unsigned int *value)
+{
+    Token token;
+
+    if (!next_token(&token))
+        return error("expected an integer at the end of the line");
+
+    return parse_uint(token, value);
+}
+
+bool SceneParser::parse_uint(const Token &token, unsigned int *value) const
+{
+    unsigned long result = 0;
+
+    for (size_t i = 0; i < token.length; i++) {
+        unsigned long digit = (unsigned long) (token.text[i] - '0');
+
+        if (!is_digit(token.text[i]) || result > (0xffffffffUL - digit) / 10)
+            return error("expected an integer instead of '" + std::string(token.text, token.length) + "'");
+
+        result = result * 10 + digit;
+    }
+
+    *value = (unsigned int) result;
+
+    return true;
+}
+
+bool SceneParser::read_bool(bool *value)
+{
+    Token token;
+
+    if (!next_token(&token))
+        return error("expected 0 or 1 at the end of the line");
+
+    if (token.is("1") || token.is("true")) {
+        *value = true;
+    } else if (token.is("0") || token.is("false")) {
+        *value = false;
+    } else {
+        return error("expected 0 or 1 instead of '" + std::string(token.text, token.length) + "'");
+    }
+
+    return true;
+}
+
+bool SceneParser::read_object_material(MaterialHandle *material, bool *named)
+{
+    Token name;
+
+    if (named)
+        *named = false;
+
+    if (!next_token(&name)) {
+        *material = MaterialLibrary::default_material;
+        return true;
+    }
+
+    if (named)
+        *named = true;
+
+    int index = find_material(name);
+
+    if (index < 0)
+        return error("unknown material '" + std::string(name.text, name.length) + "'");
+
+    *material = materials[index];
+
+    return true;
+}
+
+int SceneParser::find_material(const Token &name) const
+{
+    if (material_table.empty())
+        return -1;
+
+    size_t mask = material_table.size() - 1;
+
+    for (size_t slot = hash_name(name.text, name.length) & mask; material_table[slot] >= 0; slot = (slot + 1) & mask) {
+        const std::string &candidate = material_names[material_table[slot]];
+
+        if (candidate.size() == name.length && memcmp(candidate.data(), name.text, name.length) == 0)
+            return material_table[slot];
+    }
+
+    return -1;
+}
+
+void SceneParser::insert_material(const Token &name, const Material &material)
+{
+    material_names.push_back(std::string(name.text, name.length));
+    materials.push_back(material_library.add_unique(material));
+
+    /**
+     * The table is kept at most half full, growing by rehashing every name.
+     */
+    if (material_names.size() * 2 > material_table.size()) {
+        material_table.assign(std::max((size_t) 16, material_table.size() * 2), -1);
+
+        for (size_t i = 0; i < material_names.size(); i++) {
+            size_t mask = material_table.size() - 1;
+            size_t slot = hash_name(material_names[i].data(), material_names[i].size()) & mask;
+
+            while (material_table[slot] >= 0)
+                slot = (slot + 1) & mask;
+
+            material_table[slot] = (int) i;
+        }
+
+        return;
+    }
+
+    size_t mask = material_table.size() - 1;
+    size_t slot = hash_name(name.text, name.length) & mask;
+
+    while (material_table[slot] >= 0)
+        slot = (slot + 1) & mask;
+
+    material_table[slot] = (int) materials.size() - 1;
+}
+
+bool SceneParser::parse_camera()
+{
+    Token key;
+
+    while (next_token(&key)) {
+        if (key.is("position")) {
+            Vec3 position;
+
+            if (!read_vec3(&position))
+                return false;
+
+            camera.set_position(position);
+        } else if (key.is("target")) {
+            Vec3 target;
+
+            if (!read_vec3(&target))
+                return false;
+
+            camera.set_target(target);
+        } else if (key.is("fov")) {
+            float fov;
+
+            if (!read_float(&fov))
+                return false;
+
+            camera.set_fov(fov, Camera::CAM_FOV_DEGREES);
+        } else if (key.is("type")) {
+            Token value;
+
+            if (!next_token(&value))
+                return error("expected pinhole, thin_lens, orthographic or equirectangular at the end of the line");
+
+            if (value.is("pinhole")) {
+                camera.set_type(Camera::CAM_PINHOLE);
+            } else if (value.is("thin_lens")) {
+                camera.set_type(Camera::CAM_THIN_LENS);
+            } else if (value.is("orthographic")) {
+                camera.set_type(Camera::CAM_ORTHOGRAPHIC);
+            } else if (value.is("equirectangular")) {
+                camera.set_type(Camera::CAM_EQUIRECTANGULAR);
+            } else {
+                return error("expected pinhole, thin_lens, orthographic or equirectangular");
+            }
+        } else if (key.is("up")) {
+            Vec3 up;
+
+            if (!read_vec3(&up))
+                return false;
+
+            if (!up.length_squared())
+                return error("the camera up vector can't be zero");
+
+            camera.set_up(up);
+        } else if (key.is("aperture")) {
+            float aperture;
+
+            if (!read_float(&aperture))
+                return false;
+
+            if (aperture < 0.0f)
+                return error("the aperture can't be negative");
+
+            camera.set_aperture(aperture);
+        } else if (key.is("focus")) {
+            float distance;
+
+            if (!read_float(&distance))
+                return false;
+
+            if (distance <= 0.0f)
+                return error("the focus distance has to be positive");
+
+            camera.set_focus_distance(distance);
+        } else if (key.is("height")) {
+            float height;
+
+            if (!read_float(&height))
+                return false;
+
+            if (height <= 0.0f)
+                return error("the orthographic height has to be positive");
+
+            camera.set_orthographic_height(height);
+        } else {
+            return error("unknown camera property '" + std::string(key.text, key.length) + "'");
+        }
+    }
+
+    return end_line();
+}
+
+bool SceneParser::parse_material()
+{
+    Token name;
+
+    if (!next_token(&name))
+        return error("expected a material name");
+
+    if (find_material(name) >= 0)
+        return error("material '" + std::string(name.text, name.length) + "' is already defined");
+
+    Material material;
+    Token key;
+
+    while (next_token(&key)) {
+        bool read = true;
+
+        if (key.is("albedo")) {
+            read = read_vec3(&material.albedo);
+        } else if (key.is("roughness")) {
+            read = read_float(&material.roughness);
+        } else if (key.is("ior")) {
+            read = read_float(&material.ior);
+        } else if (key.is("metallic")) {
+            read = read_bool(&material.metallic);
+        } else if (key.is("diffuse")) {
+            Token value;
+
+            if (!next_token(&value))
+                return error("expected lambert or oren_nayar at the end of the line");
+
+            if (value.is("lambert")) {
+                material.shading_model.diffuse_function = LAMBERT;
+            } else if (value.is("oren_nayar")) {
+                material.shading_model.diffuse_function = OREN_NYAR;
+            } else {
+                return error("expected lambert or oren_nayar");
+            }
+        } else if (key.is("fresnel")) {
+            Token value;
+
+            if (!next_token(&value))
+                return error("expected default or schlick at the end of the line");
+
+            if (value.is("default")) {
+                material.shading_model.fresnel = DEFAULT_FRESNEL;
+            } else if (value.is("schlick")) {
+                material.shading_model.fresnel = SCHLICK_APPROXIMATION;
+            } else {
+                return error("expected default or schlick");
+            }
+        } else {
+            return error("unknown material property '" + std::string(key.text, key.length) + "'");
+        }
+
+        if (!read)
+            return false;
+    }
+
+    insert_material(name, material);
+
+    return end_line();
+}
+
+bool SceneParser::parse_sphere()
+{
+    Vec3 position;
+    float radius;
+    MaterialHandle material;
+
+    if (!read_vec3(&position) || !read_float(&radius) || !read_object_material(&material))
+        return false;
+
+    if (radius <= 0.0f)
+        return error("the sphere radius has to be positive");
+
+    Drawable *sphere = drawable_arena.create<Sphere>(position, radius);
+    sphere->material = material;
+    drawables.push_back(sphere);
+
+    return end_line();
+}
+
+bool SceneParser::parse_plane()
+{
+    Vec3 position, normal;
+    MaterialHandle material;
+
+    if (!read_vec3(&position) || !read_vec3(&normal) || !read_object_material(&material))
+        return false;
+
+    if (normal.length() == 0.0f)
+        return error("the plane normal can't be zero");
+
+    Drawable *plane = drawable_arena.create<Plane>(position, normal.normalized());
+    plane->material = material;
+    drawables.push_back(plane);
+
+    return end_line();
+}
+
+bool SceneParser::parse_box()
+{
+    Vec3 position, size;
+    MaterialHandle material;
+
+    if (!read_vec3(&position) || !read_vec3(&size) || !read_object_material(&material))
+        return false;
+
+    if (size.x <= 0.0f || size.y <= 0.0f || size.z <= 0.0f)
+        return error("the box dimensions have to be positive");
+
+    Drawable *box = drawable_arena.create<Box>(position, size.x, size.y, size.z);
+    box->material = material;
+    drawables.push_back(box);
+
+    return end_line();
+}
+
+bool SceneParser::parse_mesh()
+{
+    Token path;
+
+    if (!next_token(&path))
+        return error("expected a mesh path");
+
+    MeshReference mesh;
+    mesh.path.assign(path.text, path.length);
+
+    if (mesh.path[0] != '/')
+        mesh.path = directory + mesh.path;
+
+    if (!read_object_material(&mesh.material, &mesh.material_override))
+        return false;
+
+    meshes.push_back(mesh);
+
+    return end_line();
+}
+
+bool SceneParser::parse_keyframe()
+{
+    float time;
+    Vec3 position;
+
+    if (!read_float(&time) || !read_vec3(&position))
+        return false;
+
+    if (drawables.empty())
+        return error("keyframes have to follow a sphere, plane or box");
+
+    if (time < 0.0f)
+        return error("keyframe times can't be negative");
+
+    animation.add_keyframe((uint32_t) drawables.size() - 1, time, position);
+
+    return end_line();
+}
+
+bool SceneParser::parse_light()
+{
+    Vec3 position, color;
+
+    if (!read_vec3(&position) || !read_vec3(&color))
+        return false;
+
+    lights.push_back(light_arena.create<Light>(position, color));
+
+    return end_line();
+}
+
+bool SceneParser::parse_sphere_light()
+{
+    Vec3 position, color;
+    float radius;
+
+    if (!read_vec3(&position) || !read_float(&radius) || !read_vec3(&color))
+        return false;
+
+    if (radius <= 0.0f)
+        return error("the light radius has to be positive");
+
+    Light *light = light_arena.create<SphereLight>(position, radius, color);
+    lights.push_back(light);
+
+    Token samples;
+
+    if (next_token(&samples)) {
+        unsigned int count;
+
+        if (!parse_uint(samples, &count))
+            return false;
+
+        light->set_samples(count);
+    }
+
+    return end_line();
+}
+
+bool SceneParser::parse_rectangle_light()
+{
+    Vec3 position, edge_u, edge_v, color;
+
+    if (!read_vec3(&position) || !read_vec3(&edge_u) || !read_vec3(&edge_v) || !read_vec3(&color))
+        return false;
+
+    if (cross(edge_u, edge_v).length() == 0.0f)
+        return error("the light edges have to span a rectangle");
+
+    Light *light = light_arena.create<RectangleLight>(position, edge_u, edge_v, color);
+    lights.push_back(light);
+
+    Token samples;
+
+    if (next_token(&samples)) {
+        unsigned int count;
+
+        if (!parse_uint(samples, &count))
+            return false;
+
+        light->set_samples(count);
+    }
+
+    return end_line();
+}
+
+bool SceneParser::import_meshes()
+{
+    if (meshes.empty())
+        return true;
+
+    ObjImporter importer;
+
+    for (const MeshReference &reference : meshes) {
+        Mesh *mesh = drawable_arena.create<Mesh>();
+        mesh->material = reference.material;
+        drawables.push_back(mesh);
+
+        if (!importer.load(reference.path, mesh, &material_library))
+            return false;
+
+        if (reference.material_override)
+            mesh->set_material(reference.material);
+    }
+
+    return true;
+}
+
+void SceneParser::destroy_objects()
+{
+    drawables.clear();
+    lights.clear();
+
+    drawable_arena.clear();
+    light_arena.clear();
+}
+
+/* -------------------------------------------------------------------------- */
+
+SceneParser::SceneParser(const std::string &file_name) : file_name(file_name)
+{
+    size_t separator = file_name.find_last_of('/');
+
+    if (separator != std::string::npos)
+        directory = file_name.substr(0, separator + 1);
+}
+
+SceneParser::~SceneParser()
+{
+    destroy_objects();
+}
+
+bool SceneParser::parse(const char *data, size_t size, Scene *scene)
+{
+    cursor = data;
+    end = data + size;
+    line = 1;
+
+    camera = Camera();
+    camera.set_fov(50.0f, Camera::CAM_FOV_DEGREES);
+
+    Token keyword;
+
+    while (cursor < end) {
+        if (!next_token(&keyword)) {
+            end_line();
+            continue;
+        }
+
+        bool parsed;
+
+        if (keyword.is("sphere")) {
+            parsed = parse_sphere();
+        } else if (keyword.is("plane")) {
+            parsed = parse_plane();
+        } else if (keyword.is("box")) {
+            parsed = parse_box();
+        } else if (keyword.is("material")) {
+            parsed = parse_material();
+        } else if (keyword.is("mesh")) {
+            parsed = parse_mesh();
+        } else if (keyword.is("light")) {
+            parsed = parse_light();
+        } else if (keyword.is("sphere_light")) {
+            parsed = parse_sphere_light();
+        } else if (keyword.is("rectangle_light")) {
+            parsed = parse_rectangle_light();
+        } else if (keyword.is("camera")) {
+            parsed = parse_camera();
+        } else if (keyword.is("keyframe")) {
+            parsed = parse_keyframe();
+        } else {
+            parsed = error("unknown statement '" + std::string(keyword.text, keyword.length) + "'");
+        }
+
+        if (!parsed) {
+            destroy_objects();
+            return false;
+        }
+    }
+
+    if (!import_meshes()) {
+        destroy_objects();
+        return false;
+    }
+
+    scene->set_camera(camera);
+    scene->set_drawables(drawables, std::move(drawable_arena));
+    scene->set_lights(lights, std::move(light_arena));
+    scene->set_mesh_references(meshes);
+    scene->set_material_library(std::move(material_library));
+    scene->set_animation(animation);
+
+    drawables.clear();
+    lights.clear();
+
+    return true;
+}
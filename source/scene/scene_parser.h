@@ -0,0 +1,170 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_SCENE_PARSER_H
+#define HELIOS_SCENE_PARSER_H
+
+#include <string>
+#include <vector>
+#include "scene.h"
+
+/**
+ * Single pass parser of the text scene description. Every line holds one statement, fields are
+ * separated by spaces or tabs and '#' starts a comment running to the end of the line:
+ *
+ *   camera [position x y z] [target x y z] [fov degrees] [up x y z]
+ *          [type pinhole|thin_lens|orthographic|equirectangular]
+ *          [aperture radius] [focus distance] [height orthographic height]
+ *   material <name> [albedo r g b] [roughness r] [ior n] [metallic 0|1]
+ *                   [diffuse lambert|oren_nayar] [fresnel default|schlick]
+ *   sphere <x y z> <radius> [material]
+ *   plane <x y z> <normal x y z> [material]
+ *   box <x y z> <length width height> [material]
+ *   mesh <path> [material]
+ *   light <x y z> <r g b>
+ *   sphere_light <x y z> <radius> <r g b> [samples]
+ *   rectangle_light <x y z> <edge u x y z> <edge v x y z> <r g b> [samples]
+ *   keyframe <time> <x y z>
+ *
+ * Materials have to be declared before they are used; objects without one get the default
+ * material. Mesh paths are relative to the scene file. Keyframes give the position of the last
+ * sphere, plane or box at a time in seconds for rendering animations.
+ * Tokens are read in place from the file contents, numbers are converted without going through
+ * strings or the locale.
+ */
+class SceneParser {
+private:
+    struct Token {
+        const char *text = nullptr;
+        size_t length = 0;
+
+        bool is(const char *word) const;
+    };
+
+    std::string file_name;
+
+    std::string directory;
+
+    const char *cursor = nullptr;
+    const char *end = nullptr;
+
+    unsigned int line = 1;
+
+    Camera camera;
+
+    std::vector<Drawable *> drawables;
+
+    std::vector<Light *> lights;
+
+    /**
+     * The objects are allocated in arenas that the scene takes over.
+     */
+    ObjectArena drawable_arena;
+
+    ObjectArena light_arena;
+
+    std::vector<MeshReference> meshes;
+
+    Animation animation;
+
+    std::vector<std::string> material_names;
+
+    /**
+     * Handles of the named materials in the library the scene takes over.
+     */
+    std::vector<MaterialHandle> materials;
+
+    MaterialLibrary material_library;
+
+    /**
+     * Open addressing hash table of material indices, -1 marking empty slots.
+     */
+    std::vector<int> material_table;
+
+    bool error(const std::string &message) const;
+
+    /**
+     * Reads the next token of the current line, false at its end.
+     */
+    bool next_token(Token *token);
+
+    /**
+     * Fails if the line has more tokens, otherwise moves to the next line.
+     */
+    bool end_line();
+
+    bool read_float(float *value);
+
+    bool read_vec3(Vec3 *value);
+
+    bool read_uint(unsigned int *value);
+
+    bool parse_uint(const Token &token, unsigned int *value) const;
+
+    bool read_bool(bool *value);
+
+    /**
+     * Reads the optional material name ending object statements, named tells whether there was one.
+     */
+    bool read_object_material(MaterialHandle *material, bool *named = nullptr);
+
+    int find_material(const Token &name) const;
+
+    void insert_material(const Token &name, const Material &material);
+
+    bool parse_camera();
+
+    bool parse_material();
+
+    bool parse_sphere();
+
+    bool parse_plane();
+
+    bool parse_box();
+
+    bool parse_mesh();
+
+    bool parse_light();
+
+    bool parse_sphere_light();
+
+    bool parse_rectangle_light();
+
+    bool parse_keyframe();
+
+    /**
+     * Imports the mesh references into mesh drawables after the other drawables, adding the
+     * materials of the mesh files to the library.
+     */
+    bool import_meshes();
+
+    void destroy_objects();
+
+public:
+    SceneParser(const std::string &file_name);
+
+    ~SceneParser();
+
+    /**
+     * Parses the file contents and imports the meshes they reference, and only once all of that
+     * succeeded replaces the contents of the scene with them.
+     */
+    bool parse(const char *data, size_t size, Scene *scene);
+};
+
+#endif //HELIOS_SCENE_PARSER_H
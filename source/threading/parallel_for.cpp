@@ -0,0 +1,98 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <thread_pool.h>
+#include "parallel_for.h"
+
+/**
+ * Shared by the calling thread and the pool jobs of one parallel_for() call. Jobs can still be
+ * queued after the call returned, so it is reference counted instead of living on the stack.
+ */
+struct ParallelForState {
+    std::atomic<unsigned int> next_block;
+
+    std::atomic<unsigned int> done_blocks;
+
+    std::mutex done_mutex;
+
+    std::condition_variable all_done;
+};
+
+unsigned int parallel_for_thread_count()
+{
+    unsigned int thread_count = std::thread::hardware_concurrency();
+
+    return thread_count ? thread_count : 1;
+}
+
+void parallel_for(unsigned int count, const std::function<void(unsigned int begin, unsigned int end)> &body)
+{
+    if (!count)
+        return;
+
+    unsigned int block_count = std::min(parallel_for_thread_count(), count);
+    ThreadPool &thread_pool = ThreadPool::get_shared();
+
+    if (block_count == 1 || !thread_pool.initialize()) {
+        body(0, count);
+        return;
+    }
+
+    std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>();
+    state->next_block = 0;
+    state->done_blocks = 0;
+
+    const std::function<void(unsigned int, unsigned int)> *body_pointer = &body;
+
+    /**
+     * Blocks are claimed rather than assigned, so the calling thread finishes the whole range on
+     * its own if every worker is busy, e.g. when parallel_for() is called from a pool job.
+     */
+    auto run_blocks = [state, body_pointer, count, block_count]() {
+        unsigned int block;
+
+        while ((block = state->next_block++) < block_count) {
+            unsigned int begin = (unsigned int) ((unsigned long) count * block / block_count);
+            unsigned int end = (unsigned int) ((unsigned long) count * (block + 1) / block_count);
+
+            (*body_pointer)(begin, end);
+
+            if (++state->done_blocks == block_count) {
+                std::unique_lock<std::mutex> lock(state->done_mutex);
+                state->all_done.notify_all();
+            }
+        }
+    };
+
+    thread_pool.add_jobs(std::vector<std::function<void()>>(block_count - 1, run_blocks));
+
+    run_blocks();
+
+    std::unique_lock<std::mutex> lock(state->done_mutex);
+
+    state->all_done.wait(lock, [&state, block_count] {
+        return state->done_blocks == block_count;
+    });
+}
@@ -0,0 +1,36 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_PARALLEL_FOR_H
+#define HELIOS_PARALLEL_FOR_H
+
+#include <functional>
+
+/**
+ * Splits the range [0, count) into contiguous blocks, one per available hardware thread,
+ * and calls body(begin, end) for every block in parallel on the shared thread pool, the calling
+ * thread included. Returns when all blocks are done.
+ */
+void parallel_for(unsigned int count, const std::function<void(unsigned int begin, unsigned int end)> &body);
+
+/**
+ * Number of blocks parallel_for() splits work into.
+ */
+unsigned int parallel_for_thread_count();
+
+#endif //HELIOS_PARALLEL_FOR_H
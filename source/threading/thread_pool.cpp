@@ -25,6 +25,19 @@ ThreadPool::~ThreadPool()
     terminate();
 }
 
+ThreadPool &ThreadPool::get_shared()
+{
+    static ThreadPool pool;
+
+    /**
+     * Initialized together with the pool, so threads calling this concurrently never race on it.
+     */
+    static bool initialized = pool.initialize();
+    (void) initialized;
+
+    return pool;
+}
+
 void ThreadPool::wait_and_execute()
 {
     std::function<void()> job;
@@ -76,6 +89,12 @@ void ThreadPool::wait_and_execute()
 
 bool ThreadPool::initialize()
 {
+    /**
+     * Renderers initialize the pool on every render, the workers are only created once.
+     */
+    if (!workers.empty())
+        return true;
+
     std::cout << "Initializing thread pool..." << std::endl;
 
     /**
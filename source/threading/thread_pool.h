@@ -24,6 +24,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <queue>
 #include <mutex>
 #include <condition_variable>
+#include <functional>
 
 class ThreadPool {
 private:
@@ -47,6 +48,12 @@ public:
 
     ~ThreadPool();
 
+    /**
+     * The process wide pool, created and initialized on first use. Renderers and helpers share it
+     * instead of each starting their own workers.
+     */
+    static ThreadPool &get_shared();
+
     bool initialize();
 
     void wait();
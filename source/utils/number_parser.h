@@ -0,0 +1,146 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_NUMBER_PARSER_H
+#define HELIOS_NUMBER_PARSER_H
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+/**
+ * Number conversion for the text file parsers, working in place on the file contents without
+ * going through strings or the locale.
+ */
+
+inline bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * Parses a decimal floating point number at the start of [text, end). Up to 19 significant digits
+ * are gathered in an integer and scaled by a power of ten once, which is exact to within rounding
+ * for the values scene files hold. Returns the end of the number, or nullptr if there is none.
+ */
+inline const char *parse_float(const char *text, const char *end, float *value)
+{
+    static const double powers_of_ten[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12,
+                                           1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    const char *p = text;
+
+    bool negative = false;
+
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool has_digits = false;
+
+    for (; p < end && is_digit(*p); p++) {
+        has_digits = true;
+
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        } else {
+            exponent++;
+        }
+    }
+
+    if (p < end && *p == '.') {
+        for (p++; p < end && is_digit(*p); p++) {
+            has_digits = true;
+
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }
+        }
+    }
+
+    if (!has_digits)
+        return nullptr;
+
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+
+        bool negative_exponent = false;
+
+        if (p < end && (*p == '-' || *p == '+'))
+            negative_exponent = *p++ == '-';
+
+        if (p == end || !is_digit(*p))
+            return nullptr;
+
+        int written_exponent = 0;
+
+        for (; p < end && is_digit(*p); p++) {
+            written_exponent = std::min(written_exponent * 10 + (*p - '0'), 100000);
+        }
+
+        exponent += negative_exponent ? -written_exponent : written_exponent;
+    }
+
+    double result = (double) mantissa;
+
+    if (exponent < 0)
+        result /= -exponent <= 22 ? powers_of_ten[-exponent] : pow(10.0, -exponent);
+    else if (exponent > 0)
+        result *= exponent <= 22 ? powers_of_ten[exponent] : pow(10.0, exponent);
+
+    *value = (float) (negative ? -result : result);
+
+    return p;
+}
+
+/**
+ * Parses a decimal integer with an optional sign at the start of [text, end). Returns the end of
+ * the number, or nullptr if there is none or it doesn't fit.
+ */
+inline const char *parse_int(const char *text, const char *end, long *value)
+{
+    const char *p = text;
+
+    bool negative = false;
+
+    if (p < end && (*p == '-' || *p == '+'))
+        negative = *p++ == '-';
+
+    if (p == end || !is_digit(*p))
+        return nullptr;
+
+    long result = 0;
+
+    for (; p < end && is_digit(*p); p++) {
+        if (result > (0x7fffffffL - 9) / 10)
+            return nullptr;
+
+        result = result * 10 + (*p - '0');
+    }
+
+    *value = negative ? -result : result;
+
+    return p;
+}
+
+#endif //HELIOS_NUMBER_PARSER_H
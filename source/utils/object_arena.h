@@ -0,0 +1,318 @@
+/*
+Helios-Ray - A powerful and highly configurable renderer
+Copyright (C) 2016  Angelos Gkountis
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HELIOS_OBJECT_ARENA_H
+#define HELIOS_OBJECT_ARENA_H
+
+#include <vector>
+#include <atomic>
+#include <utility>
+#include <new>
+#include <cstddef>
+#include <algorithm>
+
+/**
+ * Allocates objects of any type from typed pools of contiguous blocks. Objects of one type are
+ * stored next to each other in creation order and are all destroyed and freed at once by clear()
+ * or the destructor, they can't be freed one by one. Not thread safe.
+ */
+class ObjectArena {
+private:
+    class PoolBase {
+    public:
+        virtual ~PoolBase() = default;
+
+        virtual size_t get_object_count() const = 0;
+
+        virtual size_t get_memory() const = 0;
+    };
+
+    template<typename T>
+    class Pool : public PoolBase {
+    private:
+        struct Block {
+            T *objects;
+            size_t capacity;
+            size_t count;
+        };
+
+        /**
+         * Blocks double in size up to max_block_size bytes.
+         */
+        static const size_t first_block_capacity = 64;
+        static const size_t max_block_size = 1 << 20;
+
+        std::vector<Block> blocks;
+
+        size_t object_count = 0;
+
+    public:
+        ~Pool();
+
+        template<typename... Arguments>
+        T *create(Arguments &&... arguments);
+
+        template<typename Constructor>
+        T *create_array(size_t count, Constructor construct);
+
+        /**
+         * Makes room for count more objects in one block.
+         */
+        void reserve(size_t count);
+
+        size_t get_object_count() const;
+
+        size_t get_memory() const;
+    };
+
+    std::vector<PoolBase *> pools;
+
+    static size_t next_type_index();
+
+    template<typename T>
+    static size_t type_index();
+
+    template<typename T>
+    Pool<T> *get_pool();
+
+public:
+    ObjectArena() = default;
+
+    ObjectArena(const ObjectArena &) = delete;
+
+    ObjectArena &operator=(const ObjectArena &) = delete;
+
+    ObjectArena(ObjectArena &&arena);
+
+    ObjectArena &operator=(ObjectArena &&arena);
+
+    ~ObjectArena();
+
+    template<typename T, typename... Arguments>
+    T *create(Arguments &&... arguments);
+
+    /**
+     * Constructs count objects of type T next to each other. construct(storage) has to construct
+     * every one of them in place with placement new, which it may do in parallel.
+     */
+    template<typename T, typename Constructor>
+    T *create_array(size_t count, Constructor construct);
+
+    /**
+     * Makes room for count more objects of type T stored next to each other.
+     */
+    template<typename T>
+    void reserve(size_t count);
+
+    /**
+     * Destroys all objects and frees their memory.
+     */
+    void clear();
+
+    size_t get_object_count() const;
+
+    /**
+     * Bytes allocated for the pools' blocks.
+     */
+    size_t get_memory() const;
+};
+
+template<typename T>
+ObjectArena::Pool<T>::~Pool()
+{
+    for (Block &block : blocks) {
+        for (size_t i = 0; i < block.count; i++) {
+            block.objects[i].~T();
+        }
+
+        ::operator delete(block.objects);
+    }
+}
+
+template<typename T>
+template<typename... Arguments>
+T *ObjectArena::Pool<T>::create(Arguments &&... arguments)
+{
+    if (blocks.empty() || blocks.back().count == blocks.back().capacity)
+        reserve(1);
+
+    Block &block = blocks.back();
+    T *object = new(block.objects + block.count) T(std::forward<Arguments>(arguments)...);
+
+    block.count++;
+    object_count++;
+
+    return object;
+}
+
+template<typename T>
+template<typename Constructor>
+T *ObjectArena::Pool<T>::create_array(size_t count, Constructor construct)
+{
+    if (!count)
+        return nullptr;
+
+    reserve(count);
+
+    Block &block = blocks.back();
+    T *objects = block.objects + block.count;
+
+    construct(objects);
+
+    block.count += count;
+    object_count += count;
+
+    return objects;
+}
+
+template<typename T>
+void ObjectArena::Pool<T>::reserve(size_t count)
+{
+    if (!blocks.empty() && blocks.back().capacity - blocks.back().count >= count)
+        return;
+
+    size_t capacity = blocks.empty() ? first_block_capacity : blocks.back().capacity * 2;
+
+    if (capacity * sizeof(T) > max_block_size)
+        capacity = std::max(max_block_size / sizeof(T), (size_t) 1);
+
+    Block block;
+    block.capacity = std::max(capacity, count);
+    block.objects = static_cast<T *>(::operator new(block.capacity * sizeof(T)));
+    block.count = 0;
+
+    blocks.push_back(block);
+}
+
+template<typename T>
+size_t ObjectArena::Pool<T>::get_object_count() const
+{
+    return object_count;
+}
+
+template<typename T>
+size_t ObjectArena::Pool<T>::get_memory() const
+{
+    size_t memory = 0;
+
+    for (const Block &block : blocks) {
+        memory += block.capacity * sizeof(T);
+    }
+
+    return memory;
+}
+
+inline size_t ObjectArena::next_type_index()
+{
+    static std::atomic<size_t> next_index(0);
+
+    return next_index++;
+}
+
+template<typename T>
+size_t ObjectArena::type_index()
+{
+    static const size_t index = next_type_index();
+
+    return index;
+}
+
+template<typename T>
+ObjectArena::Pool<T> *ObjectArena::get_pool()
+{
+    size_t index = type_index<T>();
+
+    if (index >= pools.size())
+        pools.resize(index + 1, nullptr);
+
+    if (!pools[index])
+        pools[index] = new Pool<T>();
+
+    return static_cast<Pool<T> *>(pools[index]);
+}
+
+inline ObjectArena::ObjectArena(ObjectArena &&arena)
+{
+    pools.swap(arena.pools);
+}
+
+inline ObjectArena &ObjectArena::operator=(ObjectArena &&arena)
+{
+    if (this != &arena) {
+        clear();
+        pools.swap(arena.pools);
+    }
+
+    return *this;
+}
+
+inline ObjectArena::~ObjectArena()
+{
+    clear();
+}
+
+template<typename T, typename... Arguments>
+T *ObjectArena::create(Arguments &&... arguments)
+{
+    return get_pool<T>()->create(std::forward<Arguments>(arguments)...);
+}
+
+template<typename T, typename Constructor>
+T *ObjectArena::create_array(size_t count, Constructor construct)
+{
+    return get_pool<T>()->create_array(count, construct);
+}
+
+template<typename T>
+void ObjectArena::reserve(size_t count)
+{
+    get_pool<T>()->reserve(count);
+}
+
+inline void ObjectArena::clear()
+{
+    for (PoolBase *pool : pools) {
+        delete pool;
+    }
+
+    pools.clear();
+}
+
+inline size_t ObjectArena::get_object_count() const
+{
+    size_t count = 0;
+
+    for (const PoolBase *pool : pools) {
+        count += pool ? pool->get_object_count() : 0;
+    }
+
+    return count;
+}
+
+inline size_t ObjectArena::get_memory() const
+{
+    size_t memory = 0;
+
+    for (const PoolBase *pool : pools) {
+        memory += pool ? pool->get_memory() : 0;
+    }
+
+    return memory;
+}
+
+#endif //HELIOS_OBJECT_ARENA_H
@@ -16,34 +16,148 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <sphere.h>
+#include <thread_pool.h>
+#include <parallel_for.h>
 #include "utils.h"
 
+static const Vec3 sphere_flake_offsets[] = {
+        Vec3(1, 0, 0),
+        Vec3(-1, 0, 0),
+        Vec3(0, 1, 0),
+        Vec3(0, -1, 0),
+        Vec3(0, 0, 1),
+        Vec3(0, 0, -1)
+};
 
-void Utils::generate_sphere_flake(Scene *sc, const Material &mat, const Vec3 &pos, float radius, float scale, int iter)
+/**
+ * Subtrees are handed to the thread pool this many levels down, 36 jobs per flake.
+ */
+static const int sphere_flake_split_depth = 2;
+
+/**
+ * Uniform float in [0, 1) from a hash of the seed and the index.
+ */
+static inline float random_float(uint32_t seed, uint32_t index)
 {
-    if(iter <= 0.0f)
+    uint32_t hash = seed ^ (index * 0x9e3779b9u);
+
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    hash *= 0xc2b2ae35u;
+    hash ^= hash >> 16;
+
+    return (hash >> 8) / 16777216.0f;
+}
+
+/* Private Functions -------------------------------------------------------- */
+
+void Utils::construct_sphere_flake(Sphere *spheres, MaterialHandle material, const Vec3 &position, float radius,
+                                   float scale, int depth, int split_depth,
+                                   std::vector<std::function<void()>> *jobs)
+{
+    if (depth <= 0)
         return;
 
-    static Vec3 offs[] = {
-            Vec3(1, 0, 0),
-            Vec3(-1, 0, 0),
-            Vec3(0, 1, 0),
-            Vec3(0, -1, 0),
-            Vec3(0, 0, 1),
-            Vec3(0, 0, -1)
-    };
+    if (jobs && split_depth == 0) {
+        jobs->push_back([=] {
+            construct_sphere_flake(spheres, material, position, radius, scale, depth, 0, nullptr);
+        });
 
-    Sphere *sphere = new Sphere(pos, radius);
-    sphere->material = mat;
+        return;
+    }
 
-    sc->add_drawable(sphere);
+    Sphere *sphere = new(spheres) Sphere(position, radius);
+    sphere->material = material;
 
-    for(auto v : offs) {
+    size_t subtree_size = sphere_flake_size(depth - 1);
+    float child_radius = radius * scale;
 
-        float new_rad = radius * scale;
-        Vec3 new_pos = pos + v * (radius + new_rad);
+    for (int i = 0; i < 6; i++) {
+        Vec3 child_position = position + sphere_flake_offsets[i] * (radius + child_radius);
 
-        generate_sphere_flake(sc, mat, new_pos, new_rad, scale, iter - 1);
+        construct_sphere_flake(spheres + 1 + i * subtree_size, material, child_position, child_radius, scale,
+                               depth - 1, split_depth - 1, jobs);
     }
 }
+
+/* -------------------------------------------------------------------------- */
+
+size_t Utils::sphere_flake_size(int iter)
+{
+    size_t size = 0;
+
+    for (size_t level = 1; iter > 0; iter--, level *= 6) {
+        size += level;
+    }
+
+    return size;
+}
+
+void Utils::generate_sphere_flake(Scene *sc, MaterialHandle mat, const Vec3 &pos, float radius, float scale, int iter)
+{
+    generate_sphere_flake_grid(sc, mat, pos, 0.0f, 1, 1, radius, scale, iter);
+}
+
+void Utils::generate_sphere_flake_grid(Scene *scene, MaterialHandle material, const Vec3 &origin, float spacing,
+                                       unsigned int columns, unsigned int rows, float radius, float scale,
+                                       int depth)
+{
+    size_t flake_size = sphere_flake_size(depth);
+    size_t count = flake_size * columns * rows;
+
+    if (!count)
+        return;
+
+    scene->create_drawables<Sphere>(count, [&](Sphere *spheres) {
+        std::vector<std::function<void()>> jobs;
+
+        for (unsigned int row = 0; row < rows; row++) {
+            for (unsigned int column = 0; column < columns; column++) {
+                Vec3 position = origin + Vec3(column * spacing, 0.0f, row * spacing);
+                Sphere *flake = spheres + (row * columns + column) * flake_size;
+
+                construct_sphere_flake(flake, material, position, radius, scale, depth, sphere_flake_split_depth,
+                                       &jobs);
+            }
+        }
+
+        ThreadPool &thread_pool = ThreadPool::get_shared();
+
+        if (!thread_pool.initialize()) {
+            for (std::function<void()> &job : jobs) {
+                job();
+            }
+
+            return;
+        }
+
+        thread_pool.add_jobs(jobs);
+        thread_pool.wait();
+    });
+}
+
+void Utils::generate_random_spheres(Scene *scene, MaterialHandle material, const Vec3 &min, const Vec3 &max,
+                                    float min_radius, float max_radius, unsigned int count, uint32_t seed)
+{
+    if (!count)
+        return;
+
+    Vec3 extent = max - min;
+
+    scene->create_drawables<Sphere>(count, [&](Sphere *spheres) {
+        parallel_for(count, [&](unsigned int begin, unsigned int end) {
+            for (unsigned int i = begin; i < end; i++) {
+                uint32_t index = i * 4;
+
+                Vec3 position = min + Vec3(random_float(seed, index) * extent.x,
+                                           random_float(seed, index + 1) * extent.y,
+                                           random_float(seed, index + 2) * extent.z);
+                float radius = min_radius + random_float(seed, index + 3) * (max_radius - min_radius);
+
+                Sphere *sphere = new(spheres + i) Sphere(position, radius);
+                sphere->material = material;
+            }
+        });
+    });
+}
@@ -19,13 +19,50 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef HELIOS_UTILS_H
 #define HELIOS_UTILS_H
 
+#include <vector>
+#include <functional>
 #include <scene.h>
+#include <sphere.h>
 
 class Utils {
+private:
+    /**
+     * Constructs a flake's spheres depth first from spheres[0] on. Subtrees split_depth levels
+     * down are added to jobs instead when jobs isn't nullptr.
+     */
+    static void construct_sphere_flake(Sphere *spheres, MaterialHandle material, const Vec3 &position, float radius,
+                                       float scale, int depth, int split_depth,
+                                       std::vector<std::function<void()>> *jobs);
+
 public:
     Utils() = delete;
 
-    static void generate_sphere_flake(Scene * sc, const Material &mat, const Vec3 &pos, float radius, float scale, int iter);
+    /**
+     * Number of spheres of a sphere flake iter levels deep.
+     */
+    static size_t sphere_flake_size(int iter);
+
+    /**
+     * Adds a sphere flake: a sphere with six smaller flakes touching it, iter levels deep. The
+     * spheres are counted up front and constructed in one block of the scene's arena, with the
+     * subtrees built in parallel.
+     */
+    static void generate_sphere_flake(Scene * sc, MaterialHandle mat, const Vec3 &pos, float radius, float scale, int iter);
+
+    /**
+     * Adds columns x rows copies of a sphere flake on the xz plane, spacing apart from origin,
+     * all in one block of the scene's arena.
+     */
+    static void generate_sphere_flake_grid(Scene *scene, MaterialHandle material, const Vec3 &origin, float spacing,
+                                           unsigned int columns, unsigned int rows, float radius, float scale,
+                                           int depth);
+
+    /**
+     * Adds count spheres with random centers in [min, max] and radii in [min_radius, max_radius].
+     * The spheres depend only on the seed, not on how the work is split between threads.
+     */
+    static void generate_random_spheres(Scene *scene, MaterialHandle material, const Vec3 &min, const Vec3 &max,
+                                        float min_radius, float max_radius, unsigned int count, uint32_t seed);
 };
 
 #endif //HELIOS_UTILS_H